@@ -129,6 +129,7 @@ endif
 
 ifndef CUSTOM_MATRIX
 	SRC += $(QUANTUM_DIR)/matrix.c
+	SRC += $(QUANTUM_DIR)/matrix_ports.c
 endif
 
 ifeq ($(strip $(API_SYSEX_ENABLE)), yes)
@@ -178,8 +179,16 @@ endif
 
 ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
 	OPT_DEFS += -DRGBLIGHT_ENABLE
+ifeq ($(PLATFORM),CHIBIOS)
+	SRC += $(QUANTUM_DIR)/ws2812_spi.c
+	SRC += $(QUANTUM_DIR)/ws2812_chibios.c
+else
 	SRC += $(QUANTUM_DIR)/light_ws2812.c
+endif
 	SRC += $(QUANTUM_DIR)/rgblight.c
+	SRC += $(QUANTUM_DIR)/rgblight_animation.c
+	SRC += $(QUANTUM_DIR)/rgblight_effects.c
+	SRC += $(QUANTUM_DIR)/rgblight_reactive.c
 endif
 
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
@@ -199,6 +208,40 @@ ifeq ($(strip $(SERIAL_LINK_ENABLE)), yes)
 	VAPTH += $(SERIAL_PATH)
 endif
 
+ifeq ($(strip $(SPLIT_TRANSPORT_ENABLE)), yes)
+	OPT_DEFS += -DSPLIT_TRANSPORT_ENABLE
+	# Only one link with small frames, the serial_link defaults are far too big for an AVR
+	OPT_DEFS += -DMAX_FRAME_SIZE=32 -DNUM_LINKS=1
+	SRC += $(QUANTUM_DIR)/serial_link/protocol/byte_stuffer.c
+	SRC += $(QUANTUM_DIR)/serial_link/protocol/frame_validator.c
+	SRC += $(QUANTUM_DIR)/serial_link/protocol/crc32.c
+	SRC += $(QUANTUM_DIR)/serial_link/protocol/link_stats.c
+	SRC += $(QUANTUM_DIR)/split/split_transport.c
+	SRC += $(QUANTUM_DIR)/split/split_sync.c
+ifeq ($(PLATFORM),CHIBIOS)
+	SRC += $(QUANTUM_DIR)/split/split_chibios.c
+else
+	SRC += $(QUANTUM_DIR)/split/split_usart.c
+endif
+endif
+
+ifeq ($(strip $(EXPANDER_MATRIX_ENABLE)), yes)
+	OPT_DEFS += -DEXPANDER_MATRIX_ENABLE
+	SRC += $(QUANTUM_DIR)/expander_matrix.c
+	TWI_QUEUE_ENABLE = yes
+endif
+
+ifeq ($(strip $(TWI_QUEUE_ENABLE)), yes)
+	SRC += $(QUANTUM_DIR)/twi_queue.c
+	SRC += $(QUANTUM_DIR)/twi_queue_avr.c
+endif
+
+ifeq ($(strip $(PROFILE_ENABLE)), yes)
+	OPT_DEFS += -DPROFILE_ENABLE
+	SRC += $(QUANTUM_DIR)/profile.c
+	SRC += $(QUANTUM_DIR)/profile_timer.c
+endif
+
 ifneq ($(strip $(VARIABLE_TRACE)),)
 	SRC += $(QUANTUM_DIR)/variable_trace.c
 	OPT_DEFS += -DNUM_TRACED_VARIABLES=$(strip $(VARIABLE_TRACE))
@@ -43,10 +43,13 @@ VPATH += $(COMMON_VPATH)
 
 include $(TMK_PATH)/common.mk
 include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(QUANTUM_PATH)/tests/rules.mk
 
 $(TEST_OBJ)/$(TEST)_SRC := $($(TEST)_SRC)
 $(TEST_OBJ)/$(TEST)_INC := $($(TEST)_INC) $(VPATH) $(GTEST_INC)
 $(TEST_OBJ)/$(TEST)_DEFS := $($(TEST)_DEFS)
+$(TEST_OBJ)/$(TEST)_CONFIG := $($(TEST)_CONFIG)
+LDFLAGS += $($(TEST)_LDFLAGS)
 
 include $(TMK_PATH)/native.mk
 include $(TMK_PATH)/rules.mk
@@ -35,6 +35,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MATRIX_ROWS 14
 #define MATRIX_COLS 6
 
+/* rows 0 to 6 are on the mcp23018, rows on GPIOA and cols on GPIOB */
+#define EXPANDER_ADDRESS 0b0100000
+#define EXPANDER_ROWS 7
+#define EXPANDER_ROW_PINS { 0, 1, 2, 3, 4, 5, 6 }
+#define EXPANDER_COL_PINS { 0, 1, 2, 3, 4, 5 }
+
 /* number of backlight levels */
 #define BACKLIGHT_LEVELS 3
 
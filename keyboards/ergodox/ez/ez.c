@@ -1,5 +1,6 @@
 #include "ez.h"
 #include "i2cmaster.h"
+#include "expander_matrix.h"
 
 bool i2c_initialized = 0;
 uint8_t mcp23018_status = 0x20;
@@ -61,27 +62,9 @@ uint8_t init_mcp23018(void) {
         _delay_ms(1000);
     }
 
-    // set pin direction
-    // - unused  : input  : 1
-    // - input   : input  : 1
-    // - driving : output : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(IODIRA);            if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
-    i2c_stop();
-
-    // set pull-up
-    // - unused  : on  : 1
-    // - input   : on  : 1
-    // - driving : off : 0
-    mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(GPPUA);             if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00000000);        if (mcp23018_status) goto out;
-    mcp23018_status = i2c_write(0b00111111);        if (mcp23018_status) goto out;
-
-out:
-    i2c_stop();
+    // set pin direction, pull-ups and the interrupt on change of the
+    // columns, see quantum/expander_matrix.c
+    mcp23018_status = expander_matrix_init() ? 0 : 1;
 
     // SREG=sreg_prev;
 
@@ -74,6 +74,8 @@ OPT_DEFS += -DBOOTLOADER_SIZE=512
 SLEEP_LED_ENABLE = no
 API_SYSEX_ENABLE ?= no
 RGBLIGHT_ENABLE ?= yes
+# The MCP23018 is read through an interrupt driven I2C queue
+EXPANDER_MATRIX_ENABLE = yes
 
 ifndef QUANTUM_DIR
 	include ../../../Makefile
@@ -34,6 +34,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef USE_I2C
 #  include "i2c.h"
+#elif defined(USE_SERIAL_USART)
+#  include "split/split_transport.h"
+#  include "split/split_sync.h"
+#  include "action_layer.h"
+#  include "host.h"
+#  include "led.h"
+#  if SPLIT_SYNC_ROWS_SIZE > SPLIT_TRANSPORT_MAX_PAYLOAD
+#    error "The rows of a half don't fit in SPLIT_TRANSPORT_MAX_PAYLOAD"
+#  endif
+#  if SPLIT_SYNC_MASTER_SIZE > SPLIT_TRANSPORT_MAX_PAYLOAD
+#    error "The master state doesn't fit in SPLIT_TRANSPORT_MAX_PAYLOAD"
+#  endif
 #else // USE_SERIAL
 #  include "serial.h"
 #endif
@@ -55,6 +67,11 @@ static const uint8_t col_pins[MATRIX_COLS] = MATRIX_COL_PINS;
 static matrix_row_t matrix[MATRIX_ROWS];
 static matrix_row_t matrix_debouncing[MATRIX_ROWS];
 
+#ifdef USE_SERIAL_USART
+static split_sync_master_t sync_master;
+static split_sync_slave_t sync_slave;
+#endif
+
 static matrix_row_t read_cols(void);
 static void init_cols(void);
 static void unselect_rows(void);
@@ -117,6 +134,11 @@ void matrix_init(void)
         matrix_debouncing[i] = 0;
     }
 
+#ifdef USE_SERIAL_USART
+    split_sync_master_init(&sync_master);
+    split_sync_slave_init(&sync_slave);
+#endif
+
     matrix_init_quantum();
 }
 
@@ -182,6 +204,75 @@ i2c_error: // the cable is disconnceted, or something else went wrong
     return 0;
 }
 
+#elif defined(USE_SERIAL_USART)
+
+// Get the changed rows of the other half from the answer to the previous poll
+int serial_transaction(void) {
+    static int status = 0;
+    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+
+    switch (split_transport_master_task()) {
+    case SPLIT_POLL_PENDING:
+        // Still waiting for the answer, keep the rows and the status we had
+        return status;
+    case SPLIT_POLL_RECEIVED: {
+        uint8_t buffer[SPLIT_SYNC_ROWS_SIZE];
+        uint8_t size = split_transport_read(buffer, sizeof(buffer));
+        if (size <= sizeof(buffer)) {
+            split_sync_decode_rows(&sync_master, buffer, size);
+        }
+        status = 0;
+        break;
+    }
+    case SPLIT_POLL_TIMEOUT:
+        // The slave may have been restarted, so start over with a keyframe
+        split_sync_master_init(&sync_master);
+        status = 1;
+        break;
+    default:
+        // Nothing was polled yet
+        break;
+    }
+
+    if (sync_master.synced) {
+        for (int i = 0; i < ROWS_PER_HAND; ++i) {
+            matrix[slaveOffset+i] = sync_master.rows[i];
+        }
+    }
+
+    split_master_state_t state = {
+        .layer_state = layer_state,
+        .leds = host_keyboard_leds(),
+    };
+    uint8_t buffer[SPLIT_SYNC_MASTER_SIZE];
+    split_transport_master_poll(buffer, split_sync_encode_master(&sync_master, &state, buffer));
+    return status;
+}
+
+// Answer a poll with the rows that changed, and take over the master state
+static void serial_slave_answer(matrix_row_t* rows) {
+    static uint8_t leds = 0;
+
+    if (!split_transport_slave_task()) {
+        return;
+    }
+
+    uint8_t master_buffer[SPLIT_SYNC_MASTER_SIZE];
+    split_master_state_t state;
+    uint8_t size = split_transport_read(master_buffer, sizeof(master_buffer));
+    if (split_sync_decode_master(&sync_slave, master_buffer, size, &state)) {
+#ifndef NO_ACTION_LAYER
+        layer_state = state.layer_state;
+#endif
+        if (state.leds != leds) {
+            leds = state.leds;
+            led_set(leds);
+        }
+    }
+    uint8_t buffer[SPLIT_SYNC_ROWS_SIZE];
+    split_transport_slave_answer(buffer, split_sync_encode_rows(&sync_slave, rows, buffer));
+}
+
 #else // USE_SERIAL
 
 int serial_transaction(void) {
@@ -242,6 +333,8 @@ void matrix_slave_scan(void) {
         /* i2c_slave_buffer[i] = matrix[offset+i]; */
         i2c_slave_buffer[i] = matrix[offset+i];
     }
+#elif defined(USE_SERIAL_USART)
+    serial_slave_answer(&matrix[offset]);
 #else // USE_SERIAL
     for (int i = 0; i < ROWS_PER_HAND; ++i) {
         serial_slave_buffer[i] = matrix[offset+i];
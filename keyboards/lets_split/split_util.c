@@ -11,6 +11,8 @@
 
 #ifdef USE_I2C
 #  include "i2c.h"
+#elif defined(USE_SERIAL_USART)
+#  include "split/split_transport.h"
 #else
 #  include "serial.h"
 #endif
@@ -33,6 +35,8 @@ static void setup_handedness(void) {
 static void keyboard_master_setup(void) {
 #ifdef USE_I2C
     i2c_master_init();
+#elif defined(USE_SERIAL_USART)
+    split_transport_init(true);
 #else
     serial_master_init();
 #endif
@@ -41,6 +45,8 @@ static void keyboard_master_setup(void) {
 static void keyboard_slave_setup(void) {
 #ifdef USE_I2C
     i2c_slave_init(SLAVE_I2C_ADDRESS);
+#elif defined(USE_SERIAL_USART)
+    split_transport_init(false);
 #else
     serial_slave_init();
 #endif
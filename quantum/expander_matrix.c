@@ -0,0 +1,216 @@
+#include "expander_matrix.h"
+#include "twi_queue.h"
+#include <string.h>
+
+// The registers of the MCP23017 and MCP23018, with IOCON.BANK = 0
+#define IODIRA   0x00
+#define GPINTENA 0x04
+#define IOCON    0x0A
+#define GPPUA    0x0C
+#define INTFB    0x0F
+#define GPIOA    0x12
+
+/* Each row is read with a single transaction: writing GPIOA selects the row,
+ * and since the sequential address pointer then moves on to GPIOB, a repeated
+ * start reads the columns. The scan ends by selecting all rows at once,
+ * which leaves the expander ready to notice any key press.
+ *
+ * The columns are set to interrupt on change, and the interrupt flags are
+ * polled over the bus, so the interrupt pin doesn't need to be wired. When
+ * no key was down at the end of the previous scan, a press on any key pulls
+ * its column low and sets INTFB, so reading that one register is enough to
+ * tell that nothing needs to be scanned. While keys are held a press in the
+ * same column wouldn't change anything, so then every row is read.
+ *
+ * The columns are only sampled after the repeated start and the read
+ * address, which take 25us at 400kHz, so the rows don't need an extra wait
+ * to settle.
+ */
+
+static const uint8_t row_pins[EXPANDER_ROWS] = EXPANDER_ROW_PINS;
+static const uint8_t col_pins[MATRIX_COLS] = EXPANDER_COL_PINS;
+
+static uint8_t row_mask;
+static uint8_t col_mask;
+
+// IOCON, IODIR, GPINTEN, GPPU and GPIOA
+#define CONFIG_WRITES 5
+static uint8_t config_data[CONFIG_WRITES][3];
+static twi_transaction_t config[CONFIG_WRITES];
+
+static uint8_t select_data[EXPANDER_ROWS][2];
+static uint8_t select_all_data[2];
+static const uint8_t changed_register = INTFB;
+static uint8_t read_data[EXPANDER_ROWS];
+static uint8_t all_rows_data;
+static uint8_t changed;
+
+static twi_transaction_t read_row[EXPANDER_ROWS];
+static twi_transaction_t select_all;
+static twi_transaction_t check_changed;
+
+static matrix_row_t expander_rows[EXPANDER_ROWS];
+
+static bool responding;
+// Nothing was down at the end of the last scan, and all rows are selected
+static bool idle;
+static bool scanning;
+static bool checking;
+
+#if TWI_QUEUE_SIZE <= EXPANDER_ROWS + 1 || TWI_QUEUE_SIZE <= CONFIG_WRITES
+#error "TWI_QUEUE_SIZE is too small for a scan of the expander matrix"
+#endif
+
+static void init_transaction(twi_transaction_t* transaction, const uint8_t* data, uint8_t size) {
+    *transaction = (twi_transaction_t) {
+        .address = EXPANDER_ADDRESS,
+        .write_length = size,
+        .write_data = data,
+    };
+}
+
+static void init_config(uint8_t index, uint8_t reg, uint8_t a, uint8_t b) {
+    config_data[index][0] = reg;
+    config_data[index][1] = a;
+    config_data[index][2] = b;
+    init_transaction(&config[index], config_data[index], 3);
+}
+
+bool expander_matrix_init(void) {
+    row_mask = 0;
+    for (uint8_t row = 0; row < EXPANDER_ROWS; row++) {
+        row_mask |= 1 << row_pins[row];
+    }
+    col_mask = 0;
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        col_mask |= 1 << col_pins[col];
+    }
+
+    // Rows are outputs that are only ever driven low, everything else is an
+    // input with a pull-up, and the columns interrupt on change. IOCON is
+    // shared by both ports, and zero keeps the sequential address pointer
+    init_config(0, IOCON, 0, 0);
+    init_config(1, IODIRA, ~row_mask, 0xFF);
+    init_config(2, GPINTENA, 0, col_mask);
+    init_config(3, GPPUA, ~row_mask, 0xFF);
+    init_config(4, GPIOA, 0xFF, 0xFF);
+    config[4].write_length = 2;
+
+    for (uint8_t row = 0; row < EXPANDER_ROWS; row++) {
+        select_data[row][0] = GPIOA;
+        select_data[row][1] = ~(1 << row_pins[row]);
+        init_transaction(&read_row[row], select_data[row], 2);
+        read_row[row].read_length = 1;
+        read_row[row].read_data = &read_data[row];
+    }
+    select_all_data[0] = GPIOA;
+    select_all_data[1] = ~row_mask;
+    init_transaction(&select_all, select_all_data, 2);
+    select_all.read_length = 1;
+    select_all.read_data = &all_rows_data;
+    init_transaction(&check_changed, &changed_register, 1);
+    check_changed.read_length = 1;
+    check_changed.read_data = &changed;
+
+    memset(expander_rows, 0, sizeof(expander_rows));
+    idle = false;
+    scanning = false;
+    responding = false;
+    if (twi_queue_busy()) {
+        return false;
+    }
+    for (uint8_t i = 0; i < CONFIG_WRITES; i++) {
+        twi_queue_submit(&config[i]);
+    }
+    if (!twi_queue_wait(&config[CONFIG_WRITES - 1])) {
+        return false;
+    }
+    for (uint8_t i = 0; i < CONFIG_WRITES; i++) {
+        if (config[i].status != TWI_DONE) {
+            return false;
+        }
+    }
+    responding = true;
+    return true;
+}
+
+static bool queue_rows(void) {
+    for (uint8_t row = 0; row < EXPANDER_ROWS; row++) {
+        twi_queue_submit(&read_row[row]);
+    }
+    return twi_queue_submit(&select_all);
+}
+
+void expander_matrix_start(void) {
+    // Every scan is waited for, so the queue should always be empty here,
+    // and then the whole scan fits
+    scanning = false;
+    if (!responding || twi_queue_busy()) {
+        return;
+    }
+    checking = idle;
+    if (checking) {
+        scanning = twi_queue_submit(&check_changed);
+    } else {
+        scanning = queue_rows();
+    }
+}
+
+static matrix_row_t read_cols(uint8_t data) {
+    matrix_row_t cols = 0;
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        if (!(data & (1 << col_pins[col]))) {
+            cols |= (matrix_row_t)1 << col;
+        }
+    }
+    return cols;
+}
+
+static bool finish(void) {
+    if (checking) {
+        if (!twi_queue_wait(&check_changed)) {
+            return false;
+        }
+        if (!(changed & col_mask)) {
+            // Still nothing down, the rows stay empty
+            idle = true;
+            return true;
+        }
+        // A key was pressed since the last scan, which is rare enough that
+        // it doesn't matter that these rows aren't read in the background
+        if (!queue_rows()) {
+            return false;
+        }
+    }
+
+    // The transactions complete in order, so all are done after the last one
+    if (!twi_queue_wait(&select_all)) {
+        return false;
+    }
+    matrix_row_t down = 0;
+    for (uint8_t row = 0; row < EXPANDER_ROWS; row++) {
+        if (read_row[row].status != TWI_DONE) {
+            return false;
+        }
+        expander_rows[row] = read_cols(read_data[row]);
+        down |= expander_rows[row];
+    }
+    // The columns read with all rows selected also catch a key that was
+    // pressed during the scan
+    down |= read_cols(all_rows_data);
+    idle = !down;
+    return true;
+}
+
+bool expander_matrix_finish(matrix_row_t* rows) {
+    idle = false;
+    if (responding && scanning && !finish()) {
+        responding = false;
+    }
+    scanning = false;
+    if (!responding) {
+        memset(expander_rows, 0, sizeof(expander_rows));
+    }
+    memcpy(rows, expander_rows, sizeof(expander_rows));
+    return responding;
+}
@@ -0,0 +1,44 @@
+#ifndef EXPANDER_MATRIX_H
+#define EXPANDER_MATRIX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+// Rows of the matrix on an MCP23017 or MCP23018 I2C port expander, like the
+// left half of the Ergodox EZ. The rows are driven from port A and the
+// columns are read from port B, with the diodes from the columns to the rows.
+//
+// The traffic of a scan is queued at once with expander_matrix_start, and
+// runs in the background while the local rows are scanned, until
+// expander_matrix_finish collects the result. Each row is selected and read
+// in a single transaction, and when no key was down on the expander, only
+// its interrupt flags are read to tell that nothing changed.
+//
+// The configuration, in config.h:
+//   EXPANDER_ADDRESS   The 7 bit I2C address, 0x20 when the address pins are
+//                      grounded
+//   EXPANDER_ROWS      The number of rows on the expander, these are the
+//                      first rows of the matrix
+//   EXPANDER_ROW_PINS  The port A bit of each row, { 0, 1, 2 ... }
+//   EXPANDER_COL_PINS  The port B bit of each column, MATRIX_COLS of them
+
+#ifndef EXPANDER_ADDRESS
+#define EXPANDER_ADDRESS 0x20
+#endif
+
+#if !defined(EXPANDER_ROWS) || !defined(EXPANDER_ROW_PINS) || !defined(EXPANDER_COL_PINS)
+#error "EXPANDER_ROWS, EXPANDER_ROW_PINS and EXPANDER_COL_PINS must be defined for the expander matrix"
+#endif
+
+// Configures the expander, returns false if it isn't responding. The I2C bus
+// must be initialized first
+bool expander_matrix_init(void);
+// Queues the reads of the rows
+void expander_matrix_start(void);
+// Waits for the reads and stores the EXPANDER_ROWS rows. Returns false if
+// the expander isn't responding, and then the rows are empty until
+// expander_matrix_init succeeds again
+bool expander_matrix_finish(matrix_row_t* rows);
+
+#endif
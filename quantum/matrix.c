@@ -26,6 +26,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "matrix.h"
 #include "timer.h"
+#include "matrix_settle.h"
+#if (DIODE_DIRECTION == COL2ROW)
+#include "matrix_ports.h"
+#endif
+#ifdef EXPANDER_MATRIX_ENABLE
+#include "expander_matrix.h"
+#include "twi_queue.h"
+#endif
 
 
 /* Set 0 if debouncing isn't needed */
@@ -39,6 +47,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     static bool debouncing = false;
 #endif
 
+#ifdef MATRIX_CALIBRATE_SETTLE
+    static uint8_t settle_us = MATRIX_SETTLE_US;
+#endif
+
+/* With MATRIX_OVERLAP_SCAN the next row (or col for ROW2COL) is selected as
+ * soon as the current one is read, and settles while the current one is
+ * stored and debounced. Only the rest of the settle time is waited, measured
+ * with the raw count of the system timer.
+ */
+#ifdef MATRIX_OVERLAP_SCAN
+    static uint8_t settle_start;
+#endif
+
+#ifdef DEBUG_MATRIX_SCAN_RATE
+    static uint32_t matrix_timer;
+    static uint32_t matrix_scan_count;
+#endif
+
 #if (MATRIX_COLS <= 8)
 #    define print_matrix_header()  print("\nr/c 01234567\n")
 #    define print_matrix_row(row)  print_bin_reverse8(matrix_get_row(row))
@@ -60,23 +86,47 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     extern const matrix_row_t matrix_mask[];
 #endif
 
+/* The first rows can be on a port expander, and MATRIX_ROW_PINS only has the
+ * rest of them */
+#ifdef EXPANDER_MATRIX_ENABLE
+#   if (DIODE_DIRECTION != COL2ROW)
+#       error "The expander matrix only supports COL2ROW"
+#   endif
+#   define FIRST_LOCAL_ROW EXPANDER_ROWS
+#else
+#   define FIRST_LOCAL_ROW 0
+#endif
+
 #if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
-static const uint8_t row_pins[MATRIX_ROWS] = MATRIX_ROW_PINS;
+static const uint8_t row_pins[MATRIX_ROWS - FIRST_LOCAL_ROW] = MATRIX_ROW_PINS;
 static const uint8_t col_pins[MATRIX_COLS] = MATRIX_COL_PINS;
 #endif
 
+#if (DIODE_DIRECTION == COL2ROW)
+static matrix_ports_t col_ports;
+#endif
+
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
 
 static matrix_row_t matrix_debouncing[MATRIX_ROWS];
 
 
+#ifdef MATRIX_CALIBRATE_SETTLE
+    static void calibrate_settle(const uint8_t pins[], uint8_t count);
+#endif
+#ifdef MATRIX_OVERLAP_SCAN
+    static inline void settle_begin(void);
+#endif
 #if (DIODE_DIRECTION == COL2ROW)
     static void init_cols(void);
     static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row);
     static void unselect_rows(void);
     static void select_row(uint8_t row);
     static void unselect_row(uint8_t row);
+#   ifdef EXPANDER_MATRIX_ENABLE
+    static bool read_expander_rows(matrix_row_t current_matrix[]);
+#   endif
 #elif (DIODE_DIRECTION == ROW2COL)
     static void init_rows(void);
     static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col);
@@ -159,9 +209,19 @@ void matrix_init(void) {
 #if (DIODE_DIRECTION == COL2ROW)
     unselect_rows();
     init_cols();
+#   ifdef MATRIX_CALIBRATE_SETTLE
+    calibrate_settle(col_pins, MATRIX_COLS);
+#   endif
+#   ifdef EXPANDER_MATRIX_ENABLE
+    twi_queue_init();
+    expander_matrix_init();
+#   endif
 #elif (DIODE_DIRECTION == ROW2COL)
     unselect_cols();
     init_rows();
+#   ifdef MATRIX_CALIBRATE_SETTLE
+    calibrate_settle(row_pins, MATRIX_ROWS);
+#   endif
 #endif
 
     // initialize matrix state: all keys off
@@ -170,16 +230,51 @@ void matrix_init(void) {
         matrix_debouncing[i] = 0;
     }
 
+#ifdef DEBUG_MATRIX_SCAN_RATE
+    matrix_timer = timer_read32();
+    matrix_scan_count = 0;
+#endif
+
     matrix_init_quantum();
 }
 
 uint8_t matrix_scan(void)
 {
 
+#ifdef DEBUG_MATRIX_SCAN_RATE
+    matrix_scan_count++;
+
+    uint32_t timer_now = timer_read32();
+    if (TIMER_DIFF_32(timer_now, matrix_timer)>1000) {
+        print("matrix scan frequency: ");
+        pdec(matrix_scan_count);
+#   ifdef MATRIX_CALIBRATE_SETTLE
+        print(", settle time: ");
+        pdec(settle_us);
+        print("us");
+#   endif
+        print("\n");
+
+        matrix_timer = timer_now;
+        matrix_scan_count = 0;
+    }
+#endif
+
 #if (DIODE_DIRECTION == COL2ROW)
 
+#   ifdef EXPANDER_MATRIX_ENABLE
+    // The expander is read in the background while the local rows are scanned
+    expander_matrix_start();
+#   endif
+
     // Set row, read cols
-    for (uint8_t current_row = 0; current_row < MATRIX_ROWS; current_row++) {
+#   ifdef MATRIX_OVERLAP_SCAN
+    // Each row selects the next one when it's read, so only the first one is
+    // selected here
+    select_row(FIRST_LOCAL_ROW);
+    settle_begin();
+#   endif
+    for (uint8_t current_row = FIRST_LOCAL_ROW; current_row < MATRIX_ROWS; current_row++) {
 #       if (DEBOUNCING_DELAY > 0)
             bool matrix_changed = read_cols_on_row(matrix_debouncing, current_row);
 
@@ -194,9 +289,26 @@ uint8_t matrix_scan(void)
 
     }
 
+#   ifdef EXPANDER_MATRIX_ENABLE
+#       if (DEBOUNCING_DELAY > 0)
+            if (read_expander_rows(matrix_debouncing)) {
+                debouncing = true;
+                debouncing_time = timer_read();
+            }
+#       else
+            read_expander_rows(matrix);
+#       endif
+#   endif
+
 #elif (DIODE_DIRECTION == ROW2COL)
 
     // Set col, read rows
+#   ifdef MATRIX_OVERLAP_SCAN
+    // Each col selects the next one when it's read, so only the first one is
+    // selected here
+    select_col(0);
+    settle_begin();
+#   endif
     for (uint8_t current_col = 0; current_col < MATRIX_COLS; current_col++) {
 #       if (DEBOUNCING_DELAY > 0)
             bool matrix_changed = read_rows_on_col(matrix_debouncing, current_col);
@@ -273,6 +385,82 @@ uint8_t matrix_key_count(void)
 
 
 
+static inline void settle(void)
+{
+#ifdef MATRIX_CALIBRATE_SETTLE
+    for (uint8_t i = 0; i < settle_us; i++) {
+        wait_us(1);
+    }
+#else
+    wait_us(MATRIX_SETTLE_US);
+#endif
+}
+
+#ifdef MATRIX_OVERLAP_SCAN
+/* Microseconds per count of the raw timer, rounded down so that the time that
+ * already passed is never overestimated */
+#define SETTLE_US_PER_TICK (1000000 / TIMER_RAW_FREQ)
+
+// Starts the settle time of the line that was just selected
+static inline void settle_begin(void)
+{
+    settle_start = TIMER_RAW;
+}
+
+// Waits for what's left of the settle time since settle_begin
+static inline void settle_rest(void)
+{
+    uint8_t ticks = matrix_settle_ticks(settle_start, TIMER_RAW, TIMER_RAW_TOP);
+#   ifdef MATRIX_CALIBRATE_SETTLE
+    uint8_t left = matrix_settle_left_us(settle_us, ticks, SETTLE_US_PER_TICK);
+#   else
+    uint8_t left = matrix_settle_left_us(MATRIX_SETTLE_US, ticks, SETTLE_US_PER_TICK);
+#   endif
+    for (; left > 0; left--) {
+        wait_us(1);
+    }
+}
+#endif
+
+#ifdef MATRIX_CALIBRATE_SETTLE
+/* Measures how long the input lines take to rise through their pull-ups.
+ *
+ * Each line is discharged by driving it low for a moment, and is then timed
+ * until it reads high again. That's the worst case of a scan, when a key
+ * pulled the line low on the previously selected line, and it doesn't
+ * depend on which keys happen to be pressed at startup.
+ *
+ * It's a heuristic, not a search for the shortest delay that still reads the
+ * matrix correctly, so matrix_settle_us adds a margin and a floor to the
+ * slowest line.
+ */
+static void calibrate_settle(const uint8_t pins[], uint8_t count)
+{
+    uint8_t slowest = 0;
+    for (uint8_t repeat = 0; repeat < 4; repeat++) {
+        for (uint8_t x = 0; x < count; x++) {
+            uint8_t pin = pins[x];
+            _SFR_IO8((pin >> 4) + 2) &= ~_BV(pin & 0xF); // LOW
+            _SFR_IO8((pin >> 4) + 1) |=  _BV(pin & 0xF); // OUT
+            wait_us(1);
+            _SFR_IO8((pin >> 4) + 1) &= ~_BV(pin & 0xF); // IN
+            _SFR_IO8((pin >> 4) + 2) |=  _BV(pin & 0xF); // HI
+
+            uint8_t time = 0;
+            while (!(_SFR_IO8(pin >> 4) & _BV(pin & 0xF)) && time < MATRIX_SETTLE_US) {
+                wait_us(1);
+                time++;
+            }
+            if (time > slowest) {
+                slowest = time;
+            }
+        }
+    }
+
+    settle_us = matrix_settle_us(slowest);
+}
+#endif
+
 #if (DIODE_DIRECTION == COL2ROW)
 
 static void init_cols(void)
@@ -282,60 +470,97 @@ static void init_cols(void)
         _SFR_IO8((pin >> 4) + 1) &= ~_BV(pin & 0xF); // IN
         _SFR_IO8((pin >> 4) + 2) |=  _BV(pin & 0xF); // HI
     }
+    matrix_ports_init(&col_ports, col_pins);
 }
 
 static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
 {
+#ifdef MATRIX_OVERLAP_SCAN
+    // The row was selected by the previous one, wait for the rest of the
+    // settle time
+    settle_rest();
+
+    // Read the cols, each port at once (active low)
+    matrix_row_t cols = matrix_ports_read_cols(&col_ports);
+
+    // Unselect row, and select the next one so it settles while this one is
+    // stored and debounced
+    unselect_row(current_row);
+    if (current_row + 1 < MATRIX_ROWS) {
+        select_row(current_row + 1);
+        settle_begin();
+    }
+
+    matrix_row_t last_row_value = current_matrix[current_row];
+    current_matrix[current_row] = cols;
+    return (last_row_value != cols);
+#else
     // Store last value of row prior to reading
     matrix_row_t last_row_value = current_matrix[current_row];
 
-    // Clear data in matrix row
-    current_matrix[current_row] = 0;
-
     // Select row and wait for row selecton to stabilize
     select_row(current_row);
-    wait_us(30);
-
-    // For each col...
-    for(uint8_t col_index = 0; col_index < MATRIX_COLS; col_index++) {
+    settle();
 
-        // Select the col pin to read (active low)
-        uint8_t pin = col_pins[col_index];
-        uint8_t pin_state = (_SFR_IO8(pin >> 4) & _BV(pin & 0xF));
-
-        // Populate the matrix row with the state of the col pin
-        current_matrix[current_row] |=  pin_state ? 0 : (ROW_SHIFTER << col_index);
-    }
+    // Read the cols, each port at once (active low)
+    current_matrix[current_row] = matrix_ports_read_cols(&col_ports);
 
     // Unselect row
     unselect_row(current_row);
 
     return (last_row_value != current_matrix[current_row]);
+#endif
 }
 
 static void select_row(uint8_t row)
 {
-    uint8_t pin = row_pins[row];
+    uint8_t pin = row_pins[row - FIRST_LOCAL_ROW];
     _SFR_IO8((pin >> 4) + 1) |=  _BV(pin & 0xF); // OUT
     _SFR_IO8((pin >> 4) + 2) &= ~_BV(pin & 0xF); // LOW
 }
 
 static void unselect_row(uint8_t row)
 {
-    uint8_t pin = row_pins[row];
+    uint8_t pin = row_pins[row - FIRST_LOCAL_ROW];
     _SFR_IO8((pin >> 4) + 1) &= ~_BV(pin & 0xF); // IN
     _SFR_IO8((pin >> 4) + 2) |=  _BV(pin & 0xF); // HI
 }
 
 static void unselect_rows(void)
 {
-    for(uint8_t x = 0; x < MATRIX_ROWS; x++) {
+    for(uint8_t x = 0; x < MATRIX_ROWS - FIRST_LOCAL_ROW; x++) {
         uint8_t pin = row_pins[x];
         _SFR_IO8((pin >> 4) + 1) &= ~_BV(pin & 0xF); // IN
         _SFR_IO8((pin >> 4) + 2) |=  _BV(pin & 0xF); // HI
     }
 }
 
+#ifdef EXPANDER_MATRIX_ENABLE
+
+static uint8_t expander_reset_loop;
+
+static bool read_expander_rows(matrix_row_t current_matrix[])
+{
+    matrix_row_t rows[EXPANDER_ROWS];
+    if (!expander_matrix_finish(rows)) {
+        // Try to reconnect about once a second
+        if (++expander_reset_loop == 0) {
+            expander_matrix_init();
+        }
+    }
+
+    bool matrix_changed = false;
+    for (uint8_t row = 0; row < EXPANDER_ROWS; row++) {
+        if (current_matrix[row] != rows[row]) {
+            current_matrix[row] = rows[row];
+            matrix_changed = true;
+        }
+    }
+    return matrix_changed;
+}
+
+#endif
+
 #elif (DIODE_DIRECTION == ROW2COL)
 
 static void init_rows(void)
@@ -351,9 +576,29 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
 {
     bool matrix_changed = false;
 
+#ifdef MATRIX_OVERLAP_SCAN
+    // The col was selected by the previous one, wait for the rest of the
+    // settle time
+    settle_rest();
+
+    // Read all the row pins first, the col bits are set while the next col
+    // settles
+    bool low[MATRIX_ROWS];
+    for(uint8_t row_index = 0; row_index < MATRIX_ROWS; row_index++) {
+        low[row_index] = (_SFR_IO8(row_pins[row_index] >> 4) & _BV(row_pins[row_index] & 0xF)) == 0;
+    }
+
+    // Unselect col, and select the next one
+    unselect_col(current_col);
+    if (current_col + 1 < MATRIX_COLS) {
+        select_col(current_col + 1);
+        settle_begin();
+    }
+#else
     // Select col and wait for col selecton to stabilize
     select_col(current_col);
-    wait_us(30);
+    settle();
+#endif
 
     // For each row...
     for(uint8_t row_index = 0; row_index < MATRIX_ROWS; row_index++)
@@ -363,7 +608,11 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
         matrix_row_t last_row_value = current_matrix[row_index];
 
         // Check row pin state
+#ifdef MATRIX_OVERLAP_SCAN
+        if (low[row_index])
+#else
         if ((_SFR_IO8(row_pins[row_index] >> 4) & _BV(row_pins[row_index] & 0xF)) == 0)
+#endif
         {
             // Pin LO, set col bit
             current_matrix[row_index] |= (ROW_SHIFTER << current_col);
@@ -381,8 +630,10 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
         }
     }
 
+#ifndef MATRIX_OVERLAP_SCAN
     // Unselect col
     unselect_col(current_col);
+#endif
 
     return matrix_changed;
 }
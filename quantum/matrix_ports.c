@@ -0,0 +1,35 @@
+#include "matrix_ports.h"
+
+void matrix_ports_init(matrix_ports_t* ports, const uint8_t* col_pins) {
+    ports->num_ports = 0;
+    uint8_t stored = 0;
+    // Collect the columns port by port, in the order the ports first appear
+    for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+        uint8_t address = col_pins[col] >> 4;
+        bool seen = false;
+        for (uint8_t i = 0; i < ports->num_ports; i++) {
+            if (ports->ports[i].address == address) {
+                seen = true;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+
+        matrix_port_t* port = &ports->ports[ports->num_ports++];
+        port->address = address;
+        port->mask = 0;
+        port->first = stored;
+        port->count = 0;
+        for (uint8_t other = col; other < MATRIX_COLS; other++) {
+            if (col_pins[other] >> 4 == address) {
+                uint8_t mask = 1 << (col_pins[other] & 0xF);
+                port->mask |= mask;
+                port->count++;
+                ports->pin_masks[stored] = mask;
+                ports->col_bits[stored] = (matrix_row_t)1 << other;
+                stored++;
+            }
+        }
+    }
+}
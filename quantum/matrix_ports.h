@@ -0,0 +1,64 @@
+#ifndef MATRIX_PORTS_H
+#define MATRIX_PORTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#ifdef __AVR__
+#include <avr/io.h>
+#endif
+#include "matrix.h"
+
+// The column pins of the matrix grouped by port, so that each port is read
+// only once per row. The pins are encoded like in config_common.h, the PIN
+// register address in the high nibble and the bit in the low nibble.
+//
+// The grouping is done once by matrix_ports_init. The columns of a port are
+// stored next to each other with their bit in the port and their bit in the
+// row, so the reading doesn't need any of the variable shifts that are slow
+// on the AVR. A port where no column is pulled low is skipped entirely,
+// which is the case for almost every row.
+
+// Reads the port at the given address. The tests define MATRIX_PORTS_READ
+// as the name of their own read function.
+#ifdef MATRIX_PORTS_READ
+uint8_t MATRIX_PORTS_READ(uint8_t address);
+#else
+#define MATRIX_PORTS_READ(address) _SFR_IO8(address)
+#endif
+
+typedef struct {
+    uint8_t address;
+    // All the column bits of the port
+    uint8_t mask;
+    // The columns of the port in pin_masks and col_bits
+    uint8_t first;
+    uint8_t count;
+} matrix_port_t;
+
+typedef struct {
+    uint8_t num_ports;
+    matrix_port_t ports[MATRIX_COLS];
+    uint8_t pin_masks[MATRIX_COLS];
+    matrix_row_t col_bits[MATRIX_COLS];
+} matrix_ports_t;
+
+void matrix_ports_init(matrix_ports_t* ports, const uint8_t* col_pins);
+
+// Returns the columns that are pulled low
+static inline matrix_row_t matrix_ports_read_cols(const matrix_ports_t* ports) {
+    matrix_row_t row = 0;
+    for (uint8_t i = 0; i < ports->num_ports; i++) {
+        const matrix_port_t* port = &ports->ports[i];
+        uint8_t low = ~MATRIX_PORTS_READ(port->address) & port->mask;
+        if (low) {
+            for (uint8_t col = port->first; col < port->first + port->count; col++) {
+                if (low & ports->pin_masks[col]) {
+                    row |= ports->col_bits[col];
+                }
+            }
+        }
+    }
+    return row;
+}
+
+#endif
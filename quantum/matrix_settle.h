@@ -0,0 +1,62 @@
+#ifndef MATRIX_SETTLE_H
+#define MATRIX_SETTLE_H
+
+#include <stdint.h>
+
+/* How long a line takes to settle after it's selected, in us. Most of it is
+ * the time a line that was pulled low by a key on the previously selected
+ * line needs to rise through its pull-up.
+ *
+ * With MATRIX_CALIBRATE_SETTLE this is only the upper bound, and the actual
+ * time is measured at startup, see calibrate_settle in matrix.c.
+ */
+#ifndef MATRIX_SETTLE_US
+#   define MATRIX_SETTLE_US 30
+#endif
+
+/* The calibration is a heuristic. It times a bare input pin rising through
+ * its pull-up, not the shortest wait that still reads a stable matrix, and it
+ * misses the switch, the diode and the wiring of a pressed key, so on a fast
+ * MCU it can measure next to nothing. The calibrated settle time is never
+ * shorter than this.
+ */
+#ifndef MATRIX_SETTLE_MIN_US
+#   define MATRIX_SETTLE_MIN_US 10
+#endif
+
+/* Added to twice the measured time, for the supply and temperature changes
+ * since the calibration */
+#ifndef MATRIX_SETTLE_MARGIN_US
+#   define MATRIX_SETTLE_MARGIN_US 4
+#endif
+
+// Returns the settle time for the slowest measured line, in us
+static inline uint8_t matrix_settle_us(uint8_t slowest) {
+    uint16_t settle_us = slowest * 2 + MATRIX_SETTLE_MARGIN_US;
+    if (settle_us < MATRIX_SETTLE_MIN_US) {
+        settle_us = MATRIX_SETTLE_MIN_US;
+    }
+    if (settle_us > MATRIX_SETTLE_US) {
+        settle_us = MATRIX_SETTLE_US;
+    }
+    return settle_us;
+}
+
+// Returns the counts of a timer that wraps after top, from start to now
+static inline uint8_t matrix_settle_ticks(uint8_t start, uint8_t now, uint8_t top) {
+    if (now >= start) {
+        return now - start;
+    }
+    return (uint16_t)now + top + 1 - start;
+}
+
+// Returns the part of the settle time that is left, when the line was
+// selected the given timer counts ago. A count only guarantees one tick
+// less than that, since the line can be selected right before the timer
+// counts.
+static inline uint8_t matrix_settle_left_us(uint8_t settle_us, uint8_t ticks, uint8_t us_per_tick) {
+    uint16_t elapsed = ticks ? (uint16_t)(ticks - 1) * us_per_tick : 0;
+    return elapsed < settle_us ? settle_us - elapsed : 0;
+}
+
+#endif
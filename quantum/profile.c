@@ -0,0 +1,169 @@
+#include "profile.h"
+#include "print.h"
+#include <string.h>
+
+#ifdef RAW_ENABLE
+#include "raw_hid.h"
+#endif
+
+profile_stats_t profile_stats[PROFILE_SECTIONS];
+uint16_t profile_latency[PROFILE_LATENCY_BUCKETS];
+uint16_t profile_scan_rate;
+
+static uint32_t second_begin;
+static uint16_t second_scans;
+
+static bool event_pending;
+static uint32_t event_time;
+
+#define PROFILE_TICKS_PER_SECOND ((uint32_t)PROFILE_TICKS_PER_MS * 1000)
+
+void profile_reset(void) {
+    memset(profile_stats, 0, sizeof(profile_stats));
+    memset(profile_latency, 0, sizeof(profile_latency));
+    profile_scan_rate = 0;
+    second_begin = profile_time();
+    second_scans = 0;
+    event_pending = false;
+}
+
+uint32_t profile_to_us(uint32_t ticks) {
+    return ticks * 1000 / PROFILE_TICKS_PER_MS;
+}
+
+static void count_scan(uint32_t now) {
+    second_scans++;
+    if (now - second_begin >= PROFILE_TICKS_PER_SECOND) {
+        profile_scan_rate = second_scans;
+        second_scans = 0;
+        second_begin = now;
+    }
+}
+
+void profile_add(profile_section_t section, uint32_t begin) {
+    uint32_t now = profile_time();
+    uint32_t elapsed = now - begin;
+    uint16_t duration = elapsed > UINT16_MAX ? UINT16_MAX : elapsed;
+
+    profile_stats_t* stats = &profile_stats[section];
+    if (stats->total > UINT32_MAX - duration) {
+        stats->total /= 2;
+        stats->count /= 2;
+    }
+    if (stats->count == 0 || duration < stats->min) {
+        stats->min = duration;
+    }
+    if (duration > stats->max) {
+        stats->max = duration;
+    }
+    stats->total += duration;
+    stats->count++;
+
+    if (section == PROFILE_MATRIX_SCAN) {
+        count_scan(now);
+    }
+}
+
+void profile_key_event(void) {
+    if (!event_pending) {
+        event_pending = true;
+        event_time = profile_time();
+    }
+}
+
+void profile_report_sent(void) {
+    if (!event_pending) {
+        return;
+    }
+    event_pending = false;
+    // Compared at four times the latency, so that the 250us of the first
+    // bucket also works with the millisecond ticks
+    uint32_t latency = profile_time() - event_time;
+    uint8_t bucket = 0;
+    while (bucket < PROFILE_LATENCY_BUCKETS - 1 &&
+           latency * 4 >= (uint32_t)PROFILE_TICKS_PER_MS << bucket) {
+        bucket++;
+    }
+    if (profile_latency[bucket] < UINT16_MAX) {
+        profile_latency[bucket]++;
+    }
+}
+
+static uint32_t average(const profile_stats_t* stats) {
+    return stats->count ? stats->total / stats->count : 0;
+}
+
+static void print_stats(const profile_stats_t* stats) {
+    xprintf("n %lu avg %luus min %luus max %luus\n", stats->count,
+        profile_to_us(average(stats)), profile_to_us(stats->min),
+        profile_to_us(stats->max));
+}
+
+void profile_print(void) {
+    print("\n\t- Profile -\n");
+    print("matrix_scan: ");
+    print_stats(&profile_stats[PROFILE_MATRIX_SCAN]);
+    print("keyboard_task: ");
+    print_stats(&profile_stats[PROFILE_KEYBOARD_TASK]);
+    print("action_exec: ");
+    print_stats(&profile_stats[PROFILE_ACTION_EXEC]);
+    print("host_keyboard_send: ");
+    print_stats(&profile_stats[PROFILE_HOST_SEND]);
+    xprintf("scans/s: %u\n", profile_scan_rate);
+    print("latency:");
+    for (uint8_t bucket = 0; bucket < PROFILE_LATENCY_BUCKETS - 1; bucket++) {
+        xprintf(" <%uus %u", 250U << bucket, profile_latency[bucket]);
+    }
+    xprintf(" more %u\n", profile_latency[PROFILE_LATENCY_BUCKETS - 1]);
+}
+
+static uint8_t* put16(uint8_t* data, uint16_t value) {
+    *data++ = value;
+    *data++ = value >> 8;
+    return data;
+}
+
+static uint8_t* put32(uint8_t* data, uint32_t value) {
+    data = put16(data, value);
+    return put16(data, value >> 16);
+}
+
+bool profile_raw_hid_receive(uint8_t* data, uint8_t length) {
+    if (length < 4 + 2 * PROFILE_LATENCY_BUCKETS || data[0] != PROFILE_RAW_HID_ID) {
+        return false;
+    }
+
+    uint8_t* out = data + 2;
+    switch (data[1]) {
+    case PROFILE_RAW_HID_READ_SECTION: {
+        if (data[2] >= PROFILE_SECTIONS) {
+            data[1] = PROFILE_RAW_HID_UNKNOWN;
+            break;
+        }
+        const profile_stats_t* stats = &profile_stats[data[2]];
+        out++;
+        out = put32(out, stats->count);
+        out = put32(out, profile_to_us(average(stats)));
+        out = put32(out, profile_to_us(stats->min));
+        out = put32(out, profile_to_us(stats->max));
+        break;
+    }
+    case PROFILE_RAW_HID_READ_LATENCY:
+        out = put16(out, profile_scan_rate);
+        for (uint8_t bucket = 0; bucket < PROFILE_LATENCY_BUCKETS; bucket++) {
+            out = put16(out, profile_latency[bucket]);
+        }
+        break;
+    case PROFILE_RAW_HID_RESET:
+        profile_reset();
+        break;
+    default:
+        data[1] = PROFILE_RAW_HID_UNKNOWN;
+        break;
+    }
+
+#ifdef RAW_ENABLE
+    raw_hid_send(data, length);
+#endif
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+// A profiler for the main loop, enabled with PROFILE_ENABLE = yes in the
+// rules.mk. It keeps the count, average, minimum and maximum time spent in a
+// few sections of the firmware, the number of matrix scans per second, and a
+// histogram of the time from a key event to the keyboard report it causes.
+//
+// The results are printed by the p command of the console, and can be read
+// over raw HID, see profile_raw_hid_receive. When the profiler is disabled
+// the macros below expand to nothing.
+//
+// The time is measured in ticks of profile_time. On the AVR that's the raw
+// count of timer0, which gives 4us at 16MHz, elsewhere it's just the
+// millisecond timer.
+
+#ifndef PROFILE_TICKS_PER_MS
+#   if defined(__AVR__)
+#       define PROFILE_TICKS_PER_MS (TIMER_RAW_TOP + 1)
+#   else
+#       define PROFILE_TICKS_PER_MS 1
+#   endif
+#endif
+
+// The first byte of a raw HID packet that's meant for the profiler
+#ifndef PROFILE_RAW_HID_ID
+#define PROFILE_RAW_HID_ID 0xB0
+#endif
+
+// The raw HID commands, in the second byte of the packet
+#define PROFILE_RAW_HID_READ_SECTION 0x01
+#define PROFILE_RAW_HID_READ_LATENCY 0x02
+#define PROFILE_RAW_HID_RESET        0x03
+#define PROFILE_RAW_HID_UNKNOWN      0xFF
+
+typedef enum {
+    PROFILE_MATRIX_SCAN,
+    PROFILE_KEYBOARD_TASK,
+    PROFILE_ACTION_EXEC,
+    PROFILE_HOST_SEND,
+    PROFILE_SECTIONS
+} profile_section_t;
+
+// The latency buckets double in size, the first one is below 250us and the
+// last one is everything from 16ms on
+#define PROFILE_LATENCY_BUCKETS 8
+
+typedef struct {
+    uint32_t count;
+    // Halved together with the count when it would overflow, so that the
+    // average stays right
+    uint32_t total;
+    uint16_t min;
+    uint16_t max;
+} profile_stats_t;
+
+extern profile_stats_t profile_stats[PROFILE_SECTIONS];
+extern uint16_t profile_latency[PROFILE_LATENCY_BUCKETS];
+// The scans counted during the last full second
+extern uint16_t profile_scan_rate;
+
+#ifdef PROFILE_ENABLE
+
+#define PROFILE_BEGIN(section) uint32_t profile_begin_##section = profile_time()
+#define PROFILE_END(section) profile_add(section, profile_begin_##section)
+
+// A key event was seen, the latency is measured from the first one that
+// hasn't been reported yet
+#define PROFILE_KEY_EVENT() profile_key_event()
+// A keyboard report was sent to the host
+#define PROFILE_REPORT_SENT() profile_report_sent()
+
+#else
+
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+#define PROFILE_KEY_EVENT()
+#define PROFILE_REPORT_SENT()
+
+#endif
+
+// Implemented by profile_timer.c
+uint32_t profile_time(void);
+
+void profile_reset(void);
+void profile_print(void);
+uint32_t profile_to_us(uint32_t ticks);
+
+// Call from raw_hid_receive, returns true and sends the answer when the
+// packet was for the profiler. The answer starts with the same two bytes as
+// the request, followed by the little endian values, all times in us.
+//
+// READ_SECTION, with the section in the third byte:
+//   section, count (4 bytes), average (4), min (4), max (4)
+// READ_LATENCY:
+//   scan rate (2), the latency buckets (2 each)
+// RESET clears everything, and has no values.
+bool profile_raw_hid_receive(uint8_t* data, uint8_t length);
+
+// Don't call directly, use the macros instead
+void profile_add(profile_section_t section, uint32_t begin);
+void profile_key_event(void);
+void profile_report_sent(void);
+
+#endif
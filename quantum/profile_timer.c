@@ -0,0 +1,40 @@
+// The clock of the profiler. On the AVR it reads timer0, which counts up to
+// TIMER_RAW_TOP once per millisecond, together with the millisecond count.
+// Elsewhere the profiler falls back to the millisecond timer.
+
+#include "profile.h"
+
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <util/atomic.h>
+
+#ifndef __AVR_ATmega32A__
+#define PROFILE_TIMER_FLAGS TIFR0
+#define PROFILE_TIMER_MATCH OCF0A
+#else
+#define PROFILE_TIMER_FLAGS TIFR
+#define PROFILE_TIMER_MATCH OCF0
+#endif
+
+uint32_t profile_time(void) {
+    uint32_t count;
+    uint8_t raw;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        count = timer_count;
+        raw = TIMER_RAW;
+        // The timer wrapped, but the interrupt hasn't counted it yet
+        if ((PROFILE_TIMER_FLAGS & _BV(PROFILE_TIMER_MATCH)) && raw < TIMER_RAW_TOP / 2) {
+            count++;
+        }
+    }
+    return count * PROFILE_TICKS_PER_MS + raw;
+}
+
+#else
+
+uint32_t profile_time(void) {
+    return timer_read32();
+}
+
+#endif
@@ -1,6 +1,9 @@
-#include <avr/eeprom.h>
+#include <stdint.h>
+#ifdef __AVR__
 #include <avr/interrupt.h>
-#include <util/delay.h>
+#endif
+#include "eeprom.h"
+#include "wait.h"
 #include "progmem.h"
 #include "timer.h"
 #include "rgblight.h"
@@ -37,35 +40,6 @@ const uint8_t DIM_CURVE[] PROGMEM = {
     242, 245, 247, 250, 252, 255,
     };
 
-const uint8_t RGBLED_BREATHING_TABLE[] PROGMEM = {
-  0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 4, 5, 5, 6, 7, 9,
-  10, 11, 12, 14, 15, 17, 18, 20, 21, 23, 25, 27, 29, 31, 33, 35,
-  37, 40, 42, 44, 47, 49, 52, 54, 57, 59, 62, 65, 67, 70, 73, 76,
-  79, 82, 85, 88, 90, 93, 97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
-  127, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
-  176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
-  218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
-  245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
-  255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
-  245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
-  218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
-  176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
-  128, 124, 121, 118, 115, 112, 109, 106, 103, 100, 97, 93, 90, 88, 85, 82,
-  79, 76, 73, 70, 67, 65, 62, 59, 57, 54, 52, 49, 47, 44, 42, 40,
-  37, 35, 33, 31, 29, 27, 25, 23, 21, 20, 18, 17, 15, 14, 12, 11,
-  10, 9, 7, 6, 5, 5, 4, 3, 2, 2, 1, 1, 1, 0, 0, 0
-};
-
-__attribute__ ((weak))
-const uint8_t RGBLED_BREATHING_INTERVALS[] PROGMEM = {30, 20, 10, 5};
-__attribute__ ((weak))
-const uint8_t RGBLED_RAINBOW_MOOD_INTERVALS[] PROGMEM = {120, 60, 30};
-__attribute__ ((weak))
-const uint8_t RGBLED_RAINBOW_SWIRL_INTERVALS[] PROGMEM = {100, 50, 20};
-__attribute__ ((weak))
-const uint8_t RGBLED_SNAKE_INTERVALS[] PROGMEM = {100, 50, 20};
-__attribute__ ((weak))
-const uint8_t RGBLED_KNIGHT_INTERVALS[] PROGMEM = {100, 50, 20};
 __attribute__ ((weak))
 const uint16_t RGBLED_GRADIENT_RANGES[] PROGMEM = {360, 240, 180, 120, 90};
 
@@ -255,6 +229,7 @@ void rgblight_mode(uint8_t mode) {
     // MODE 21-23, knight
 
     #ifdef RGBLIGHT_ANIMATIONS
+      rgblight_animation_start();
       rgblight_timer_enable();
     #endif
   } else if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
@@ -263,6 +238,14 @@ void rgblight_mode(uint8_t mode) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
     #endif
+  } else if (rgblight_config.mode >= 35 && rgblight_config.mode <= 36) {
+    // MODE 35, reactive decay
+    // MODE 36, reactive ripple
+
+    #if defined(RGBLIGHT_ANIMATIONS) && defined(RGBLIGHT_REACTIVE)
+      rgblight_reactive_start();
+      rgblight_timer_enable();
+    #endif
   }
   rgblight_sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
 }
@@ -277,7 +260,7 @@ void rgblight_toggle(void) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
     #endif
-    _delay_ms(50);
+    wait_ms(50);
     rgblight_set();
   }
 }
@@ -460,187 +443,22 @@ void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void rgblight_task(void) {
-  if (rgblight_timer_enabled) {
-    // mode = 1, static light, do nothing here
-    if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
-      // mode = 2 to 5, breathing mode
-      rgblight_effect_breathing(rgblight_config.mode - 2);
-    } else if (rgblight_config.mode >= 6 && rgblight_config.mode <= 8) {
-      // mode = 6 to 8, rainbow mood mod
-      rgblight_effect_rainbow_mood(rgblight_config.mode - 6);
-    } else if (rgblight_config.mode >= 9 && rgblight_config.mode <= 14) {
-      // mode = 9 to 14, rainbow swirl mode
-      rgblight_effect_rainbow_swirl(rgblight_config.mode - 9);
-    } else if (rgblight_config.mode >= 15 && rgblight_config.mode <= 20) {
-      // mode = 15 to 20, snake mode
-      rgblight_effect_snake(rgblight_config.mode - 15);
-    } else if (rgblight_config.mode >= 21 && rgblight_config.mode <= 23) {
-      // mode = 21 to 23, knight mode
-      rgblight_effect_knight(rgblight_config.mode - 21);
-    } else if (rgblight_config.mode == 24) {
-      // mode = 24, christmas mode
-      rgblight_effect_christmas();
-    }
-  }
-}
-
-// Effects
-void rgblight_effect_breathing(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
-
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval])) {
-    return;
-  }
-  last_timer = timer_read();
-
-  rgblight_sethsv_noeeprom(rgblight_config.hue, rgblight_config.sat, pgm_read_byte(&RGBLED_BREATHING_TABLE[pos]));
-  pos = (pos + 1) % 256;
-}
-void rgblight_effect_rainbow_mood(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
-
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval])) {
-    return;
-  }
-  last_timer = timer_read();
-  rgblight_sethsv_noeeprom(current_hue, rgblight_config.sat, rgblight_config.val);
-  current_hue = (current_hue + 1) % 360;
-}
-void rgblight_effect_rainbow_swirl(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval / 2])) {
-    return;
-  }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
-  }
-  rgblight_set();
-
-  if (interval % 2) {
-    current_hue = (current_hue + 1) % 360;
-  } else {
-    if (current_hue - 1 < 0) {
-      current_hue = 359;
-    } else {
-      current_hue = current_hue - 1;
-    }
-  }
-}
-void rgblight_effect_snake(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
-  uint8_t i, j;
-  int8_t k;
-  int8_t increment = 1;
-  if (interval % 2) {
-    increment = -1;
-  }
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2])) {
-    return;
+  // mode = 1, static light, do nothing here
+  if (rgblight_timer_enabled &&
+      rgblight_config.mode >= RGBLIGHT_ANIMATION_FIRST_MODE &&
+      rgblight_config.mode <= RGBLIGHT_ANIMATION_LAST_MODE) {
+    rgblight_animation_task(&rgblight_animations[rgblight_config.mode - RGBLIGHT_ANIMATION_FIRST_MODE],
+      rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
+  }
+  #ifdef RGBLIGHT_REACTIVE
+  else if (rgblight_timer_enabled && rgblight_config.mode == RGBLIGHT_REACTIVE_DECAY_MODE) {
+    rgblight_reactive_task(RGBLIGHT_REACTIVE_DECAY_EFFECT,
+      rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
+  } else if (rgblight_timer_enabled && rgblight_config.mode == RGBLIGHT_REACTIVE_RIPPLE_MODE) {
+    rgblight_reactive_task(RGBLIGHT_REACTIVE_RIPPLE_EFFECT,
+      rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
   }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    led[i].r = 0;
-    led[i].g = 0;
-    led[i].b = 0;
-    for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
-      k = pos + j * increment;
-      if (k < 0) {
-        k = k + RGBLED_NUM;
-      }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[i]);
-      }
-    }
-  }
-  rgblight_set();
-  if (increment == 1) {
-    if (pos - 1 < 0) {
-      pos = RGBLED_NUM - 1;
-    } else {
-      pos -= 1;
-    }
-  } else {
-    pos = (pos + 1) % RGBLED_NUM;
-  }
-}
-void rgblight_effect_knight(uint8_t interval) {
-  static int8_t pos = 0;
-  static uint16_t last_timer = 0;
-  uint8_t i, j, cur;
-  int8_t k;
-  LED_TYPE preled[RGBLED_NUM];
-  static int8_t increment = -1;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval])) {
-    return;
-  }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    preled[i].r = 0;
-    preled[i].g = 0;
-    preled[i].b = 0;
-    for (j = 0; j < RGBLIGHT_EFFECT_KNIGHT_LENGTH; j++) {
-      k = pos + j * increment;
-      if (k < 0) {
-        k = 0;
-      }
-      if (k >= RGBLED_NUM) {
-        k = RGBLED_NUM - 1;
-      }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&preled[i]);
-      }
-    }
-  }
-  if (RGBLIGHT_EFFECT_KNIGHT_OFFSET) {
-    for (i = 0; i < RGBLED_NUM; i++) {
-      cur = (i + RGBLIGHT_EFFECT_KNIGHT_OFFSET) % RGBLED_NUM;
-      led[i].r = preled[cur].r;
-      led[i].g = preled[cur].g;
-      led[i].b = preled[cur].b;
-    }
-  }
-  rgblight_set();
-  if (increment == 1) {
-    if (pos - 1 < 0 - RGBLIGHT_EFFECT_KNIGHT_LENGTH) {
-      pos = 0 - RGBLIGHT_EFFECT_KNIGHT_LENGTH;
-      increment = -1;
-    } else {
-      pos -= 1;
-    }
-  } else {
-    if (pos + 1 > RGBLED_NUM + RGBLIGHT_EFFECT_KNIGHT_LENGTH) {
-      pos = RGBLED_NUM + RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
-      increment = 1;
-    } else {
-      pos += 1;
-    }
-  }
-}
-
-
-void rgblight_effect_christmas(void) {
-  static uint16_t current_offset = 0;
-  static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL) {
-    return;
-  }
-  last_timer = timer_read();
-  current_offset = (current_offset + 1) % 2;
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = 0 + ((i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2) * 120;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
-  }
-  rgblight_set();
+  #endif
 }
 
 #endif
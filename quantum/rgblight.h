@@ -1,7 +1,9 @@
 #ifndef RGBLIGHT_H
 #define RGBLIGHT_H
 
-#ifdef RGBLIGHT_ANIMATIONS
+#if defined(RGBLIGHT_ANIMATIONS) && defined(RGBLIGHT_REACTIVE)
+	#define RGBLIGHT_MODES 36
+#elif defined(RGBLIGHT_ANIMATIONS)
 	#define RGBLIGHT_MODES 34
 #else
 	#define RGBLIGHT_MODES 1
@@ -46,7 +48,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "eeconfig.h"
+#include "progmem.h"
 #include "light_ws2812.h"
+#include "rgblight_animation.h"
+#include "rgblight_reactive.h"
 
 extern LED_TYPE led[RGBLED_NUM];
 
@@ -56,6 +61,15 @@ extern const uint8_t RGBLED_RAINBOW_SWIRL_INTERVALS[3] PROGMEM;
 extern const uint8_t RGBLED_SNAKE_INTERVALS[3] PROGMEM;
 extern const uint8_t RGBLED_KNIGHT_INTERVALS[3] PROGMEM;
 
+// The animated modes, starting from RGBLIGHT_ANIMATION_FIRST_MODE
+#define RGBLIGHT_ANIMATION_FIRST_MODE 2
+#define RGBLIGHT_ANIMATION_LAST_MODE 24
+extern const rgblight_animation_t rgblight_animations[] PROGMEM;
+
+// The reactive modes, when RGBLIGHT_REACTIVE is defined
+#define RGBLIGHT_REACTIVE_DECAY_MODE 35
+#define RGBLIGHT_REACTIVE_RIPPLE_MODE 36
+
 typedef union {
   uint32_t raw;
   struct {
@@ -104,11 +118,5 @@ void rgblight_timer_init(void);
 void rgblight_timer_enable(void);
 void rgblight_timer_disable(void);
 void rgblight_timer_toggle(void);
-void rgblight_effect_breathing(uint8_t interval);
-void rgblight_effect_rainbow_mood(uint8_t interval);
-void rgblight_effect_rainbow_swirl(uint8_t interval);
-void rgblight_effect_snake(uint8_t interval);
-void rgblight_effect_knight(uint8_t interval);
-void rgblight_effect_christmas(void);
 
 #endif
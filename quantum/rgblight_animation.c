@@ -0,0 +1,163 @@
+#include <string.h>
+#include "progmem.h"
+#include "timer.h"
+#include "rgblight.h"
+#include "rgblight_animation.h"
+
+typedef struct {
+    uint16_t phase;
+    int8_t direction;
+} rgblight_channel_state_t;
+
+static rgblight_channel_state_t hue_state;
+static rgblight_channel_state_t val_state;
+static uint16_t last_timer = 0;
+static bool frame_pending = true;
+
+void rgblight_animation_start(void) {
+    hue_state.phase = 0;
+    hue_state.direction = 1;
+    val_state.phase = 0;
+    val_state.direction = 1;
+    frame_pending = true;
+}
+
+static uint16_t wrap_step(int16_t step, uint16_t period) {
+    int16_t ret = step % (int16_t)period;
+    return ret < 0 ? ret + period : ret;
+}
+
+static uint16_t channel_value(const rgblight_channel_t* channel, uint16_t position) {
+    if (channel->num_keyframes == 0) {
+        return position;
+    }
+    const rgblight_keyframe_t* keyframe = channel->keyframes;
+    const rgblight_keyframe_t* last = channel->keyframes + channel->num_keyframes - 1;
+    while (keyframe != last && pgm_read_word(&(keyframe + 1)->position) <= position) {
+        keyframe++;
+    }
+    uint16_t value = pgm_read_word(&keyframe->value);
+    uint16_t start = pgm_read_word(&keyframe->position);
+    if (keyframe == last || position <= start || (channel->flags & RGBLIGHT_CHANNEL_STEP)) {
+        return value;
+    }
+    uint16_t end = pgm_read_word(&(keyframe + 1)->position);
+    int16_t delta = pgm_read_word(&(keyframe + 1)->value) - value;
+    return value + (int32_t)delta * (position - start) / (end - start);
+}
+
+// The position of a channel is tracked incrementally from LED to LED, so
+// that rendering a frame doesn't involve any multiplications
+typedef struct {
+    uint16_t start;
+    uint16_t position;
+    uint16_t step;
+} channel_cursor_t;
+
+static void cursor_init(channel_cursor_t* cursor, const rgblight_channel_t* channel,
+    const rgblight_channel_state_t* state, uint8_t led_offset) {
+    uint16_t period = channel->period;
+    cursor->step = wrap_step(channel->led_step, period);
+    cursor->start = (state->phase + wrap_step(channel->origin, period)) % period;
+    cursor->position = (cursor->start + (uint32_t)led_offset * cursor->step) % period;
+}
+
+static void cursor_next(channel_cursor_t* cursor, uint16_t period, bool wrapped) {
+    if (wrapped) {
+        cursor->position = cursor->start;
+    } else {
+        cursor->position += cursor->step;
+        if (cursor->position >= period) {
+            cursor->position -= period;
+        }
+    }
+}
+
+static void render_frame(const rgblight_animation_t* anim, uint16_t hue, uint8_t sat, uint8_t val,
+    LED_TYPE* leds, uint8_t num_leds) {
+    channel_cursor_t hue_cursor;
+    channel_cursor_t val_cursor;
+    uint8_t led = anim->led_offset % num_leds;
+    if (anim->hue.period) {
+        cursor_init(&hue_cursor, &anim->hue, &hue_state, led);
+    }
+    if (anim->val.period) {
+        cursor_init(&val_cursor, &anim->val, &val_state, led);
+    }
+    for (uint8_t i = 0; i < num_leds; i++) {
+        uint16_t led_hue = hue;
+        uint8_t led_val = val;
+        bool wrapped = ++led == num_leds;
+        if (wrapped) {
+            led = 0;
+        }
+        if (anim->hue.period) {
+            led_hue = channel_value(&anim->hue, hue_cursor.position) % 360;
+            cursor_next(&hue_cursor, anim->hue.period, wrapped);
+        }
+        if (anim->val.period) {
+            uint16_t v = channel_value(&anim->val, val_cursor.position);
+            led_val = v > 255 ? 255 : v;
+            if (!(anim->val.flags & RGBLIGHT_CHANNEL_ABSOLUTE)) {
+                led_val = led_val * val / 255;
+            }
+            cursor_next(&val_cursor, anim->val.period, wrapped);
+        }
+        sethsv(led_hue, sat, led_val, &leds[i]);
+    }
+}
+
+static void advance_channel(const rgblight_channel_t* channel, rgblight_channel_state_t* state) {
+    if (!channel->period) {
+        return;
+    }
+    if (channel->flags & RGBLIGHT_CHANNEL_PINGPONG) {
+        int16_t step = channel->time_step * state->direction;
+        int16_t next = state->phase + step;
+        if (next < 0 || next >= (int16_t)channel->period) {
+            state->direction = -state->direction;
+            next = state->phase - step;
+        }
+        state->phase = next;
+    } else {
+        state->phase += wrap_step(channel->time_step, channel->period);
+        if (state->phase >= channel->period) {
+            state->phase -= channel->period;
+        }
+    }
+}
+
+static void advance_frame(const rgblight_animation_t* anim) {
+    advance_channel(&anim->hue, &hue_state);
+    advance_channel(&anim->val, &val_state);
+}
+
+void rgblight_animation_render(const rgblight_animation_t* animation, uint16_t hue, uint8_t sat, uint8_t val,
+    LED_TYPE* leds, uint8_t num_leds) {
+    rgblight_animation_t anim;
+    memcpy_P(&anim, animation, sizeof(anim));
+    render_frame(&anim, hue, sat, val, leds, num_leds);
+}
+
+void rgblight_animation_advance(const rgblight_animation_t* animation) {
+    rgblight_animation_t anim;
+    memcpy_P(&anim, animation, sizeof(anim));
+    advance_frame(&anim);
+}
+
+void rgblight_animation_task(const rgblight_animation_t* animation, uint16_t hue, uint8_t sat, uint8_t val) {
+    rgblight_animation_t anim;
+    memcpy_P(&anim, animation, sizeof(anim));
+    uint16_t interval = anim.interval;
+    if (anim.intervals) {
+        interval = pgm_read_byte(&anim.intervals[interval]);
+    }
+    if (!frame_pending && timer_elapsed(last_timer) < interval) {
+        return;
+    }
+    frame_pending = false;
+    last_timer = timer_read();
+    render_frame(&anim, hue, sat, val, led, RGBLED_NUM);
+    rgblight_set();
+    advance_frame(&anim);
+}
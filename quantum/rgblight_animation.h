@@ -0,0 +1,68 @@
+#ifndef RGBLIGHT_ANIMATION_H
+#define RGBLIGHT_ANIMATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "light_ws2812.h"
+
+// A declarative description of the rgblight animations.
+//
+// Each animation has a hue and a value channel. A channel has a position
+// for every LED, which is the sum of a phase that advances every frame, a
+// constant origin and a per LED step, wrapped at the period. The position
+// is then mapped to the output through a list of keyframes.
+//
+// All animations share the same timer and the same render pass, and only
+// the state of the currently running animation is kept in RAM.
+
+// Jump between the keyframe values instead of interpolating linearly
+#define RGBLIGHT_CHANNEL_STEP     (1 << 0)
+// Bounce the phase between 0 and the period instead of wrapping around
+#define RGBLIGHT_CHANNEL_PINGPONG (1 << 1)
+// Use the keyframe values as they are, instead of scaling them by the
+// configured value
+#define RGBLIGHT_CHANNEL_ABSOLUTE (1 << 2)
+
+typedef struct {
+    uint16_t position;
+    uint16_t value;
+} rgblight_keyframe_t;
+
+typedef struct {
+    // Keyframes in PROGMEM, sorted by position. If there are no keyframes
+    // the position itself is used as the value
+    const rgblight_keyframe_t* keyframes;
+    uint8_t num_keyframes;
+    uint8_t flags;
+    // A period of zero disables the channel, and the configured hue or
+    // value is used instead
+    uint16_t period;
+    int16_t origin;
+    int16_t led_step;
+    int8_t time_step;
+} rgblight_channel_t;
+
+typedef struct {
+    // Frame interval in ms, read from intervals[interval] if there's an
+    // interval table, otherwise interval is the frame interval itself
+    const uint8_t* intervals;
+    uint16_t interval;
+    // Rotates the LEDs, before the channels are evaluated
+    uint8_t led_offset;
+    // The hue is absolute, while the value is scaled by the configured value
+    // unless the channel is RGBLIGHT_CHANNEL_ABSOLUTE
+    rgblight_channel_t hue;
+    rgblight_channel_t val;
+} rgblight_animation_t;
+
+// Resets the animation state, the first frame is rendered on the next task
+void rgblight_animation_start(void);
+// Renders and advances the animation in PROGMEM when its frame interval has elapsed
+void rgblight_animation_task(const rgblight_animation_t* animation, uint16_t hue, uint8_t sat, uint8_t val);
+
+// The internal steps of the task, exposed for testing
+void rgblight_animation_render(const rgblight_animation_t* animation, uint16_t hue, uint8_t sat, uint8_t val,
+    LED_TYPE* leds, uint8_t num_leds);
+void rgblight_animation_advance(const rgblight_animation_t* animation);
+
+#endif
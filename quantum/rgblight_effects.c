@@ -0,0 +1,103 @@
+#include <stddef.h>
+#include "progmem.h"
+#include "rgblight.h"
+
+__attribute__ ((weak))
+const uint8_t RGBLED_BREATHING_INTERVALS[] PROGMEM = {30, 20, 10, 5};
+__attribute__ ((weak))
+const uint8_t RGBLED_RAINBOW_MOOD_INTERVALS[] PROGMEM = {120, 60, 30};
+__attribute__ ((weak))
+const uint8_t RGBLED_RAINBOW_SWIRL_INTERVALS[] PROGMEM = {100, 50, 20};
+__attribute__ ((weak))
+const uint8_t RGBLED_SNAKE_INTERVALS[] PROGMEM = {100, 50, 20};
+__attribute__ ((weak))
+const uint8_t RGBLED_KNIGHT_INTERVALS[] PROGMEM = {100, 50, 20};
+
+#ifdef RGBLIGHT_ANIMATIONS
+
+#define KEYFRAMES(keyframes) keyframes, sizeof(keyframes) / sizeof(keyframes[0])
+#define NO_CHANNEL {NULL, 0, 0, 0, 0, 0, 0}
+
+// Half a period of a sine wave, played back and forth. Like the table it
+// replaced, it always breathes through the full range, whatever the
+// configured value
+static const rgblight_keyframe_t breathing_keyframes[] PROGMEM = {
+    {0, 0}, {16, 10}, {32, 37}, {48, 79}, {64, 127},
+    {80, 176}, {96, 218}, {112, 245}, {128, 255},
+};
+
+static const rgblight_keyframe_t snake_keyframes[] PROGMEM = {
+    {0, 255}, {RGBLIGHT_EFFECT_SNAKE_LENGTH, 0},
+};
+
+static const rgblight_keyframe_t knight_keyframes[] PROGMEM = {
+    {0, 255}, {RGBLIGHT_EFFECT_KNIGHT_LENGTH, 0},
+};
+
+static const rgblight_keyframe_t christmas_keyframes[] PROGMEM = {
+    {0, 0}, {RGBLIGHT_EFFECT_CHRISTMAS_STEP, 120},
+};
+
+#define BREATHING(index) { \
+    RGBLED_BREATHING_INTERVALS, index, 0, \
+    NO_CHANNEL, \
+    {KEYFRAMES(breathing_keyframes), RGBLIGHT_CHANNEL_PINGPONG | RGBLIGHT_CHANNEL_ABSOLUTE, 129, 0, 0, 1}, \
+}
+
+#define RAINBOW_MOOD(index) { \
+    RGBLED_RAINBOW_MOOD_INTERVALS, index, 0, \
+    {NULL, 0, 0, 360, 0, 0, 1}, \
+    NO_CHANNEL, \
+}
+
+#define RAINBOW_SWIRL(index, direction) { \
+    RGBLED_RAINBOW_SWIRL_INTERVALS, index, 0, \
+    {NULL, 0, 0, 360, 0, 360 / RGBLED_NUM, direction}, \
+    NO_CHANNEL, \
+}
+
+#define SNAKE(index, direction) { \
+    RGBLED_SNAKE_INTERVALS, index, 0, \
+    NO_CHANNEL, \
+    {KEYFRAMES(snake_keyframes), 0, RGBLED_NUM, 0, direction, 1}, \
+}
+
+// The segment sweeps from completely outside one end of the strip to
+// completely outside the other end. The origin centres the part of the
+// period that is off the strip on the turns, so both ends stay dark equally
+// long. Unlike the hand-coded effect, the end LED isn't kept lit while the
+// segment is past it.
+#define KNIGHT(index) { \
+    RGBLED_KNIGHT_INTERVALS, index, RGBLIGHT_EFFECT_KNIGHT_OFFSET, \
+    NO_CHANNEL, \
+    {KEYFRAMES(knight_keyframes), RGBLIGHT_CHANNEL_STEP | RGBLIGHT_CHANNEL_PINGPONG, \
+        RGBLED_NUM + 2 * RGBLIGHT_EFFECT_KNIGHT_LENGTH, -1 - RGBLIGHT_EFFECT_KNIGHT_LENGTH / 2, -1, 1}, \
+}
+
+#define CHRISTMAS() { \
+    NULL, RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL, 0, \
+    {KEYFRAMES(christmas_keyframes), RGBLIGHT_CHANNEL_STEP, \
+        2 * RGBLIGHT_EFFECT_CHRISTMAS_STEP, 0, 1, RGBLIGHT_EFFECT_CHRISTMAS_STEP}, \
+    NO_CHANNEL, \
+}
+
+const rgblight_animation_t rgblight_animations[] PROGMEM = {
+    // MODE 2-5, breathing
+    BREATHING(0), BREATHING(1), BREATHING(2), BREATHING(3),
+    // MODE 6-8, rainbow mood
+    RAINBOW_MOOD(0), RAINBOW_MOOD(1), RAINBOW_MOOD(2),
+    // MODE 9-14, rainbow swirl
+    RAINBOW_SWIRL(0, -1), RAINBOW_SWIRL(0, 1),
+    RAINBOW_SWIRL(1, -1), RAINBOW_SWIRL(1, 1),
+    RAINBOW_SWIRL(2, -1), RAINBOW_SWIRL(2, 1),
+    // MODE 15-20, snake
+    SNAKE(0, 1), SNAKE(0, -1),
+    SNAKE(1, 1), SNAKE(1, -1),
+    SNAKE(2, 1), SNAKE(2, -1),
+    // MODE 21-23, knight
+    KNIGHT(0), KNIGHT(1), KNIGHT(2),
+    // MODE 24, christmas
+    CHRISTMAS(),
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "timer.h"
+#include "rgblight.h"
+#include "rgblight_reactive.h"
+
+#ifdef RGBLIGHT_REACTIVE
+
+#if (RGBLIGHT_REACTIVE_EVENTS & (RGBLIGHT_REACTIVE_EVENTS - 1)) != 0
+#error "RGBLIGHT_REACTIVE_EVENTS must be a power of two"
+#endif
+
+typedef struct {
+    keypos_t key;
+    uint16_t time;
+} reactive_event_t;
+
+// The ring has a single writer, which fills in the slot before moving the
+// head, so no locking is needed. At worst the renderer sees an event that
+// was just replaced by a newer one, which only affects a single frame.
+static reactive_event_t events[RGBLIGHT_REACTIVE_EVENTS];
+static volatile uint8_t events_head = 0;
+
+static uint16_t last_timer = 0;
+static bool frame_pending = true;
+static bool leds_lit = false;
+
+__attribute__ ((weak))
+uint8_t rgblight_reactive_led(keypos_t key) {
+    if (key.col >= MATRIX_COLS) {
+        return RGBLIGHT_REACTIVE_NO_LED;
+    }
+    return (uint16_t)key.col * RGBLED_NUM / MATRIX_COLS;
+}
+
+void rgblight_reactive_record(keyevent_t event) {
+    if (!IS_PRESSED(event)) {
+        return;
+    }
+    uint8_t head = events_head;
+    events[head].key = event.key;
+    events[head].time = event.time;
+    events_head = (head + 1) & (RGBLIGHT_REACTIVE_EVENTS - 1);
+}
+
+void rgblight_reactive_start(void) {
+    for (uint8_t i = 0; i < RGBLIGHT_REACTIVE_EVENTS; i++) {
+        events[i].time = 0;
+    }
+    frame_pending = true;
+    leds_lit = true;
+}
+
+static void light(uint8_t* vals, int16_t led, uint8_t val) {
+    if (led >= 0 && led < RGBLED_NUM && val > vals[led]) {
+        vals[led] = val;
+    }
+}
+
+void rgblight_reactive_task(rgblight_reactive_effect_t effect, uint16_t hue, uint8_t sat, uint8_t val) {
+    if (!frame_pending && timer_elapsed(last_timer) < RGBLIGHT_REACTIVE_INTERVAL) {
+        return;
+    }
+    frame_pending = false;
+    last_timer = timer_read();
+
+    uint8_t vals[RGBLED_NUM] = {0};
+    bool lit = false;
+    for (uint8_t i = 0; i < RGBLIGHT_REACTIVE_EVENTS; i++) {
+        reactive_event_t event = events[i];
+        if (event.time == 0) {
+            continue;
+        }
+        uint16_t age = TIMER_DIFF_16(last_timer, event.time);
+        if (age >= RGBLIGHT_REACTIVE_DECAY) {
+            // Mark it as expired, so that it doesn't come back to life when
+            // the timer wraps around, unless it was just replaced
+            if (events[i].time == event.time) {
+                events[i].time = 0;
+            }
+            continue;
+        }
+        uint8_t center = rgblight_reactive_led(event.key);
+        if (center == RGBLIGHT_REACTIVE_NO_LED) {
+            continue;
+        }
+        uint8_t event_val = (uint32_t)val * (RGBLIGHT_REACTIVE_DECAY - age) / RGBLIGHT_REACTIVE_DECAY;
+        lit = true;
+        if (effect == RGBLIGHT_REACTIVE_RIPPLE_EFFECT) {
+            int16_t radius = age / RGBLIGHT_REACTIVE_RIPPLE_SPEED;
+            light(vals, center - radius, event_val);
+            light(vals, center + radius, event_val);
+        } else {
+            light(vals, center, event_val);
+        }
+    }
+
+    // Nothing changes while all the LEDs are dark, so skip the update
+    if (!lit && !leds_lit) {
+        return;
+    }
+    leds_lit = lit;
+    for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+        sethsv(hue, sat, vals[i], &led[i]);
+    }
+    rgblight_set();
+}
+
+#endif
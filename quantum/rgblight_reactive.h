@@ -0,0 +1,53 @@
+#ifndef RGBLIGHT_REACTIVE_H
+#define RGBLIGHT_REACTIVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+
+// Reactive lighting, the LEDs light up around the keys that are pressed.
+//
+// Key presses are only pushed into a small ring of recent events, which is
+// cheap enough to do directly from action_exec. The effects are then
+// rendered from the ring by rgblight_task at a fixed frame rate, so the
+// lighting work never adds latency to the key event path.
+
+// Number of recent key presses to remember, must be a power of two
+#ifndef RGBLIGHT_REACTIVE_EVENTS
+#define RGBLIGHT_REACTIVE_EVENTS 8
+#endif
+
+// Frame interval in ms
+#ifndef RGBLIGHT_REACTIVE_INTERVAL
+#define RGBLIGHT_REACTIVE_INTERVAL 20
+#endif
+
+// Time in ms for a key press to fade out completely
+#ifndef RGBLIGHT_REACTIVE_DECAY
+#define RGBLIGHT_REACTIVE_DECAY 500
+#endif
+
+// Time in ms for the ripple to move one LED
+#ifndef RGBLIGHT_REACTIVE_RIPPLE_SPEED
+#define RGBLIGHT_REACTIVE_RIPPLE_SPEED 40
+#endif
+
+#define RGBLIGHT_REACTIVE_NO_LED 255
+
+typedef enum {
+    RGBLIGHT_REACTIVE_DECAY_EFFECT,
+    RGBLIGHT_REACTIVE_RIPPLE_EFFECT,
+} rgblight_reactive_effect_t;
+
+// Called from action_exec for every key event
+void rgblight_reactive_record(keyevent_t event);
+
+// Returns the LED closest to the key, or RGBLIGHT_REACTIVE_NO_LED. The
+// default spreads the columns evenly over the strip, override it if the
+// LEDs are laid out differently
+uint8_t rgblight_reactive_led(keypos_t key);
+
+void rgblight_reactive_start(void);
+void rgblight_reactive_task(rgblight_reactive_effect_t effect, uint16_t hue, uint8_t sat, uint8_t val);
+
+#endif
@@ -25,6 +25,7 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/link_stats.h"
 #include <stdbool.h>
 
 // This implements the "Consistent overhead byte stuffing protocol"
@@ -73,6 +74,7 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
         }
         else {
             // The frame is invalid, so reset
+            link_stats[link].framing_errors++;
             init_byte_stuffer_state(state);
         }
     }
@@ -80,6 +82,7 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
         if (state->data_pos == MAX_FRAME_SIZE) {
             // We exceeded our maximum frame size
             // therefore there's nothing else to do than reset to a new frame
+            link_stats[link].framing_errors++;
             state->next_zero = data;
             state->long_frame = data == 0xFF;
             state->data_pos = 0;
@@ -102,41 +105,53 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
     }
 }
 
-static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
-    send_data(link, &num_non_zero, 1);
-    if (end > start) {
-        send_data(link, start, end-start);
-    }
-}
+// The encoded frames are built here, so that each is sent at once
+static uint8_t tx_buffers[NUM_LINKS][MAX_ENCODED_FRAME_SIZE];
 
-void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    const uint8_t zero = 0;
-    if (size > 0) {
-        uint16_t num_non_zero = 1;
-        uint8_t* end = data + size;
-        uint8_t* start = data;
+void byte_stuffer_send_segments(uint8_t link, const frame_t* frame) {
+    uint16_t size = frame_size(frame);
+    if (size == 0 || size > MAX_FRAME_SIZE) {
+        return;
+    }
+    uint8_t* buffer = tx_buffers[link];
+    // Each block starts with a byte telling where the next zero is, which is
+    // filled in when the block ends
+    uint16_t block_start = 0;
+    uint16_t pos = 1;
+    uint8_t num_non_zero = 1;
+    uint8_t i;
+    for (i = 0; i < frame->num_segments; i++) {
+        const uint8_t* data = frame->segments[i].data;
+        const uint8_t* end = data + frame->segments[i].size;
         while (data < end) {
             if (num_non_zero == 0xFF) {
                 // There's more data after big non-zero block
-                // So send it, and start a new block
-                send_block(link, start, data, num_non_zero);
-                start = data;
+                // So end it, and start a new block
+                buffer[block_start] = num_non_zero;
+                block_start = pos++;
+                num_non_zero = 1;
+            }
+            if (*data == 0) {
+                // A zero encountered, so end the block
+                buffer[block_start] = num_non_zero;
+                block_start = pos++;
                 num_non_zero = 1;
             }
             else {
-                if (*data == 0) {
-                    // A zero encountered, so send the block
-                    send_block(link, start, data, num_non_zero);
-                    start = data + 1;
-                    num_non_zero = 1;
-                }
-                else {
-                    num_non_zero++;
-                }
-                ++data;
+                buffer[pos++] = *data;
+                num_non_zero++;
             }
+            ++data;
         }
-        send_block(link, start, data, num_non_zero);
-        send_data(link, &zero, 1);
     }
+    buffer[block_start] = num_non_zero;
+    buffer[pos++] = 0;
+    link_stats[link].frames_sent++;
+    send_data(link, buffer, pos);
+}
+
+void byte_stuffer_send_frame(uint8_t link, const uint8_t* data, uint16_t size) {
+    frame_t frame;
+    frame_init(&frame, data, size);
+    byte_stuffer_send_segments(link, &frame);
 }
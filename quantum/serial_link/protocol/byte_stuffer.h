@@ -26,12 +26,24 @@ SOFTWARE.
 #define SERIAL_LINK_BYTE_STUFFER_H
 
 #include <stdint.h>
+#include "serial_link/protocol/frame.h"
 
+#ifndef MAX_FRAME_SIZE
 #define MAX_FRAME_SIZE 1024
+#endif
+#ifndef NUM_LINKS
 #define NUM_LINKS 2
+#endif
+
+// The size of the biggest frame after encoding, with one extra byte for every
+// 254 bytes and the delimiter
+#define MAX_ENCODED_FRAME_SIZE (MAX_FRAME_SIZE + MAX_FRAME_SIZE / 254 + 2)
 
 void init_byte_stuffer(void);
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data);
-void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size);
+// Encodes the frame and sends it with a single call to send_data, frames
+// bigger than MAX_FRAME_SIZE are dropped
+void byte_stuffer_send_segments(uint8_t link, const frame_t* frame);
+void byte_stuffer_send_frame(uint8_t link, const uint8_t* data, uint16_t size);
 
 #endif
@@ -0,0 +1,65 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_CRC32_H
+#define SERIAL_LINK_CRC32_H
+
+#include <stdint.h>
+
+// The standard CRC32, as used by ethernet and zlib
+//
+// The implementation is chosen at compile time by defining one of these,
+// otherwise it's chosen based on the target
+//   CRC32_NIBBLE        64 byte table, for flash constrained AVRs
+//   CRC32_BYTE          1KB table, one byte at a time
+//   CRC32_SLICING_BY_4  4KB of tables, four bytes at a time
+//   CRC32_SLICING_BY_8  8KB of tables, eight bytes at a time
+//   CRC32_HARDWARE      The CRC unit of the STM32 chips with programmable bit
+//                       reversal, like the F0 and F3 series
+#if !defined(CRC32_NIBBLE) && !defined(CRC32_BYTE) && \
+    !defined(CRC32_SLICING_BY_4) && !defined(CRC32_SLICING_BY_8) && \
+    !defined(CRC32_HARDWARE)
+#   if defined(__AVR__)
+#       define CRC32_NIBBLE
+#   elif defined(__ARM_ARCH_7EM__)
+#       define CRC32_SLICING_BY_4
+#   else
+#       define CRC32_BYTE
+#   endif
+#endif
+
+#define CRC32_INIT 0xFFFFFFFF
+
+// Continues the calculation of a CRC, start with CRC32_INIT
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint16_t size);
+
+static inline uint32_t crc32_final(uint32_t crc) {
+    return crc ^ 0xFFFFFFFF;
+}
+
+static inline uint32_t crc32(const uint8_t* data, uint16_t size) {
+    return crc32_final(crc32_update(CRC32_INIT, data, size));
+}
+
+#endif
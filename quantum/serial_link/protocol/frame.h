@@ -0,0 +1,74 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_FRAME_H
+#define SERIAL_LINK_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A frame being sent, made of separate segments of data. Each layer adds its
+// header or trailer as a new segment, so the data is never copied or
+// modified until the byte stuffer encodes it.
+// The transport adds the object id, the router the destination and the
+// validator the CRC
+#define MAX_FRAME_SEGMENTS 4
+
+typedef struct {
+    const uint8_t* data;
+    uint16_t size;
+} frame_segment_t;
+
+typedef struct {
+    uint8_t num_segments;
+    frame_segment_t segments[MAX_FRAME_SEGMENTS];
+} frame_t;
+
+static inline void frame_init(frame_t* frame, const uint8_t* data, uint16_t size) {
+    frame->num_segments = 1;
+    frame->segments[0].data = data;
+    frame->segments[0].size = size;
+}
+
+// Returns false if the frame already has MAX_FRAME_SEGMENTS, the frame must
+// then be dropped rather than sent without the segment
+static inline bool frame_append(frame_t* frame, const uint8_t* data, uint16_t size) {
+    if (frame->num_segments >= MAX_FRAME_SEGMENTS) {
+        return false;
+    }
+    frame->segments[frame->num_segments].data = data;
+    frame->segments[frame->num_segments].size = size;
+    frame->num_segments++;
+    return true;
+}
+
+static inline uint16_t frame_size(const frame_t* frame) {
+    uint16_t size = 0;
+    for (uint8_t i = 0; i < frame->num_segments; i++) {
+        size += frame->segments[i].size;
+    }
+    return size;
+}
+
+#endif
@@ -25,6 +25,20 @@ SOFTWARE.
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/link_stats.h"
+
+#if SERIAL_LINK_MAX_SLAVES > 127
+#error "SERIAL_LINK_MAX_SLAVES must be less than 128"
+#endif
+
+// The last byte of each frame tells where it's going
+// Towards the master it's the number of hops travelled, which tells the
+// master who sent it.
+// Towards the slaves it's the number of hops left to the destination, or for
+// broadcasts BROADCAST_FLAG and the number of hops travelled.
+// The frames are dropped when they have travelled further than the longest
+// possible chain, so a loop in the cabling can't make them circulate forever.
+#define BROADCAST_FLAG 0x80
 
 static bool is_master;
 
@@ -32,38 +46,79 @@ void router_set_master(bool master) {
    is_master = master;
 }
 
+static void forward(uint8_t link, uint8_t* data, uint16_t size, uint8_t destination) {
+    frame_t frame;
+    frame_init(&frame, data, size);
+    if (frame_append(&frame, &destination, 1)) {
+        validator_send_segments(link, &frame);
+    }
+}
+
 void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size){
+    uint8_t destination = data[size-1];
+    size--;
     if (is_master) {
         if (link == DOWN_LINK) {
-            transport_recv_frame(data[size-1], data, size - 1);
+            if (destination == 0 || destination > SERIAL_LINK_MAX_SLAVES) {
+                link_stats[link].routing_errors++;
+                return;
+            }
+            transport_recv_frame(destination, data, size);
         }
     }
-    else {
-        if (link == UP_LINK) {
-            if (data[size-1] & 1) {
-                transport_recv_frame(0, data, size - 1);
+    else if (link == UP_LINK) {
+        if (destination & BROADCAST_FLAG) {
+            uint8_t hops = (destination & ~BROADCAST_FLAG) + 1;
+            transport_recv_frame(0, data, size);
+            if (hops < SERIAL_LINK_MAX_SLAVES) {
+                forward(DOWN_LINK, data, size, BROADCAST_FLAG | hops);
             }
-            data[size-1] >>= 1;
-            validator_send_frame(DOWN_LINK, data, size);
+        }
+        else if (destination == 1) {
+            transport_recv_frame(0, data, size);
+        }
+        else if (destination > 1 && destination <= SERIAL_LINK_MAX_SLAVES) {
+            forward(DOWN_LINK, data, size, destination - 1);
         }
         else {
-            data[size-1]++;
-            validator_send_frame(UP_LINK, data, size);
+            link_stats[link].routing_errors++;
         }
     }
+    else {
+        if (destination == 0 || destination >= SERIAL_LINK_MAX_SLAVES) {
+            link_stats[link].routing_errors++;
+            return;
+        }
+        forward(UP_LINK, data, size, destination + 1);
+    }
 }
 
-void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
+void router_send_segments(uint8_t destination, frame_t* frame) {
     if (destination == 0) {
         if (!is_master) {
-            data[size] = 1;
-            validator_send_frame(UP_LINK, data, size + 1);
+            destination = 1;
+            if (frame_append(frame, &destination, 1)) {
+                validator_send_segments(UP_LINK, frame);
+            }
         }
     }
     else {
         if (is_master) {
-            data[size] = destination;
-            validator_send_frame(DOWN_LINK, data, size + 1);
+            if (destination == ROUTER_BROADCAST) {
+                destination = BROADCAST_FLAG;
+            }
+            else if (destination > SERIAL_LINK_MAX_SLAVES) {
+                return;
+            }
+            if (frame_append(frame, &destination, 1)) {
+                validator_send_segments(DOWN_LINK, frame);
+            }
         }
     }
 }
+
+void router_send_frame(uint8_t destination, const uint8_t* data, uint16_t size) {
+    frame_t frame;
+    frame_init(&frame, data, size);
+    router_send_segments(destination, &frame);
+}
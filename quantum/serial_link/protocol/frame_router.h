@@ -27,12 +27,24 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "serial_link/protocol/frame.h"
 
 #define UP_LINK 0
 #define DOWN_LINK 1
 
+// The longest chain of slaves, frames that travel further are dropped
+#ifndef SERIAL_LINK_MAX_SLAVES
+#define SERIAL_LINK_MAX_SLAVES 32
+#endif
+
+// The destinations are 0 for the master, 1 for the first slave, 2 for the
+// second and so on
+#define ROUTER_BROADCAST 0xFF
+
 void router_set_master(bool master);
 void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size);
-void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size);
+// Adds the destination as a new segment of the frame
+void router_send_segments(uint8_t destination, frame_t* frame);
+void router_send_frame(uint8_t destination, const uint8_t* data, uint16_t size);
 
 #endif
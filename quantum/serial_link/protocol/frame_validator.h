@@ -26,9 +26,11 @@ SOFTWARE.
 #define SERIAL_LINK_FRAME_VALIDATOR_H
 
 #include <stdint.h>
+#include "serial_link/protocol/frame.h"
 
 void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size);
-// The buffer pointed to by the data needs 4 additional bytes
-void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size);
+// Adds the CRC as the last segment of the frame
+void validator_send_segments(uint8_t link, frame_t* frame);
+void validator_send_frame(uint8_t link, const uint8_t* data, uint16_t size);
 
 #endif
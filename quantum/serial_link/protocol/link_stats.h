@@ -0,0 +1,51 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_LINK_STATS_H
+#define SERIAL_LINK_LINK_STATS_H
+
+#include <stdint.h>
+#include "serial_link/protocol/byte_stuffer.h"
+
+// Counters for each link, for diagnosing bad cables and long chains
+typedef struct {
+    uint32_t frames_sent;
+    uint32_t frames_received;
+    // Frames with an invalid CRC
+    uint32_t crc_errors;
+    // Invalid or too long byte stuffed frames
+    uint32_t framing_errors;
+    // Frames dropped by the router, because they travelled too far or had an
+    // invalid destination
+    uint32_t routing_errors;
+    // Errors reported by the serial hardware
+    uint32_t overruns;
+    uint32_t line_errors;
+} link_stats_t;
+
+extern link_stats_t link_stats[NUM_LINKS];
+
+void reset_link_stats(void);
+
+#endif
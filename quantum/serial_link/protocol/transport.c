@@ -25,104 +25,480 @@ SOFTWARE.
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "timer.h"
 #include <string.h>
 
 #define MAX_REMOTE_OBJECTS 16
 static remote_object_t* remote_objects[MAX_REMOTE_OBJECTS];
 static uint32_t num_remote_objects = 0;
 
+#if SERIAL_LINK_RETRANSMIT_TIMEOUT > 255
+#error "SERIAL_LINK_RETRANSMIT_TIMEOUT must be less than 256 ms"
+#endif
+
+// The object id of frames that only contain acknowledgements
+#define ACK_FRAME_ID 0xFF
+// The most acknowledgements added to a reliable object
+#define MAX_PIGGYBACKED_ACKS 4
+
+#define ALIGN(size) (((size) + 3) & ~3)
+
+// One bit for each object with dirty local data, so that update_transport
+// only visits the objects that have actually been written
+static uint16_t dirty_objects = 0;
+// One bit for each reliable object waiting for an acknowledgement
+static uint16_t unacked_objects = 0;
+static bool acks_pending = false;
+
+// The objects that exist once per slave are stored in a block allocated for
+// each discovered slave. An object is found at its slave_offset in the block
+//   MASTER_TO_SINGLE_SLAVE: the local object, its reliable_tx_state_t and the
+//                           dirty flag
+//   SLAVE_TO_MASTER:        the remote object and its reliable_rx_state_t
+//   MASTER_TO_ALL_SLAVES:   the last sequence number the slave acknowledged
+static uint8_t arena[SERIAL_LINK_ARENA_SIZE] __attribute__((aligned(4)));
+static uint16_t arena_used = 0;
+static uint16_t slave_size = 0;
+static uint8_t* slaves[SERIAL_LINK_MAX_SLAVES];
+static uint8_t num_slaves = 0;
+
 void reinitialize_serial_link_transport(void) {
     num_remote_objects = 0;
+    dirty_objects = 0;
+    unacked_objects = 0;
+    acks_pending = false;
+    arena_used = 0;
+    slave_size = 0;
+    num_slaves = 0;
+}
+
+uint8_t transport_num_slaves(void) {
+    return num_slaves;
+}
+
+static uint16_t tx_state_size(remote_object_t* obj) {
+    return obj->reliable ? sizeof(reliable_tx_state_t) : 0;
+}
+
+static uint16_t slave_part_size(remote_object_t* obj) {
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        return ALIGN(LOCAL_OBJECT_SIZE(obj->object_size) + tx_state_size(obj) + 1);
+    }
+    else if (obj->object_type == SLAVE_TO_MASTER) {
+        return ALIGN(REMOTE_OBJECT_SIZE(obj->object_size) +
+            (obj->reliable ? sizeof(reliable_rx_state_t) : 0));
+    }
+    else {
+        return obj->reliable ? ALIGN(1) : 0;
+    }
+}
+
+static uint8_t* get_slave_part(remote_object_t* obj, uint8_t slave) {
+    return slaves[slave] + obj->slave_offset;
+}
+
+triple_buffer_object_t* transport_get_slave_object(remote_object_t* obj, uint8_t slave) {
+    if (slave >= num_slaves || obj->object_type == MASTER_TO_ALL_SLAVES) {
+        return NULL;
+    }
+    return (triple_buffer_object_t*)get_slave_part(obj, slave);
+}
+
+static uint8_t num_local_objects(remote_object_t* obj) {
+    return obj->object_type == MASTER_TO_SINGLE_SLAVE ? num_slaves : 1;
+}
+
+static uint8_t num_remote_objects_of(remote_object_t* obj) {
+    return obj->object_type == SLAVE_TO_MASTER ? num_slaves : 1;
+}
+
+static triple_buffer_object_t* get_local(remote_object_t* obj, uint8_t index) {
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        return (triple_buffer_object_t*)get_slave_part(obj, index);
+    }
+    return (triple_buffer_object_t*)obj->buffer;
+}
+
+static reliable_tx_state_t* get_tx_state(remote_object_t* obj, uint8_t index) {
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        uint8_t* part = get_slave_part(obj, index);
+        return (reliable_tx_state_t*)(part + LOCAL_OBJECT_SIZE(obj->object_size));
+    }
+    else if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        return (reliable_tx_state_t*)(obj->buffer + 2 * LOCAL_OBJECT_SIZE(obj->object_size));
+    }
+    return (reliable_tx_state_t*)(obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size));
+}
+
+static bool* get_slave_dirty(remote_object_t* obj, uint8_t slave) {
+    uint8_t* part = get_slave_part(obj, slave);
+    return (bool*)(part + LOCAL_OBJECT_SIZE(obj->object_size) + tx_state_size(obj));
+}
+
+static triple_buffer_object_t* get_remote(remote_object_t* obj, uint8_t index) {
+    if (obj->object_type == SLAVE_TO_MASTER) {
+        return (triple_buffer_object_t*)get_slave_part(obj, index);
+    }
+    else if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        return (triple_buffer_object_t*)(obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size));
+    }
+    return (triple_buffer_object_t*)obj->buffer;
+}
+
+static reliable_rx_state_t* get_rx_state(remote_object_t* obj, uint8_t index) {
+    if (obj->object_type == SLAVE_TO_MASTER) {
+        uint8_t* part = get_slave_part(obj, index);
+        return (reliable_rx_state_t*)(part + REMOTE_OBJECT_SIZE(obj->object_size));
+    }
+    else if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        return (reliable_rx_state_t*)(get_tx_state(obj, 0) + 1);
+    }
+    return (reliable_rx_state_t*)(obj->buffer + REMOTE_OBJECT_SIZE(obj->object_size));
+}
+
+// Allocates the blocks of the slaves up to the given one
+static void discover_slaves(uint8_t count) {
+    while (num_slaves < count) {
+        if (arena_used + slave_size > SERIAL_LINK_ARENA_SIZE) {
+            return;
+        }
+        uint8_t* block = arena + arena_used;
+        memset(block, 0, slave_size);
+        slaves[num_slaves] = block;
+        unsigned int i;
+        for (i=0;i<num_remote_objects;i++) {
+            remote_object_t* obj = remote_objects[i];
+            if (obj->object_type != MASTER_TO_ALL_SLAVES) {
+                triple_buffer_init((triple_buffer_object_t*)get_slave_part(obj, num_slaves));
+            }
+            else if (obj->reliable) {
+                // Nothing acknowledged yet, not even the object numbered 0
+                *get_slave_part(obj, num_slaves) = get_tx_state(obj, 0)->seq - 1;
+            }
+        }
+        arena_used += slave_size;
+        // The slave is only visible to the writers when it's ready
+        serial_link_lock();
+        num_slaves++;
+        serial_link_unlock();
+    }
 }
 
 void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_objects) {
     unsigned int i;
     for(i=0;i<_num_remote_objects;i++) {
         remote_object_t* obj = _remote_objects[i];
+        obj->id = num_remote_objects;
+        obj->dirty = false;
+        obj->slave_offset = slave_size;
+        slave_size += slave_part_size(obj);
         remote_objects[num_remote_objects++] = obj;
-        if (obj->object_type == MASTER_TO_ALL_SLAVES) {
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
-            triple_buffer_init(tb);
-            uint8_t* start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-            tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
-        }
-        else if(obj->object_type == MASTER_TO_SINGLE_SLAVE) {
-            uint8_t* start = obj->buffer;
-            unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-                triple_buffer_init(tb);
-                start += LOCAL_OBJECT_SIZE(obj->object_size);
+        if (obj->object_type != MASTER_TO_SINGLE_SLAVE) {
+            triple_buffer_init(get_local(obj, 0));
+        }
+        if (obj->object_type != SLAVE_TO_MASTER) {
+            triple_buffer_init(get_remote(obj, 0));
+        }
+        if (obj->reliable) {
+            if (obj->object_type != MASTER_TO_SINGLE_SLAVE) {
+                memset(get_tx_state(obj, 0), 0, sizeof(reliable_tx_state_t));
+            }
+            if (obj->object_type != SLAVE_TO_MASTER) {
+                memset(get_rx_state(obj, 0), 0, sizeof(reliable_rx_state_t));
+            }
+        }
+    }
+}
+
+static void recv_acks(uint8_t from, uint8_t* data, uint8_t num_acks) {
+    unsigned int i;
+    for (i=0;i<num_acks;i++) {
+        uint8_t id = data[i * 2];
+        uint8_t seq = data[i * 2 + 1];
+        if (id >= num_remote_objects || !remote_objects[id]->reliable) {
+            continue;
+        }
+        remote_object_t* obj = remote_objects[id];
+        if (obj->object_type == SLAVE_TO_MASTER) {
+            if (from != 0) {
+                continue;
+            }
+            reliable_tx_state_t* tx = get_tx_state(obj, 0);
+            if (tx->seq == seq) {
+                tx->pending = false;
+            }
+        }
+        else if (from == 0 || from > num_slaves) {
+            continue;
+        }
+        else if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+            reliable_tx_state_t* tx = get_tx_state(obj, from - 1);
+            if (tx->seq == seq) {
+                tx->pending = false;
             }
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
         }
         else {
-            uint8_t* start = obj->buffer;
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            triple_buffer_init(tb);
-            start += LOCAL_OBJECT_SIZE(obj->object_size);
+            // A broadcast is delivered when every slave has acknowledged it
+            reliable_tx_state_t* tx = get_tx_state(obj, 0);
+            *get_slave_part(obj, from - 1) = seq;
+            bool acked = true;
             unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                tb = (triple_buffer_object_t*)start;
-                triple_buffer_init(tb);
-                start += REMOTE_OBJECT_SIZE(obj->object_size);
+            for (j=0;j<num_slaves;j++) {
+                acked &= *get_slave_part(obj, j) == tx->seq;
+            }
+            if (acked) {
+                tx->pending = false;
             }
         }
     }
 }
 
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (from > SERIAL_LINK_MAX_SLAVES) {
+        return;
+    }
+    discover_slaves(from);
     uint8_t id = data[size-1];
-    if (id < num_remote_objects) {
-        remote_object_t* obj = remote_objects[id];
-        if (obj->object_size == size - 1) {
-            uint8_t* start;
-            if (obj->object_type == MASTER_TO_ALL_SLAVES) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-            }
-            else if(obj->object_type == SLAVE_TO_MASTER) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-                start += (from - 1) * REMOTE_OBJECT_SIZE(obj->object_size);
-            }
-            else {
-                start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);
-            }
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            void* ptr = triple_buffer_begin_write_internal(obj->object_size, tb);
-            memcpy(ptr, data, size - 1);
-            triple_buffer_end_write_internal(tb);
+    size--;
+    if (id == ACK_FRAME_ID) {
+        if (size >= 1 && size - 1 == data[size - 1] * 2) {
+            recv_acks(from, data, data[size - 1]);
+        }
+        return;
+    }
+    if (id >= num_remote_objects) {
+        return;
+    }
+    remote_object_t* obj = remote_objects[id];
+    uint8_t seq = 0;
+    if (obj->reliable) {
+        // The trailer is the acknowledgements, their count and the sequence
+        // number
+        if (size < 2) {
+            return;
+        }
+        seq = data[size - 1];
+        uint8_t num_acks = data[size - 2];
+        size -= 2;
+        if (size < num_acks * 2) {
+            return;
+        }
+        size -= num_acks * 2;
+        recv_acks(from, data + size, num_acks);
+    }
+    if (obj->object_size != size) {
+        return;
+    }
+    uint8_t index = 0;
+    if (obj->object_type == SLAVE_TO_MASTER) {
+        if (from == 0 || from > num_slaves) {
+            return;
+        }
+        index = from - 1;
+    }
+    if (obj->reliable) {
+        reliable_rx_state_t* rx = get_rx_state(obj, index);
+        // Always acknowledge, since a duplicate means the last
+        // acknowledgement was lost
+        rx->ack_pending = true;
+        rx->from = from;
+        acks_pending = true;
+        // The sender was restarted, so its numbers start over
+        if (seq == 0 && rx->seq != 0) {
+            rx->valid = false;
+        }
+        if (rx->valid && rx->seq == seq) {
+            return;
         }
+        rx->seq = seq;
+        rx->valid = true;
     }
+    triple_buffer_object_t* tb = get_remote(obj, index);
+    void* ptr = triple_buffer_begin_write_internal(obj->object_size, tb);
+    memcpy(ptr, data, size);
+    triple_buffer_end_write_internal(tb);
 }
 
-void update_transport(void) {
+void transport_object_written(remote_object_t* obj, uint8_t slave) {
+    serial_link_lock();
+    if (obj->object_type == MASTER_TO_SINGLE_SLAVE) {
+        *get_slave_dirty(obj, slave) = true;
+    }
+    else {
+        obj->dirty = true;
+    }
+    dirty_objects |= 1 << obj->id;
+    serial_link_unlock();
+}
+
+// Fills the buffer with the pending acknowledgements to a node, returns the
+// number of them
+static uint8_t take_acks(uint8_t to, uint8_t* buffer, uint8_t max_acks) {
+    uint8_t num_acks = 0;
     unsigned int i;
-    for(i=0;i<num_remote_objects;i++) {
+    for (i=0;i<num_remote_objects && num_acks < max_acks;i++) {
         remote_object_t* obj = remote_objects[i];
-        if (obj->object_type == MASTER_TO_ALL_SLAVES || obj->object_type == SLAVE_TO_MASTER) {
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer;
-            uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
-            if (ptr) {
-                ptr[obj->object_size] = i;
-                uint8_t dest = obj->object_type == MASTER_TO_ALL_SLAVES ? 0xFF : 0;
-                router_send_frame(dest, ptr, obj->object_size + 1);
+        if (!obj->reliable) {
+            continue;
+        }
+        unsigned int j;
+        for (j=0;j<num_remote_objects_of(obj) && num_acks < max_acks;j++) {
+            reliable_rx_state_t* rx = get_rx_state(obj, j);
+            if (rx->ack_pending && rx->from == to) {
+                rx->ack_pending = false;
+                buffer[num_acks * 2] = i;
+                buffer[num_acks * 2 + 1] = rx->seq;
+                num_acks++;
             }
         }
-        else {
-            uint8_t* start = obj->buffer;
-            unsigned int j;
-            for (j=0;j<NUM_SLAVES;j++) {
-                triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-                uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
-                if (ptr) {
-                    ptr[obj->object_size] = i;
-                    uint8_t dest = j + 1;
-                    router_send_frame(dest, ptr, obj->object_size + 1);
-                }
-                start += LOCAL_OBJECT_SIZE(obj->object_size);
+    }
+    return num_acks;
+}
+
+// Returns the node that has pending acknowledgements, or -1 if there are none
+static int16_t find_pending_ack(void) {
+    unsigned int i;
+    for (i=0;i<num_remote_objects;i++) {
+        remote_object_t* obj = remote_objects[i];
+        if (!obj->reliable) {
+            continue;
+        }
+        unsigned int j;
+        for (j=0;j<num_remote_objects_of(obj);j++) {
+            reliable_rx_state_t* rx = get_rx_state(obj, j);
+            if (rx->ack_pending) {
+                return rx->from;
             }
         }
     }
+    return -1;
+}
+
+static void send_acks(void) {
+    int16_t to;
+    while ((to = find_pending_ack()) >= 0) {
+        uint8_t buffer[MAX_PIGGYBACKED_ACKS * 2 + 2];
+        uint8_t num_acks = take_acks(to, buffer, MAX_PIGGYBACKED_ACKS);
+        buffer[num_acks * 2] = num_acks;
+        buffer[num_acks * 2 + 1] = ACK_FRAME_ID;
+        frame_t frame;
+        frame_init(&frame, buffer, num_acks * 2 + 2);
+        router_send_segments(to, &frame);
+    }
+    acks_pending = false;
+}
+
+static void send_object(remote_object_t* obj, uint8_t index, uint8_t* ptr, uint8_t seq) {
+    uint8_t dest;
+    if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        dest = ROUTER_BROADCAST;
+    }
+    else if (obj->object_type == SLAVE_TO_MASTER) {
+        dest = 0;
+    }
+    else {
+        dest = index + 1;
+    }
+    frame_t frame;
+    frame_init(&frame, ptr, obj->object_size);
+    if (obj->reliable) {
+        uint8_t trailer[MAX_PIGGYBACKED_ACKS * 2 + 3];
+        uint8_t num_acks = 0;
+        // Broadcasts can't carry acknowledgements for a single slave
+        if (dest != ROUTER_BROADCAST) {
+            num_acks = take_acks(dest, trailer, MAX_PIGGYBACKED_ACKS);
+        }
+        trailer[num_acks * 2] = num_acks;
+        trailer[num_acks * 2 + 1] = seq;
+        trailer[num_acks * 2 + 2] = obj->id;
+        if (frame_append(&frame, trailer, num_acks * 2 + 3)) {
+            router_send_segments(dest, &frame);
+        }
+    }
+    else {
+        if (frame_append(&frame, &obj->id, 1)) {
+            router_send_segments(dest, &frame);
+        }
+    }
+}
+
+static bool update_local(remote_object_t* obj, uint8_t index, bool dirty, uint8_t time) {
+    triple_buffer_object_t* tb = get_local(obj, index);
+    uint8_t* ptr = NULL;
+    if (dirty) {
+        ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size, tb);
+    }
+    if (!obj->reliable) {
+        if (ptr) {
+            send_object(obj, index, ptr, 0);
+        }
+        return false;
+    }
+    reliable_tx_state_t* tx = get_tx_state(obj, index);
+    if (ptr) {
+        if (!tx->started) {
+            tx->seq = 0;
+            tx->started = true;
+        } else if (++tx->seq == 0) {
+            tx->seq = 1;
+        }
+        tx->pending = true;
+        tx->retransmits = 0;
+    }
+    else if (tx->pending && (uint8_t)(time - tx->sent_time) >= SERIAL_LINK_RETRANSMIT_TIMEOUT) {
+        if (tx->retransmits == SERIAL_LINK_MAX_RETRANSMITS) {
+            tx->pending = false;
+            return false;
+        }
+        tx->retransmits++;
+        ptr = (uint8_t*)triple_buffer_read_last_internal(obj->object_size, tb);
+    }
+    if (ptr) {
+        tx->sent_time = time;
+        send_object(obj, index, ptr, tx->seq);
+    }
+    return tx->pending;
+}
+
+static bool take_dirty(remote_object_t* obj, uint8_t index) {
+    bool* dirty = obj->object_type == MASTER_TO_SINGLE_SLAVE ?
+        get_slave_dirty(obj, index) : &obj->dirty;
+    serial_link_lock();
+    bool ret = *dirty;
+    *dirty = false;
+    serial_link_unlock();
+    return ret;
+}
+
+bool update_transport(void) {
+    serial_link_lock();
+    uint16_t dirty = dirty_objects;
+    dirty_objects = 0;
+    serial_link_unlock();
+
+    uint8_t time = timer_read();
+    uint16_t visit = dirty | unacked_objects;
+    unacked_objects = 0;
+    unsigned int i;
+    for(i=0;visit;i++,visit>>=1) {
+        if (!(visit & 1)) {
+            continue;
+        }
+        remote_object_t* obj = remote_objects[i];
+        bool unacked = false;
+        unsigned int j;
+        for (j=0;j<num_local_objects(obj);j++) {
+            unacked |= update_local(obj, j, take_dirty(obj, j), time);
+        }
+        if (unacked) {
+            unacked_objects |= 1 << i;
+        }
+    }
+    if (acks_pending) {
+        send_acks();
+    }
+    return unacked_objects != 0;
 }
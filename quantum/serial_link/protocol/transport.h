@@ -26,14 +26,31 @@ SOFTWARE.
 #define SERIAL_LINK_TRANSPORT_H
 
 #include "serial_link/protocol/triple_buffered_object.h"
+#include "serial_link/protocol/frame_router.h"
 #include "serial_link/system/serial_link.h"
 
-#define NUM_SLAVES 8
-#define LOCAL_OBJECT_EXTRA 16
+// The slaves are discovered at runtime, when the master receives something
+// from them. The buffers needed for each slave are then allocated from an
+// arena of this many bytes, so it limits the length of the chain
+#ifndef SERIAL_LINK_ARENA_SIZE
+#define SERIAL_LINK_ARENA_SIZE 1024
+#endif
+
+// Reliable objects are sent again when they haven't been acknowledged within
+// this many milliseconds, at most SERIAL_LINK_MAX_RETRANSMITS times
+#ifndef SERIAL_LINK_RETRANSMIT_TIMEOUT
+#define SERIAL_LINK_RETRANSMIT_TIMEOUT 10
+#endif
+
+#ifndef SERIAL_LINK_MAX_RETRANSMITS
+#define SERIAL_LINK_MAX_RETRANSMITS 8
+#endif
 
 // master -> slave = 1 local(target all), 1 remote object
-// slave -> master = 1 local(target 0), multiple remote objects
-// master -> single slave (multiple local, target id), 1 remote object
+// slave -> master = 1 local(target 0), 1 remote object per slave
+// master -> single slave (1 local per slave, target id), 1 remote object
+// The objects that exist once per slave are only allocated on the master,
+// when the slave is discovered
 typedef enum {
     MASTER_TO_ALL_SLAVES,
     MASTER_TO_SINGLE_SLAVE,
@@ -43,39 +60,78 @@ typedef enum {
 typedef struct {
     remote_object_type object_type;
     uint16_t object_size;
-    uint8_t buffer[] __attribute__((aligned(4)));
+    bool reliable;
+    // The index given by add_remote_objects
+    uint8_t id;
+    // The local object has been written since the last update_transport
+    bool dirty;
+    // Where the data of this object is in the memory allocated for each slave
+    uint16_t slave_offset;
+    // Zero sized rather than flexible, since the objects are embedded in the
+    // structs declared by REMOTE_OBJECT_HELPER
+    uint8_t buffer[0] __attribute__((aligned(4)));
 } remote_object_t;
 
+// Queues a local object for sending by the next update_transport
+void transport_object_written(remote_object_t* obj, uint8_t slave);
+// Returns the buffer of an object that exists once per slave, or NULL if the
+// slave hasn't been discovered
+triple_buffer_object_t* transport_get_slave_object(remote_object_t* obj, uint8_t slave);
+// The number of slaves discovered so far
+uint8_t transport_num_slaves(void);
+
+// The triple buffers are padded, so that the next one is aligned
 #define REMOTE_OBJECT_SIZE(objectsize) \
-    (sizeof(triple_buffer_object_t) + objectsize * 3)
+    ((sizeof(triple_buffer_object_t) + objectsize * 3 + 3) & ~3)
 #define LOCAL_OBJECT_SIZE(objectsize) \
-    (sizeof(triple_buffer_object_t) + (objectsize + LOCAL_OBJECT_EXTRA) * 3)
+    ((sizeof(triple_buffer_object_t) + objectsize * 3 + 3) & ~3)
 
-#define REMOTE_OBJECT_HELPER(name, type, num_local, num_remote) \
+// The delivery state of each local object of a reliable object. The first
+// object after a start is numbered 0, and the numbers skip 0 after that, so
+// the receiver can tell when the sender started over.
+typedef struct {
+    uint8_t seq;
+    bool started;
+    bool pending;
+    uint8_t retransmits;
+    uint8_t sent_time;
+} reliable_tx_state_t;
+
+// The last sequence number received by each remote object, and if it still
+// needs to be acknowledged
+typedef struct {
+    uint8_t seq;
+    bool valid;
+    bool ack_pending;
+    uint8_t from;
+} reliable_rx_state_t;
+
+#define REMOTE_OBJECT_HELPER(name, type, num_buffers, state_size) \
 typedef struct { \
     remote_object_t object; \
-    uint8_t buffer[ \
-        num_remote * REMOTE_OBJECT_SIZE(sizeof(type)) + \
-        num_local * LOCAL_OBJECT_SIZE(sizeof(type))]; \
+    uint8_t buffer[num_buffers * LOCAL_OBJECT_SIZE(sizeof(type)) + state_size]; \
 } remote_object_##name##_t;
 
-#define MASTER_TO_ALL_SLAVES_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, 1, 1) \
+#define MASTER_TO_ALL_SLAVES_OBJECT_HELPER(name, type, is_reliable) \
+    REMOTE_OBJECT_HELPER(name, type, 2, is_reliable * \
+        (sizeof(reliable_tx_state_t) + sizeof(reliable_rx_state_t))) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = MASTER_TO_ALL_SLAVES, \
             .object_size = sizeof(type), \
+            .reliable = is_reliable, \
         } \
     }; \
     type* begin_write_##name(void) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        return (type*)triple_buffer_begin_write_internal(sizeof(type), tb); \
     }\
     void end_write_##name(void) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
         triple_buffer_end_write_internal(tb); \
+        transport_object_written(obj, 0); \
         signal_data_written(); \
     }\
     type* read_##name(void) { \
@@ -85,68 +141,101 @@ typedef struct { \
         return (type*)triple_buffer_read_internal(obj->object_size, tb); \
     }
 
-#define MASTER_TO_SINGLE_SLAVE_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, NUM_SLAVES, 1) \
+// begin_write returns NULL if the slave hasn't been discovered
+#define MASTER_TO_SINGLE_SLAVE_OBJECT_HELPER(name, type, is_reliable) \
+    REMOTE_OBJECT_HELPER(name, type, 1, is_reliable * sizeof(reliable_rx_state_t)) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = MASTER_TO_SINGLE_SLAVE, \
             .object_size = sizeof(type), \
+            .reliable = is_reliable, \
         } \
     }; \
     type* begin_write_##name(uint8_t slave) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer;\
-        start += slave * LOCAL_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        triple_buffer_object_t* tb = transport_get_slave_object(obj, slave); \
+        if (!tb) { \
+            return NULL; \
+        } \
+        return (type*)triple_buffer_begin_write_internal(sizeof(type), tb); \
     }\
     void end_write_##name(uint8_t slave) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer;\
-        start += slave * LOCAL_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
+        triple_buffer_object_t* tb = transport_get_slave_object(obj, slave); \
+        if (!tb) { \
+            return; \
+        } \
         triple_buffer_end_write_internal(tb); \
+        transport_object_written(obj, slave); \
         signal_data_written(); \
     }\
     type* read_##name() { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);\
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
+        triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
         return (type*)triple_buffer_read_internal(obj->object_size, tb); \
     }
 
-#define SLAVE_TO_MASTER_OBJECT(name, type) \
-    REMOTE_OBJECT_HELPER(name, type, 1, NUM_SLAVES) \
+// read returns NULL if the slave hasn't been discovered
+#define SLAVE_TO_MASTER_OBJECT_HELPER(name, type, is_reliable) \
+    REMOTE_OBJECT_HELPER(name, type, 1, is_reliable * sizeof(reliable_tx_state_t)) \
     remote_object_##name##_t remote_object_##name = { \
         .object = { \
             .object_type = SLAVE_TO_MASTER, \
             .object_size = sizeof(type), \
+            .reliable = is_reliable, \
         } \
     }; \
     type* begin_write_##name(void) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
-        return (type*)triple_buffer_begin_write_internal(sizeof(type) + LOCAL_OBJECT_EXTRA, tb); \
+        return (type*)triple_buffer_begin_write_internal(sizeof(type), tb); \
     }\
     void end_write_##name(void) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
         triple_buffer_object_t* tb = (triple_buffer_object_t*)obj->buffer; \
         triple_buffer_end_write_internal(tb); \
+        transport_object_written(obj, 0); \
         signal_data_written(); \
     }\
     type* read_##name(uint8_t slave) { \
         remote_object_t* obj = (remote_object_t*)&remote_object_##name; \
-        uint8_t* start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);\
-        start+=slave * REMOTE_OBJECT_SIZE(obj->object_size); \
-        triple_buffer_object_t* tb = (triple_buffer_object_t*)start; \
+        triple_buffer_object_t* tb = transport_get_slave_object(obj, slave); \
+        if (!tb) { \
+            return NULL; \
+        } \
         return (type*)triple_buffer_read_internal(obj->object_size, tb); \
     }
 
+#define MASTER_TO_ALL_SLAVES_OBJECT(name, type) \
+    MASTER_TO_ALL_SLAVES_OBJECT_HELPER(name, type, false)
+#define MASTER_TO_SINGLE_SLAVE_OBJECT(name, type) \
+    MASTER_TO_SINGLE_SLAVE_OBJECT_HELPER(name, type, false)
+#define SLAVE_TO_MASTER_OBJECT(name, type) \
+    SLAVE_TO_MASTER_OBJECT_HELPER(name, type, false)
+
+// Reliable objects carry a sequence number and are sent again until the
+// other side acknowledges them, or SERIAL_LINK_MAX_RETRANSMITS is reached.
+// The acknowledgements are added to reliable objects going the other way,
+// and sent on their own when there are none.
+// Only the latest value is delivered, just like for the other objects, so an
+// acknowledgement of a later write covers all the earlier ones.
+// Use these for state that must not be lost, like layers and LEDs
+#define RELIABLE_MASTER_TO_ALL_SLAVES_OBJECT(name, type) \
+    MASTER_TO_ALL_SLAVES_OBJECT_HELPER(name, type, true)
+#define RELIABLE_MASTER_TO_SINGLE_SLAVE_OBJECT(name, type) \
+    MASTER_TO_SINGLE_SLAVE_OBJECT_HELPER(name, type, true)
+#define RELIABLE_SLAVE_TO_MASTER_OBJECT(name, type) \
+    SLAVE_TO_MASTER_OBJECT_HELPER(name, type, true)
+
 #define REMOTE_OBJECT(name) (remote_object_t*)&remote_object_##name
 
 void add_remote_objects(remote_object_t** remote_objects, uint32_t num_remote_objects);
 void reinitialize_serial_link_transport(void);
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size);
-void update_transport(void);
+// Sends the local objects that have been written since the last call, and
+// the reliable objects that need to be sent again. Returns true if there are
+// reliable objects waiting for acknowledgements, in which case it should be
+// called again after SERIAL_LINK_RETRANSMIT_TIMEOUT
+bool update_transport(void);
 
 #endif
@@ -27,6 +27,9 @@ SOFTWARE.
 
 #include <stdint.h>
 
+// An object with one writer and one reader, where the reader always gets the
+// latest complete write. The writer and the reader never wait for each other
+// and don't take any locks, so either of them can be in an interrupt handler
 typedef struct {
     uint8_t state;
     uint8_t buffer[] __attribute__((aligned(4)));
@@ -46,6 +49,9 @@ void triple_buffer_init(triple_buffer_object_t* object);
 void* triple_buffer_begin_write_internal(uint16_t object_size, triple_buffer_object_t* object);
 void triple_buffer_end_write_internal(triple_buffer_object_t* object);
 void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object);
+// Returns the object returned by the last successful read again, it stays
+// valid until the next read
+void* triple_buffer_read_last_internal(uint16_t object_size, triple_buffer_object_t* object);
 
 
 #endif
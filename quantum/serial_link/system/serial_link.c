@@ -28,6 +28,7 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/transport.h"
 #include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/link_stats.h"
 #include "matrix.h"
 #include <stdbool.h>
 #include "print.h"
@@ -60,6 +61,17 @@ host_driver_t serial_driver = {
 #error "Serial link thread priority not set"
 #endif
 
+// The matrix is sent whenever it changes, and at least this often in
+// milliseconds, so that the other side knows that the link is alive
+#ifndef SERIAL_LINK_KEEP_ALIVE_INTERVAL
+#define SERIAL_LINK_KEEP_ALIVE_INTERVAL 100
+#endif
+
+// The link is considered down when nothing has been received for this long
+#ifndef SERIAL_LINK_TIMEOUT
+#define SERIAL_LINK_TIMEOUT (3 * SERIAL_LINK_KEEP_ALIVE_INTERVAL)
+#endif
+
 static SerialConfig config = {
     .sc_speed = SERIAL_LINK_BAUD
 };
@@ -79,6 +91,15 @@ static uint32_t read_from_serial(SerialDriver* driver, uint8_t link) {
     return bytes_read;
 }
 
+static void count_errors(uint8_t link, eventflags_t flags) {
+    if (flags & SD_OVERRUN_ERROR) {
+        link_stats[link].overruns++;
+    }
+    if (flags & (SD_PARITY_ERROR | SD_FRAMING_ERROR | SD_NOISE_ERROR | SD_BREAK_DETECTED)) {
+        link_stats[link].line_errors++;
+    }
+}
+
 static void print_error(char* str, eventflags_t flags, SerialDriver* driver) {
 #ifdef DEBUG_LINK_ERRORS
     if (flags & SD_PARITY_ERROR) {
@@ -133,17 +154,24 @@ static THD_FUNCTION(serialThread, arg) {
         EVENT_MASK(2),
         events);
     bool need_wait = false;
+    bool retransmit = false;
     while(true) {
         eventflags_t flags1 = 0;
         eventflags_t flags2 = 0;
         if (need_wait) {
-            eventmask_t mask = chEvtWaitAnyTimeout(ALL_EVENTS, MS2ST(1000));
+            // Nothing is polled, the thread only wakes up when an object is
+            // written, when there's data on the serial ports, or when a
+            // reliable object needs to be sent again
+            systime_t timeout = retransmit ? MS2ST(SERIAL_LINK_RETRANSMIT_TIMEOUT) : TIME_INFINITE;
+            eventmask_t mask = chEvtWaitAnyTimeout(ALL_EVENTS, timeout);
             if (mask & EVENT_MASK(1)) {
                 flags1 = chEvtGetAndClearFlags(&sd1_listener);
+                count_errors(DOWN_LINK, flags1);
                 print_error("DOWNLINK", flags1, &SD1);
             }
             if (mask & EVENT_MASK(2)) {
                 flags2 = chEvtGetAndClearFlags(&sd2_listener);
+                count_errors(UP_LINK, flags2);
                 print_error("UPLINK", flags2, &SD2);
             }
         }
@@ -155,7 +183,7 @@ static THD_FUNCTION(serialThread, arg) {
         need_wait = true;
         need_wait &= read_from_serial(&SD2, UP_LINK) == 0;
         need_wait &= read_from_serial(&SD1, DOWN_LINK) == 0;
-        update_transport();
+        retransmit = update_transport();
     }
 }
 
@@ -169,6 +197,8 @@ void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
 }
 
 static systime_t last_update = 0;
+static systime_t last_receive = 0;
+static bool remote_alive = false;
 
 typedef struct {
     matrix_row_t rows[MATRIX_ROWS];
@@ -189,6 +219,7 @@ void init_serial_link(void) {
     init_serial_link_hal();
     add_remote_objects(remote_objects, sizeof(remote_objects)/sizeof(remote_object_t*));
     init_byte_stuffer();
+    reset_link_stats();
     sdStart(&SD1, &config);
     sdStart(&SD2, &config);
     chEvtObjectInit(&new_data_event);
@@ -199,8 +230,12 @@ void init_serial_link(void) {
 void matrix_set_remote(matrix_row_t* rows, uint8_t index);
 
 void serial_link_update(void) {
+    systime_t current_time = chVTGetSystemTimeX();
+
     if (read_serial_link_connected()) {
         serial_link_connected = true;
+        last_receive = current_time;
+        remote_alive = true;
     }
 
     matrix_object_t matrix;
@@ -210,9 +245,8 @@ void serial_link_update(void) {
         changed |= matrix.rows[i] != last_matrix.rows[i];
     }
 
-    systime_t current_time = chVTGetSystemTimeX();
     systime_t delta = current_time - last_update;
-    if (changed || delta > US2ST(1000)) {
+    if (changed || delta >= MS2ST(SERIAL_LINK_KEEP_ALIVE_INTERVAL)) {
         last_update = current_time;
         last_matrix = matrix;
         matrix_object_t* m = begin_write_keyboard_matrix();
@@ -220,13 +254,24 @@ void serial_link_update(void) {
             m->rows[i] = matrix.rows[i];
         }
         end_write_keyboard_matrix();
-        *begin_write_serial_link_connected() = true;
-        end_write_serial_link_connected();
+        if (delta >= MS2ST(SERIAL_LINK_KEEP_ALIVE_INTERVAL)) {
+            *begin_write_serial_link_connected() = true;
+            end_write_serial_link_connected();
+        }
     }
 
     matrix_object_t* m = read_keyboard_matrix(0);
     if (m) {
         matrix_set_remote(m->rows, 0);
+        last_receive = current_time;
+        remote_alive = true;
+    }
+    else if (remote_alive && current_time - last_receive >= MS2ST(SERIAL_LINK_TIMEOUT)) {
+        // Release the keys of the other half, so that they don't get stuck
+        // when the cable is disconnected
+        remote_alive = false;
+        matrix_object_t released = {};
+        matrix_set_remote(released.rows, 0);
     }
 }
 
@@ -238,6 +283,49 @@ bool is_serial_link_connected(void) {
     return serial_link_connected;
 }
 
+bool is_serial_link_alive(void) {
+    return remote_alive;
+}
+
+void serial_link_print_stats(void) {
+    static const char* names[NUM_LINKS] = {"UP", "DOWN"};
+    xprintf("serial link: %u slaves\n", transport_num_slaves());
+    for (uint8_t i = 0; i < NUM_LINKS; i++) {
+        link_stats_t* stats = &link_stats[i];
+        xprintf("%s sent %u received %u crc %u framing %u routing %u overrun %u line %u\n",
+            names[i],
+            (unsigned int)stats->frames_sent, (unsigned int)stats->frames_received,
+            (unsigned int)stats->crc_errors, (unsigned int)stats->framing_errors,
+            (unsigned int)stats->routing_errors, (unsigned int)stats->overruns,
+            (unsigned int)stats->line_errors);
+    }
+}
+
+static uint8_t write_counter(uint8_t* data, uint8_t pos, uint8_t length, uint32_t value) {
+    for (uint8_t i = 0; i < 4 && pos < length; i++) {
+        data[pos++] = value >> (i * 8);
+    }
+    return pos;
+}
+
+uint8_t serial_link_stats_report(uint8_t link, uint8_t* data, uint8_t length) {
+    if (link >= NUM_LINKS || length < 2) {
+        return 0;
+    }
+    uint8_t pos = 0;
+    data[pos++] = transport_num_slaves();
+    data[pos++] = link;
+    link_stats_t* stats = &link_stats[link];
+    pos = write_counter(data, pos, length, stats->frames_sent);
+    pos = write_counter(data, pos, length, stats->frames_received);
+    pos = write_counter(data, pos, length, stats->crc_errors);
+    pos = write_counter(data, pos, length, stats->framing_errors);
+    pos = write_counter(data, pos, length, stats->routing_errors);
+    pos = write_counter(data, pos, length, stats->overruns);
+    pos = write_counter(data, pos, length, stats->line_errors);
+    return pos;
+}
+
 host_driver_t* get_serial_link_driver(void) {
     return &serial_driver;
 }
@@ -31,8 +31,16 @@ SOFTWARE.
 void init_serial_link(void);
 void init_serial_link_hal(void);
 bool is_serial_link_connected(void);
+// True when something has been received within SERIAL_LINK_TIMEOUT
+bool is_serial_link_alive(void);
 bool is_serial_link_master(void);
 host_driver_t* get_serial_link_driver(void);
+// Prints the number of slaves and the counters of each link to the console
+void serial_link_print_stats(void);
+// Fills a raw HID report with the number of slaves, the link and its counters
+// as little endian 32 bit values in the order of link_stats_t, 30 bytes in
+// total. Returns the number of bytes written
+uint8_t serial_link_stats_report(uint8_t link, uint8_t* data, uint8_t length);
 void serial_link_update(void);
 
 #if defined(PROTOCOL_CHIBIOS)
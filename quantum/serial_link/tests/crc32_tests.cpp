@@ -0,0 +1,107 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+extern "C" {
+#include "serial_link/protocol/crc32.h"
+}
+
+// The simplest possible implementation, one bit at a time
+static uint32_t reference_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static std::vector<uint8_t> random_data(size_t size, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = rng();
+    }
+    return data;
+}
+
+TEST(Crc32, empty_data) {
+    EXPECT_EQ(crc32(nullptr, 0), 0);
+}
+
+TEST(Crc32, check_value) {
+    const char* check = "123456789";
+    EXPECT_EQ(crc32((const uint8_t*)check, 9), 0xCBF43926);
+}
+
+TEST(Crc32, matches_the_reference_for_all_sizes_and_alignments) {
+    std::vector<uint8_t> data = random_data(300, 1);
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t size = 0; size + offset <= data.size(); size++) {
+            ASSERT_EQ(crc32(data.data() + offset, size), reference_crc32(data.data() + offset, size))
+                << "offset " << offset << " size " << size;
+        }
+    }
+}
+
+TEST(Crc32, can_be_calculated_in_parts) {
+    std::vector<uint8_t> data = random_data(100, 2);
+    uint32_t expected = crc32(data.data(), data.size());
+    for (size_t split = 0; split <= data.size(); split++) {
+        uint32_t crc = crc32_update(CRC32_INIT, data.data(), split);
+        crc = crc32_update(crc, data.data() + split, data.size() - split);
+        ASSERT_EQ(crc32_final(crc), expected) << "split " << split;
+    }
+}
+
+TEST(Crc32, benchmark) {
+#if defined(CRC32_NIBBLE)
+    const char* name = "nibble";
+#elif defined(CRC32_SLICING_BY_4)
+    const char* name = "slicing by 4";
+#elif defined(CRC32_SLICING_BY_8)
+    const char* name = "slicing by 8";
+#else
+    const char* name = "byte";
+#endif
+    // Frames are small, so measure with a typical frame size rather than a
+    // big buffer
+    const size_t frame_size = 64;
+    const size_t total = 32 * 1024 * 1024;
+    std::vector<uint8_t> data = random_data(frame_size, 3);
+    uint32_t result = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < total / frame_size; i++) {
+        data[0] = i;
+        result += crc32(data.data(), frame_size);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("CRC32 %s: %.1f MB/s (%08X)\n", name, total / elapsed.count() / (1024 * 1024), result);
+}
@@ -29,6 +29,7 @@ extern "C" {
     #include "serial_link/protocol/transport.h"
     #include "serial_link/protocol/byte_stuffer.h"
     #include "serial_link/protocol/frame_router.h"
+    #include "serial_link/protocol/link_stats.h"
 }
 
 using testing::_;
@@ -42,6 +43,7 @@ public:
     {
         Instance = this;
         init_byte_stuffer();
+        reset_link_stats();
     }
 
     ~FrameRouter() {
@@ -133,28 +135,29 @@ TEST_F(FrameRouter, master_broadcast_is_received_by_everyone) {
     EXPECT_EQ(router_buffers[2].send_buffers[UP_LINK].size(), 0);
 }
 
-TEST_F(FrameRouter, master_send_is_received_by_targets) {
+TEST_F(FrameRouter, master_send_is_received_by_target) {
     frame_buffer_t data;
     data.data = {0xAB, 0x70, 0x55, 0xBB};
     activate_router(0);
-    router_send_frame((1 << 1) | (1 << 2), (uint8_t*)&data, 4);
+    router_send_frame(3, (uint8_t*)&data, 4);
     EXPECT_GT(router_buffers[0].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[0].send_buffers[UP_LINK].size(), 0);
 
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
     simulate_transport(0, 1);
     EXPECT_GT(router_buffers[1].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[1].send_buffers[UP_LINK].size(), 0);
 
-    EXPECT_CALL(*this, transport_recv_frame(0, _, _))
-        .With(Args<1, 2>(ElementsAreArray(data.data)));
     simulate_transport(1, 2);
     EXPECT_GT(router_buffers[2].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[2].send_buffers[UP_LINK].size(), 0);
+    testing::Mock::VerifyAndClearExpectations(this);
 
     EXPECT_CALL(*this, transport_recv_frame(0, _, _))
         .With(Args<1, 2>(ElementsAreArray(data.data)));
     simulate_transport(2, 3);
-    EXPECT_GT(router_buffers[3].send_buffers[DOWN_LINK].size(), 0);
+    EXPECT_EQ(router_buffers[3].send_buffers[DOWN_LINK].size(), 0);
     EXPECT_EQ(router_buffers[3].send_buffers[UP_LINK].size(), 0);
 }
 
@@ -227,3 +230,64 @@ TEST_F(FrameRouter, master_receives_on_uplink_does_nothing) {
     EXPECT_EQ(router_buffers[0].send_buffers[UP_LINK].size(), 0);
     EXPECT_EQ(router_buffers[0].send_buffers[DOWN_LINK].size(), 0);
 }
+
+TEST_F(FrameRouter, broadcast_stops_after_the_longest_chain) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(0);
+    router_send_frame(0xFF, (uint8_t*)&data, 4);
+    // A loop, where the last slave is connected to the first
+    std::vector<uint8_t> frame = router_buffers[0].send_buffers[DOWN_LINK];
+    int received = 0;
+    EXPECT_CALL(*this, transport_recv_frame(0, _, _))
+        .WillRepeatedly(testing::InvokeWithoutArgs([&received]() { received++; }));
+    activate_router(1);
+    while (!frame.empty()) {
+        router_buffers[1].send_buffers[DOWN_LINK].clear();
+        receive_data(UP_LINK, frame.data(), frame.size());
+        frame = router_buffers[1].send_buffers[DOWN_LINK];
+    }
+    EXPECT_EQ(received, SERIAL_LINK_MAX_SLAVES);
+}
+
+TEST_F(FrameRouter, frame_to_the_master_is_dropped_after_the_longest_chain) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(1);
+    router_send_frame(0, (uint8_t*)&data, 4);
+    std::vector<uint8_t> frame = router_buffers[1].send_buffers[UP_LINK];
+    int hops = 1;
+    while (!frame.empty()) {
+        router_buffers[1].send_buffers[UP_LINK].clear();
+        receive_data(DOWN_LINK, frame.data(), frame.size());
+        frame = router_buffers[1].send_buffers[UP_LINK];
+        if (!frame.empty()) {
+            hops++;
+        }
+    }
+    EXPECT_EQ(hops, SERIAL_LINK_MAX_SLAVES);
+    EXPECT_EQ(link_stats[DOWN_LINK].routing_errors, 1);
+}
+
+TEST_F(FrameRouter, frames_are_counted) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(0);
+    router_send_frame(1, (uint8_t*)&data, 4);
+    EXPECT_EQ(link_stats[DOWN_LINK].frames_sent, 1);
+    EXPECT_CALL(*this, transport_recv_frame(0, _, _));
+    simulate_transport(0, 1);
+    EXPECT_EQ(link_stats[UP_LINK].frames_received, 1);
+}
+
+TEST_F(FrameRouter, corrupted_frames_are_counted) {
+    frame_buffer_t data;
+    data.data = {0xAB, 0x70, 0x55, 0xBB};
+    activate_router(0);
+    router_send_frame(1, (uint8_t*)&data, 4);
+    router_buffers[0].send_buffers[DOWN_LINK][2] ^= 0x10;
+    EXPECT_CALL(*this, transport_recv_frame(_, _, _))
+        .Times(0);
+    simulate_transport(0, 1);
+    EXPECT_EQ(link_stats[UP_LINK].crc_errors, 1);
+}
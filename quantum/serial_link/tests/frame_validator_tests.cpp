@@ -24,6 +24,7 @@ SOFTWARE.
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include <vector>
 extern "C" {
 #include "serial_link/protocol/frame_validator.h"
 }
@@ -55,8 +56,13 @@ void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size) {
     FrameValidator::Instance->route_incoming_frame(link, data, size);
 }
 
-void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    FrameValidator::Instance->byte_stuffer_send_frame(link, data, size);
+void byte_stuffer_send_segments(uint8_t link, const frame_t* frame) {
+    std::vector<uint8_t> data;
+    for (int i = 0; i < frame->num_segments; i++) {
+        const uint8_t* segment = frame->segments[i].data;
+        data.insert(data.end(), segment, segment + frame->segments[i].size);
+    }
+    FrameValidator::Instance->byte_stuffer_send_frame(link, data.data(), data.size());
 }
 }
 
@@ -113,3 +119,53 @@ TEST_F(FrameValidator, sends_five_bytes_with_correct_crc) {
         .With(Args<1, 2>(ElementsAreArray(expected)));
     validator_send_frame(0, original, 5);
 }
+
+TEST_F(FrameValidator, validates_long_frame_sent_by_itself) {
+    uint8_t data[260];
+    for (int i = 0; i < 256; i++) {
+        data[i] = i * 7;
+    }
+    uint8_t sent[260];
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, 260))
+        .WillOnce(testing::Invoke([&sent](uint8_t link, uint8_t* d, uint16_t size) {
+            memcpy(sent, d, size);
+        }));
+    validator_send_frame(0, data, 256);
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data, 256)));
+    validator_recv_frame(0, sent, 260);
+}
+
+TEST_F(FrameValidator, does_not_validate_long_frame_with_a_flipped_bit) {
+    uint8_t data[260];
+    for (int i = 0; i < 256; i++) {
+        data[i] = i * 7;
+    }
+    uint8_t sent[260];
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, 260))
+        .WillOnce(testing::Invoke([&sent](uint8_t link, uint8_t* d, uint16_t size) {
+            memcpy(sent, d, size);
+        }));
+    validator_send_frame(0, data, 256);
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .Times(0);
+    for (int i = 0; i < 260 * 8; i++) {
+        sent[i / 8] ^= 1 << (i % 8);
+        validator_recv_frame(0, sent, 260);
+        sent[i / 8] ^= 1 << (i % 8);
+    }
+}
+
+TEST_F(FrameValidator, does_not_send_a_frame_without_room_for_the_crc) {
+    uint8_t data[] = {1, 2, 3, 4};
+    frame_t frame;
+    frame_init(&frame, data, 1);
+    for (int i = 1; i < MAX_FRAME_SEGMENTS; i++) {
+        EXPECT_TRUE(frame_append(&frame, data + i, 1));
+    }
+    EXPECT_FALSE(frame_append(&frame, data, 1));
+    EXPECT_EQ(frame.num_segments, MAX_FRAME_SEGMENTS);
+    EXPECT_CALL(*this, byte_stuffer_send_frame(_, _, _))
+        .Times(0);
+    validator_send_segments(0, &frame);
+}
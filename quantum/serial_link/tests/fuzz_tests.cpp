@@ -0,0 +1,371 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <random>
+#include "serial_link/tests/sim_network.h"
+
+extern "C" {
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/byte_stuffer.h"
+}
+
+// Feeds random and hostile byte streams into a chain of three nodes, which
+// then have to get back to normal operation. The target is built with
+// AddressSanitizer when it's available, so any access outside of the frame
+// buffers fails the test. The byte stuffer state of the down link is the
+// last one in its array, so the sanitizer catches decoder overflows on that
+// link. MAX_FRAME_SIZE is set low, so that the limit is hit often.
+
+#define NUM_NODES 3
+
+static uint32_t reference_crc32(const std::vector<uint8_t>& data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint8_t byte : data) {
+        crc ^= byte;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static std::vector<uint8_t> add_crc(std::vector<uint8_t> frame) {
+    uint32_t crc = reference_crc32(frame);
+    for (int i = 0; i < 4; i++) {
+        frame.push_back(crc >> (i * 8));
+    }
+    return frame;
+}
+
+// Straightforward COBS, including the terminating zero
+static std::vector<uint8_t> cobs_encode(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> encoded(1);
+    size_t block_start = 0;
+    uint8_t code = 1;
+    for (uint8_t byte : data) {
+        if (byte == 0 || code == 0xFF) {
+            encoded[block_start] = code;
+            block_start = encoded.size();
+            encoded.push_back(0);
+            code = 1;
+            if (byte == 0) {
+                continue;
+            }
+        }
+        encoded.push_back(byte);
+        code++;
+    }
+    encoded[block_start] = code;
+    encoded.push_back(0);
+    return encoded;
+}
+
+class SerialLinkFuzz : public testing::Test {
+public:
+    SerialLinkFuzz()
+        : network(NUM_NODES) {
+    }
+
+    void feed(uint8_t node, uint8_t link, const std::vector<uint8_t>& bytes) {
+        for (uint8_t byte : bytes) {
+            network.node(node).recv_byte(link, byte);
+        }
+    }
+
+    uint32_t frames_received(uint8_t node, uint8_t link) {
+        return network.node(node).stats[link].frames_received;
+    }
+
+    uint32_t framing_errors(uint8_t node, uint8_t link) {
+        return network.node(node).stats[link].framing_errors;
+    }
+
+    // Runs the network without errors, and checks that the payloads of the
+    // slaves reach the master and the master state the slaves
+    void expect_recovers() {
+        network.clear_cables();
+        network.set_bit_error_rate(0);
+        network.set_drop_rate(0);
+        // The fuzzing might have made a node see any sequence number, so the
+        // master state is written several times
+        for (int i = 0; i < 50; i++) {
+            next_seq++;
+            for (uint8_t n = 1; n < NUM_NODES; n++) {
+                sim_payload_t payload = {};
+                payload.seq = next_seq;
+                network.node(n).write_payload(&payload);
+            }
+            if (i % 10 == 0) {
+                sim_master_state_t state = {};
+                state.seq = next_seq;
+                last_state = next_seq;
+                network.node(0).write_master_state(&state);
+            }
+            network.update_and_tick();
+        }
+        for (int i = 0; i < 5; i++) {
+            network.update_and_tick();
+        }
+        for (uint8_t n = 1; n < NUM_NODES; n++) {
+            const sim_payload_t* payload = network.node(0).read_payload(n - 1);
+            ASSERT_NE(payload, nullptr) << "slave " << (int)n;
+            EXPECT_EQ(payload->seq, next_seq) << "slave " << (int)n;
+            const sim_master_state_t* state = network.node(n).read_master_state();
+            ASSERT_NE(state, nullptr) << "slave " << (int)n;
+            EXPECT_EQ(state->seq, last_state) << "slave " << (int)n;
+        }
+    }
+
+    SimNetwork network;
+    uint32_t next_seq = 0;
+    uint32_t last_state = 0;
+};
+
+TEST_F(SerialLinkFuzz, the_network_works_without_fuzzing) {
+    expect_recovers();
+}
+
+TEST_F(SerialLinkFuzz, frames_up_to_the_maximum_size_are_received) {
+    std::mt19937 rng(1);
+    for (uint16_t size = 5; size <= MAX_FRAME_SIZE; size++) {
+        // All zeros, no zeros at all and random contents
+        std::vector<std::vector<uint8_t>> contents = {
+            std::vector<uint8_t>(size - 4, 0),
+            std::vector<uint8_t>(size - 4, 0xFF),
+            std::vector<uint8_t>(size - 4),
+        };
+        for (uint8_t& byte : contents[2]) {
+            byte = rng();
+        }
+        for (auto& content : contents) {
+            for (uint8_t link : {UP_LINK, DOWN_LINK}) {
+                uint32_t received = frames_received(1, link);
+                feed(1, link, cobs_encode(add_crc(content)));
+                EXPECT_EQ(frames_received(1, link), received + 1) << "size " << size;
+            }
+        }
+    }
+    EXPECT_EQ(framing_errors(1, UP_LINK), 0);
+    EXPECT_EQ(framing_errors(1, DOWN_LINK), 0);
+    expect_recovers();
+}
+
+TEST_F(SerialLinkFuzz, too_long_frames_are_dropped) {
+    std::mt19937 rng(2);
+    std::vector<uint8_t> valid = cobs_encode(add_crc({1, 2, 3, 4}));
+    for (uint16_t size = MAX_FRAME_SIZE + 1; size <= 3 * MAX_FRAME_SIZE; size++) {
+        std::vector<std::vector<uint8_t>> contents = {
+            std::vector<uint8_t>(size - 4, 0),
+            std::vector<uint8_t>(size - 4, 0xFF),
+            std::vector<uint8_t>(size - 4),
+        };
+        for (uint8_t& byte : contents[2]) {
+            byte = rng();
+        }
+        for (auto& content : contents) {
+            for (uint8_t link : {UP_LINK, DOWN_LINK}) {
+                uint32_t received = frames_received(1, link);
+                feed(1, link, cobs_encode(add_crc(content)));
+                EXPECT_EQ(frames_received(1, link), received) << "size " << size;
+                // The decoder resynchronizes at the end of the frame
+                feed(1, link, valid);
+                EXPECT_EQ(frames_received(1, link), received + 1) << "size " << size;
+            }
+        }
+    }
+    EXPECT_GT(framing_errors(1, UP_LINK), 0);
+    EXPECT_GT(framing_errors(1, DOWN_LINK), 0);
+    expect_recovers();
+}
+
+TEST_F(SerialLinkFuzz, hostile_byte_stuffing_is_handled) {
+    std::vector<uint8_t> valid = cobs_encode(add_crc({1, 2, 3, 4}));
+    std::vector<std::vector<uint8_t>> streams;
+    // Long frames that never end
+    streams.push_back(std::vector<uint8_t>(10 * MAX_FRAME_SIZE, 0xFF));
+    streams.push_back(std::vector<uint8_t>(10 * MAX_FRAME_SIZE, 0x01));
+    streams.push_back(std::vector<uint8_t>(10 * MAX_FRAME_SIZE, 0x02));
+    // Every code byte followed by a frame that ends too early
+    for (int code = 1; code < 256; code++) {
+        streams.push_back({(uint8_t)code, 0x55, 0x55, 0x00});
+    }
+    // Every code byte followed by more data than the code says
+    for (int code = 1; code < 256; code++) {
+        std::vector<uint8_t> stream(1, code);
+        stream.insert(stream.end(), MAX_FRAME_SIZE + 8, 0x55);
+        stream.push_back(0);
+        streams.push_back(stream);
+    }
+    // A long block that crosses the maximum size exactly at a block boundary
+    {
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < 4; i++) {
+            stream.push_back(0xFF);
+            stream.insert(stream.end(), 254, 0x55);
+        }
+        stream.push_back(0);
+        streams.push_back(stream);
+    }
+    // Zero code blocks one after the other, ending right at the limit
+    {
+        std::vector<uint8_t> stream(MAX_FRAME_SIZE + 2, 0x01);
+        stream.push_back(0);
+        streams.push_back(stream);
+    }
+    // Just zeros
+    streams.push_back(std::vector<uint8_t>(100, 0));
+
+    for (auto& stream : streams) {
+        for (uint8_t node = 0; node < NUM_NODES; node++) {
+            for (uint8_t link : {UP_LINK, DOWN_LINK}) {
+                feed(node, link, stream);
+                // Anything left over is ended by the zero
+                feed(node, link, {0});
+                uint32_t received = frames_received(node, link);
+                feed(node, link, valid);
+                ASSERT_EQ(frames_received(node, link), received + 1);
+            }
+        }
+    }
+    expect_recovers();
+}
+
+TEST_F(SerialLinkFuzz, random_bytes_are_handled) {
+    for (uint32_t seed = 0; seed < 8; seed++) {
+        std::mt19937 rng(seed);
+        // Zeros are made more likely, so that frames of all sizes are seen
+        std::uniform_int_distribution<int> zero(0, 1 + seed * 16);
+        for (int i = 0; i < 100000; i++) {
+            uint8_t node = rng() % NUM_NODES;
+            uint8_t link = rng() % 2;
+            uint8_t byte = zero(rng) == 0 ? 0 : rng();
+            network.node(node).recv_byte(link, byte);
+        }
+        expect_recovers();
+    }
+}
+
+// Frames with a valid CRC and byte stuffing, which reach the router and the
+// transport, with the routing and object bytes at the end chosen from
+// interesting values
+TEST_F(SerialLinkFuzz, random_valid_frames_are_handled) {
+    std::mt19937 rng(3);
+    const uint8_t interesting[] = {
+        0, 1, 2, 3, 4, 0x7F, 0x80, 0x81, 0x82, 0xA0, 0xFE, 0xFF,
+    };
+    auto pick = [&]() {
+        return interesting[rng() % sizeof(interesting)];
+    };
+    for (int i = 0; i < 50000; i++) {
+        uint16_t size = 1 + rng() % (MAX_FRAME_SIZE - 4);
+        std::vector<uint8_t> frame(size);
+        for (uint8_t& byte : frame) {
+            byte = rng() % 4 == 0 ? pick() : rng();
+        }
+        // The router destination, object id, sequence number and number of
+        // acknowledgements
+        for (int j = 1; j <= 4 && j <= size; j++) {
+            if (rng() % 2) {
+                frame[size - j] = pick();
+            }
+        }
+        feed(rng() % NUM_NODES, rng() % 2, cobs_encode(add_crc(frame)));
+        network.update_and_tick();
+    }
+    expect_recovers();
+}
+
+// Real frames of the protocol, with random changes. Half of them get a valid
+// CRC, so that the changes reach the upper layers
+TEST_F(SerialLinkFuzz, mutated_frames_are_handled) {
+    std::vector<std::vector<uint8_t>> captured;
+    network.capture_frames(&captured);
+    expect_recovers();
+    network.capture_frames(nullptr);
+    ASSERT_GT(captured.size(), 0);
+
+    std::mt19937 rng(4);
+    for (int i = 0; i < 50000; i++) {
+        std::vector<uint8_t> encoded = captured[rng() % captured.size()];
+        if (rng() % 2) {
+            // Decode the frame, change it and encode it again with a new CRC
+            std::vector<uint8_t> frame;
+            size_t pos = 0;
+            while (pos < encoded.size() && encoded[pos] != 0) {
+                uint8_t code = encoded[pos++];
+                for (uint8_t j = 1; j < code && pos < encoded.size(); j++) {
+                    frame.push_back(encoded[pos++]);
+                }
+                if (code != 0xFF && pos < encoded.size() && encoded[pos] != 0) {
+                    frame.push_back(0);
+                }
+            }
+            if (frame.size() < 5) {
+                continue;
+            }
+            frame.resize(frame.size() - 4);
+            switch (rng() % 4) {
+            case 0:
+                frame[rng() % frame.size()] ^= 1 << (rng() % 8);
+                break;
+            case 1:
+                frame.resize(rng() % frame.size() + 1);
+                break;
+            case 2:
+                frame.insert(frame.begin() + rng() % frame.size(), rng());
+                break;
+            case 3:
+                frame[frame.size() - 1 - rng() % std::min<size_t>(frame.size(), 4)] = rng();
+                break;
+            }
+            if (frame.size() + 4 > MAX_FRAME_SIZE) {
+                continue;
+            }
+            encoded = cobs_encode(add_crc(frame));
+        }
+        else {
+            // Change the encoded frame directly
+            switch (rng() % 3) {
+            case 0:
+                encoded[rng() % encoded.size()] ^= 1 << (rng() % 8);
+                break;
+            case 1:
+                encoded.resize(rng() % encoded.size() + 1);
+                break;
+            case 2: {
+                std::vector<uint8_t>& other = captured[rng() % captured.size()];
+                encoded.insert(encoded.begin() + rng() % encoded.size(), other.begin(), other.end());
+                break;
+            }
+            }
+        }
+        feed(rng() % NUM_NODES, rng() % 2, encoded);
+        network.update_and_tick();
+    }
+    expect_recovers();
+}
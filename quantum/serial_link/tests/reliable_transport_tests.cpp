@@ -0,0 +1,235 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <random>
+
+extern "C" {
+#include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/frame_router.h"
+#include "serial_link/protocol/byte_stuffer.h"
+}
+
+// The whole protocol stack, with the down link of the master connected back
+// to itself through a cable that loses and corrupts frames. Frames sent to
+// slave 1 come back as if slave 1 sent them, so the same transport acts as
+// both ends of the link.
+
+RELIABLE_MASTER_TO_SINGLE_SLAVE_OBJECT(reliable, uint32_t);
+MASTER_TO_SINGLE_SLAVE_OBJECT(unreliable, uint32_t);
+
+static remote_object_t* test_remote_objects[] = {
+    REMOTE_OBJECT(reliable),
+    REMOTE_OBJECT(unreliable),
+};
+
+class ReliableTransport : public testing::Test {
+public:
+    ReliableTransport() {
+        Instance = this;
+        init_byte_stuffer();
+        router_set_master(true);
+        add_remote_objects(test_remote_objects, sizeof(test_remote_objects) / sizeof(remote_object_t*));
+        // Discover slave 1, which is the master itself
+        uint8_t empty_ack[] = {0, 0xFF};
+        transport_recv_frame(1, empty_ack, sizeof(empty_ack));
+    }
+
+    ~ReliableTransport() {
+        Instance = nullptr;
+        reinitialize_serial_link_transport();
+    }
+
+    void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+        EXPECT_EQ(link, DOWN_LINK);
+        num_frames_sent++;
+        if (drop_next > 0) {
+            drop_next--;
+            return;
+        }
+        if (percent(rng) < loss) {
+            return;
+        }
+        std::vector<uint8_t> frame(data, data + size);
+        if (percent(rng) < corruption) {
+            frame[rng() % frame.size()] ^= 1 << (rng() % 8);
+        }
+        cable.insert(cable.end(), frame.begin(), frame.end());
+    }
+
+    void deliver() {
+        std::vector<uint8_t> bytes;
+        bytes.swap(cable);
+        for (uint8_t byte : bytes) {
+            byte_stuffer_recv_byte(DOWN_LINK, byte);
+        }
+    }
+
+    // Updates and delivers until nothing is waiting for acknowledgements
+    void run_until_idle() {
+        for (int i = 0; i < 100; i++) {
+            bool pending = update_transport();
+            deliver();
+            if (!pending && cable.empty()) {
+                break;
+            }
+            time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+        }
+    }
+
+    void write_reliable(uint32_t value) {
+        *begin_write_reliable(0) = value;
+        end_write_reliable(0);
+    }
+
+    static ReliableTransport* Instance;
+
+    std::vector<uint8_t> cable;
+    int num_frames_sent = 0;
+    int drop_next = 0;
+    int loss = 0;
+    int corruption = 0;
+    uint16_t time = 0;
+    std::mt19937 rng;
+    std::uniform_int_distribution<int> percent{0, 99};
+};
+
+ReliableTransport* ReliableTransport::Instance = nullptr;
+
+extern "C" {
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    ReliableTransport::Instance->send_data(link, data, size);
+}
+
+void signal_data_written(void) {
+}
+
+uint16_t timer_read(void) {
+    return ReliableTransport::Instance->time;
+}
+}
+
+TEST_F(ReliableTransport, delivers_and_acknowledges) {
+    write_reliable(5);
+    EXPECT_TRUE(update_transport());
+    deliver();
+    uint32_t* obj = read_reliable();
+    ASSERT_NE(obj, nullptr);
+    EXPECT_EQ(*obj, 5);
+    // Sends the acknowledgement, which hasn't arrived yet
+    EXPECT_TRUE(update_transport());
+    deliver();
+    EXPECT_FALSE(update_transport());
+    EXPECT_EQ(num_frames_sent, 2);
+}
+
+TEST_F(ReliableTransport, resends_a_lost_object) {
+    drop_next = 1;
+    write_reliable(5);
+    update_transport();
+    deliver();
+    EXPECT_EQ(read_reliable(), nullptr);
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    update_transport();
+    deliver();
+    uint32_t* obj = read_reliable();
+    ASSERT_NE(obj, nullptr);
+    EXPECT_EQ(*obj, 5);
+}
+
+TEST_F(ReliableTransport, lost_acknowledgement_does_not_deliver_twice) {
+    write_reliable(5);
+    update_transport();
+    deliver();
+    EXPECT_NE(read_reliable(), nullptr);
+    drop_next = 1;
+    update_transport();
+    deliver();
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    EXPECT_TRUE(update_transport());
+    deliver();
+    EXPECT_EQ(read_reliable(), nullptr);
+    update_transport();
+    deliver();
+    EXPECT_FALSE(update_transport());
+}
+
+TEST_F(ReliableTransport, first_object_of_a_restarted_peer_is_not_a_duplicate) {
+    // The last object from before the restart, numbered 1
+    uint8_t before_restart[] = {99, 0, 0, 0, 0, 1, 0};
+    transport_recv_frame(1, before_restart, sizeof(before_restart));
+    ASSERT_NE(read_reliable(), nullptr);
+    // This transport was just started, and sends its first object
+    write_reliable(5);
+    run_until_idle();
+    uint32_t* obj = read_reliable();
+    ASSERT_NE(obj, nullptr);
+    EXPECT_EQ(*obj, 5);
+}
+
+TEST_F(ReliableTransport, acknowledgement_is_added_to_the_next_object) {
+    write_reliable(5);
+    update_transport();
+    deliver();
+    EXPECT_NE(read_reliable(), nullptr);
+    write_reliable(6);
+    num_frames_sent = 0;
+    update_transport();
+    EXPECT_EQ(num_frames_sent, 1);
+}
+
+TEST_F(ReliableTransport, gives_up_after_the_maximum_retransmits) {
+    loss = 100;
+    write_reliable(5);
+    run_until_idle();
+    EXPECT_EQ(num_frames_sent, 1 + SERIAL_LINK_MAX_RETRANSMITS);
+    EXPECT_FALSE(update_transport());
+}
+
+TEST_F(ReliableTransport, unreliable_object_is_not_resent) {
+    loss = 100;
+    *begin_write_unreliable(0) = 5;
+    end_write_unreliable(0);
+    EXPECT_FALSE(update_transport());
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    update_transport();
+    EXPECT_EQ(num_frames_sent, 1);
+}
+
+TEST_F(ReliableTransport, every_write_arrives_through_a_noisy_cable) {
+    loss = 20;
+    corruption = 10;
+    uint32_t received = 0;
+    for (uint32_t i = 1; i <= 500; i++) {
+        write_reliable(i);
+        run_until_idle();
+        uint32_t* obj = read_reliable();
+        if (obj) {
+            received = *obj;
+        }
+        ASSERT_EQ(received, i);
+    }
+}
@@ -1,16 +1,21 @@
 serial_link_byte_stuffer_SRC :=\
 	$(SERIAL_PATH)/tests/byte_stuffer_tests.cpp \
-	$(SERIAL_PATH)/protocol/byte_stuffer.c
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
 
 serial_link_frame_validator_SRC := \
 	$(SERIAL_PATH)/tests/frame_validator_tests.cpp \
-	$(SERIAL_PATH)/protocol/frame_validator.c 
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc32.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
 
 serial_link_frame_router_SRC := \
 	$(SERIAL_PATH)/tests/frame_router_tests.cpp \
 	$(SERIAL_PATH)/protocol/byte_stuffer.c \
 	$(SERIAL_PATH)/protocol/frame_validator.c \
-	$(SERIAL_PATH)/protocol/frame_router.c
+	$(SERIAL_PATH)/protocol/crc32.c \
+	$(SERIAL_PATH)/protocol/frame_router.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
 
 serial_link_triple_buffered_object_SRC := \
 	$(SERIAL_PATH)/tests/triple_buffered_object_tests.cpp \
@@ -20,3 +25,48 @@ serial_link_transport_SRC := \
 	$(SERIAL_PATH)/tests/transport_tests.cpp \
 	$(SERIAL_PATH)/protocol/transport.c \
 	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+
+serial_link_reliable_transport_SRC := \
+	$(SERIAL_PATH)/tests/reliable_transport_tests.cpp \
+	$(SERIAL_PATH)/protocol/transport.c \
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c \
+	$(SERIAL_PATH)/protocol/frame_router.c \
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc32.c \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/link_stats.c
+
+CRC32_TEST_SRC := \
+	$(SERIAL_PATH)/tests/crc32_tests.cpp \
+	$(SERIAL_PATH)/protocol/crc32.c
+
+serial_link_crc32_nibble_SRC := $(CRC32_TEST_SRC)
+serial_link_crc32_nibble_DEFS := -DCRC32_NIBBLE
+serial_link_crc32_byte_SRC := $(CRC32_TEST_SRC)
+serial_link_crc32_byte_DEFS := -DCRC32_BYTE
+serial_link_crc32_slicing_by_4_SRC := $(CRC32_TEST_SRC)
+serial_link_crc32_slicing_by_4_DEFS := -DCRC32_SLICING_BY_4
+serial_link_crc32_slicing_by_8_SRC := $(CRC32_TEST_SRC)
+serial_link_crc32_slicing_by_8_DEFS := -DCRC32_SLICING_BY_8
+
+SIM_NODE_SRC := \
+	$(SERIAL_PATH)/tests/sim_network.cpp \
+	$(SERIAL_PATH)/tests/sim_node1.c \
+	$(SERIAL_PATH)/tests/sim_node2.c \
+	$(SERIAL_PATH)/tests/sim_node3.c
+
+serial_link_fuzz_SRC := \
+	$(SERIAL_PATH)/tests/fuzz_tests.cpp \
+	$(SIM_NODE_SRC)
+serial_link_fuzz_DEFS := -DMAX_FRAME_SIZE=64
+# Built with AddressSanitizer, so that out of bounds accesses fail the test,
+# set SANITIZE to nothing for toolchains that don't support it
+SANITIZE ?= address
+ifneq ($(strip $(SANITIZE)),)
+serial_link_fuzz_DEFS += -fsanitize=$(SANITIZE) -fno-omit-frame-pointer
+serial_link_fuzz_LDFLAGS := -fsanitize=$(SANITIZE)
+endif
+
+serial_link_throughput_SRC := \
+	$(SERIAL_PATH)/tests/throughput_tests.cpp \
+	$(SIM_NODE_SRC)
@@ -0,0 +1,157 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "serial_link/tests/sim_network.h"
+#include <cassert>
+
+extern "C" {
+#include "serial_link/protocol/frame_router.h"
+}
+
+static const sim_node_t* const all_nodes[SIM_MAX_NODES] = {
+    &sim_node1,
+    &sim_node2,
+    &sim_node3,
+};
+
+SimNetwork* SimNetwork::Instance = nullptr;
+
+SimNetwork::SimNetwork(uint8_t num_nodes, uint32_t seed)
+    : rng(seed) {
+    assert(num_nodes <= SIM_MAX_NODES);
+    Instance = this;
+    for (uint8_t i = 0; i < num_nodes; i++) {
+        nodes.push_back(all_nodes[i]);
+        nodes[i]->init(i == 0);
+    }
+    for (uint8_t i = 0; i + 1 < num_nodes; i++) {
+        cables.push_back(Cable{{}, nodes[i + 1], UP_LINK, true});
+        cables.push_back(Cable{{}, nodes[i], DOWN_LINK, true});
+    }
+}
+
+SimNetwork::~SimNetwork() {
+    Instance = nullptr;
+}
+
+void SimNetwork::set_bit_error_rate(double rate) {
+    has_bit_errors = rate > 0;
+    if (has_bit_errors) {
+        bit_errors = std::geometric_distribution<int64_t>(rate);
+        next_bit_error();
+    }
+}
+
+void SimNetwork::next_bit_error() {
+    bits_until_error = bit_errors(rng);
+}
+
+void SimNetwork::set_connected(uint8_t node, bool connected) {
+    cables[node * 2].connected = connected;
+    cables[node * 2 + 1].connected = connected;
+    if (!connected) {
+        cables[node * 2].bytes.clear();
+        cables[node * 2 + 1].bytes.clear();
+    }
+}
+
+void SimNetwork::clear_cables() {
+    for (Cable& cable : cables) {
+        cable.bytes.clear();
+    }
+}
+
+SimNetwork::Cable* SimNetwork::get_cable(uint8_t node, uint8_t link) {
+    if (link == DOWN_LINK && node + 1 < nodes.size()) {
+        return &cables[node * 2];
+    }
+    if (link == UP_LINK && node > 0) {
+        return &cables[(node - 1) * 2 + 1];
+    }
+    // The up link of the master and the down link of the last slave are not
+    // connected
+    return nullptr;
+}
+
+void SimNetwork::send(uint8_t node, uint8_t link, const uint8_t* data, uint16_t size) {
+    if (captured) {
+        captured->emplace_back(data, data + size);
+    }
+    Cable* cable = get_cable(node, link);
+    if (!cable || !cable->connected) {
+        return;
+    }
+    bytes_sent += size;
+    if (drop_rate > 0 && probability(rng) < drop_rate) {
+        frames_dropped++;
+        return;
+    }
+    for (uint16_t i = 0; i < size; i++) {
+        uint8_t byte = data[i];
+        if (has_bit_errors) {
+            while (bits_until_error < 8) {
+                byte ^= 1 << bits_until_error;
+                bits_flipped++;
+                bits_until_error += 1 + bit_errors(rng);
+            }
+            bits_until_error -= 8;
+        }
+        cable->bytes.push_back(byte);
+    }
+}
+
+void SimNetwork::tick() {
+    time++;
+    for (Cable& cable : cables) {
+        // Bytes forwarded by the receiver during this tick are delivered in
+        // the next one
+        size_t count = cable.bytes.size();
+        if (bytes_per_ms && count > bytes_per_ms) {
+            count = bytes_per_ms;
+        }
+        for (size_t i = 0; i < count && !cable.bytes.empty(); i++) {
+            uint8_t byte = cable.bytes.front();
+            cable.bytes.pop_front();
+            cable.to->recv_byte(cable.to_link, byte);
+        }
+    }
+}
+
+void SimNetwork::update_and_tick() {
+    for (const sim_node_t* node : nodes) {
+        node->update();
+    }
+    tick();
+}
+
+extern "C" {
+void sim_send_data(uint8_t node, uint8_t link, const uint8_t* data, uint16_t size) {
+    SimNetwork::Instance->send(node, link, data, size);
+}
+
+uint16_t sim_timer_read(void) {
+    return SimNetwork::Instance->time;
+}
+}
@@ -0,0 +1,100 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SERIAL_LINK_SIM_NETWORK_H
+#define SERIAL_LINK_SIM_NETWORK_H
+
+#include <vector>
+#include <deque>
+#include <random>
+#include <cstdint>
+
+extern "C" {
+#include "serial_link/tests/sim_node.h"
+}
+
+// A chain of simulated nodes, the first one is the master. The down link of
+// each node is connected to the up link of the next one by a cable that
+// carries a limited number of bytes each millisecond, and that can flip bits
+// and drop whole frames.
+class SimNetwork {
+public:
+    SimNetwork(uint8_t num_nodes, uint32_t seed = 0);
+    ~SimNetwork();
+
+    const sim_node_t& node(uint8_t index) const { return *nodes[index]; }
+    uint8_t num_nodes() const { return nodes.size(); }
+
+    // Zero means that everything is delivered in the next tick
+    void set_bytes_per_ms(uint32_t bytes) { bytes_per_ms = bytes; }
+    void set_bit_error_rate(double rate);
+    void set_drop_rate(double rate) { drop_rate = rate; }
+    // Disconnects the cable between the node and the next one, everything
+    // sent to it is lost
+    void set_connected(uint8_t node, bool connected);
+    // Stores a copy of each encoded frame that is sent
+    void capture_frames(std::vector<std::vector<uint8_t>>* frames) { captured = frames; }
+
+    void clear_cables();
+    // Advances the time by a millisecond and delivers what the cables can
+    // carry in that time
+    void tick();
+    // Calls update on every node and then ticks
+    void update_and_tick();
+
+    void send(uint8_t node, uint8_t link, const uint8_t* data, uint16_t size);
+
+    uint16_t time = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t bits_flipped = 0;
+
+    static SimNetwork* Instance;
+
+private:
+    struct Cable {
+        std::deque<uint8_t> bytes;
+        const sim_node_t* to;
+        uint8_t to_link;
+        bool connected;
+    };
+
+    Cable* get_cable(uint8_t node, uint8_t link);
+    void next_bit_error();
+
+    std::vector<const sim_node_t*> nodes;
+    // cables[i * 2] goes down from node i, and cables[i * 2 + 1] up to it
+    std::vector<Cable> cables;
+    std::vector<std::vector<uint8_t>>* captured = nullptr;
+    uint32_t bytes_per_ms = 0;
+    double drop_rate = 0;
+    std::mt19937 rng;
+    std::uniform_real_distribution<double> probability{0.0, 1.0};
+    std::geometric_distribution<int64_t> bit_errors;
+    bool has_bit_errors = false;
+    int64_t bits_until_error = 0;
+};
+
+#endif
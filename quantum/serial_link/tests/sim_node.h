@@ -0,0 +1,78 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef SERIAL_LINK_SIM_NODE_H
+#define SERIAL_LINK_SIM_NODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "serial_link/protocol/link_stats.h"
+
+// A complete serial link protocol stack, from the byte stuffer to the
+// transport, for simulating a chain of keyboards on the host.
+// The protocol modules keep their state in static variables, so each node is
+// a separate copy of them, compiled by sim_node1.c, sim_node2.c and so on
+// from sim_node_template.c.
+
+// Sent by each slave to the master
+typedef struct {
+    uint32_t seq;
+    uint16_t time;
+    uint8_t data[26];
+} sim_payload_t;
+
+// Sent reliably by the master to all slaves
+typedef struct {
+    uint32_t seq;
+    uint16_t time;
+    uint16_t padding;
+} sim_master_state_t;
+
+typedef struct {
+    // Resets all state, and makes the node the master or a slave
+    void (*init)(bool master);
+    void (*recv_byte)(uint8_t link, uint8_t data);
+    bool (*update)(void);
+    void (*write_payload)(const sim_payload_t* payload);
+    // Returns NULL if nothing new has been received from the slave
+    const sim_payload_t* (*read_payload)(uint8_t slave);
+    void (*write_master_state)(const sim_master_state_t* state);
+    // Returns NULL if nothing new has been received from the master
+    const sim_master_state_t* (*read_master_state)(void);
+    uint8_t (*num_slaves)(void);
+    link_stats_t* stats;
+} sim_node_t;
+
+#define SIM_MAX_NODES 3
+
+extern const sim_node_t sim_node1;
+extern const sim_node_t sim_node2;
+extern const sim_node_t sim_node3;
+
+// Implemented by the simulation, the node is the index in the chain
+void sim_send_data(uint8_t node, uint8_t link, const uint8_t* data, uint16_t size);
+uint16_t sim_timer_read(void);
+
+#endif
@@ -0,0 +1,135 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// Included by the sim_node files with SIM_NODE set to the name of the node
+// and SIM_NODE_INDEX to its index in the chain. Every external symbol of the
+// protocol is renamed with the name of the node as a prefix, so that the
+// nodes can be linked together. The renaming has to come before any of the
+// protocol headers are included.
+
+#define SIM_CAT_INTERNAL(a, b) a##_##b
+#define SIM_CAT(a, b) SIM_CAT_INTERNAL(a, b)
+#define NODE(name) SIM_CAT(SIM_NODE, name)
+
+#define init_byte_stuffer_state NODE(init_byte_stuffer_state)
+#define init_byte_stuffer NODE(init_byte_stuffer)
+#define byte_stuffer_recv_byte NODE(byte_stuffer_recv_byte)
+#define byte_stuffer_send_segments NODE(byte_stuffer_send_segments)
+#define byte_stuffer_send_frame NODE(byte_stuffer_send_frame)
+#define crc32_update NODE(crc32_update)
+#define validator_recv_frame NODE(validator_recv_frame)
+#define validator_send_segments NODE(validator_send_segments)
+#define validator_send_frame NODE(validator_send_frame)
+#define router_set_master NODE(router_set_master)
+#define route_incoming_frame NODE(route_incoming_frame)
+#define router_send_segments NODE(router_send_segments)
+#define router_send_frame NODE(router_send_frame)
+#define reinitialize_serial_link_transport NODE(reinitialize_serial_link_transport)
+#define transport_num_slaves NODE(transport_num_slaves)
+#define transport_get_slave_object NODE(transport_get_slave_object)
+#define transport_recv_frame NODE(transport_recv_frame)
+#define transport_object_written NODE(transport_object_written)
+#define add_remote_objects NODE(add_remote_objects)
+#define update_transport NODE(update_transport)
+#define triple_buffer_init NODE(triple_buffer_init)
+#define triple_buffer_read_internal NODE(triple_buffer_read_internal)
+#define triple_buffer_read_last_internal NODE(triple_buffer_read_last_internal)
+#define triple_buffer_begin_write_internal NODE(triple_buffer_begin_write_internal)
+#define triple_buffer_end_write_internal NODE(triple_buffer_end_write_internal)
+#define link_stats NODE(link_stats)
+#define reset_link_stats NODE(reset_link_stats)
+#define send_data NODE(send_data)
+#define signal_data_written NODE(signal_data_written)
+#define timer_read NODE(timer_read)
+
+#include "serial_link/protocol/byte_stuffer.c"
+#include "serial_link/protocol/crc32.c"
+#include "serial_link/protocol/frame_validator.c"
+#include "serial_link/protocol/frame_router.c"
+#include "serial_link/protocol/link_stats.c"
+#include "serial_link/protocol/transport.c"
+#include "serial_link/protocol/triple_buffered_object.c"
+#include "serial_link/tests/sim_node.h"
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    sim_send_data(SIM_NODE_INDEX, link, data, size);
+}
+
+void signal_data_written(void) {
+}
+
+uint16_t timer_read(void) {
+    return sim_timer_read();
+}
+
+// The object names are expanded before the object macros paste them
+SLAVE_TO_MASTER_OBJECT(NODE(payload), sim_payload_t)
+RELIABLE_MASTER_TO_ALL_SLAVES_OBJECT(NODE(master_state), sim_master_state_t)
+
+#define PAYLOAD(prefix) SIM_CAT(prefix, NODE(payload))
+#define MASTER_STATE(prefix) SIM_CAT(prefix, NODE(master_state))
+
+static remote_object_t* sim_objects[] = {
+    (remote_object_t*)&PAYLOAD(remote_object),
+    (remote_object_t*)&MASTER_STATE(remote_object),
+};
+
+static void sim_init(bool master) {
+    reinitialize_serial_link_transport();
+    init_byte_stuffer();
+    reset_link_stats();
+    router_set_master(master);
+    add_remote_objects(sim_objects, sizeof(sim_objects) / sizeof(remote_object_t*));
+}
+
+static void sim_write_payload(const sim_payload_t* payload) {
+    *PAYLOAD(begin_write)() = *payload;
+    PAYLOAD(end_write)();
+}
+
+static const sim_payload_t* sim_read_payload(uint8_t slave) {
+    return PAYLOAD(read)(slave);
+}
+
+static void sim_write_master_state(const sim_master_state_t* state) {
+    *MASTER_STATE(begin_write)() = *state;
+    MASTER_STATE(end_write)();
+}
+
+static const sim_master_state_t* sim_read_master_state(void) {
+    return MASTER_STATE(read)();
+}
+
+const sim_node_t SIM_NODE = {
+    .init = sim_init,
+    .recv_byte = byte_stuffer_recv_byte,
+    .update = update_transport,
+    .write_payload = sim_write_payload,
+    .read_payload = sim_read_payload,
+    .write_master_state = sim_write_master_state,
+    .read_master_state = sim_read_master_state,
+    .num_slaves = transport_num_slaves,
+    .stats = link_stats,
+};
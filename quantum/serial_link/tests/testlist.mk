@@ -1,6 +1,13 @@
 TEST_LIST +=\
 	serial_link_byte_stuffer\
+	serial_link_crc32_nibble\
+	serial_link_crc32_byte\
+	serial_link_crc32_slicing_by_4\
+	serial_link_crc32_slicing_by_8\
 	serial_link_frame_validator\
 	serial_link_frame_router\
 	serial_link_triple_buffered_object\
-	serial_link_transport
\ No newline at end of file
+	serial_link_transport\
+	serial_link_reliable_transport\
+	serial_link_fuzz\
+	serial_link_throughput
\ No newline at end of file
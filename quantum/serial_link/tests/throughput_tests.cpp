@@ -0,0 +1,260 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include "serial_link/tests/sim_network.h"
+
+extern "C" {
+#include "serial_link/protocol/transport.h"
+}
+
+// A chain of a master and two slaves, where every slave sends its payload
+// each millisecond, like a matrix scan, and the master sends a reliable state
+// to all slaves every STATE_INTERVAL milliseconds. The cables carry 100 bytes
+// per millisecond, which is a 1 Mbit/s UART.
+//
+// Reported for each cable configuration
+//   frames/s     Frames received by all nodes per simulated second, and per
+//                second of host time, which measures the cost of the stack
+//   goodput      Payload bytes that reach the master per simulated second,
+//                and the percentage of the written payloads that arrive
+//   latency      From the payload being written to the master reading it
+//   state        From the master writing the state until every slave has
+//                read it or a later state, and the number of states that
+//                never arrived
+
+#define NUM_NODES 3
+#define BYTES_PER_MS 100
+#define STATE_INTERVAL 20
+
+struct CableConfig {
+    const char* name;
+    double bit_error_rate;
+    double drop_rate;
+};
+
+struct Results {
+    uint64_t frames_received = 0;
+    uint64_t crc_errors = 0;
+    uint64_t payloads_written = 0;
+    uint64_t payloads_delivered = 0;
+    uint64_t payload_latency = 0;
+    uint64_t states_written = 0;
+    uint64_t states_delivered = 0;
+    uint64_t state_latency = 0;
+    uint32_t max_state_latency = 0;
+    double sim_seconds = 0;
+    double host_seconds = 0;
+
+    double payload_delivery() const {
+        return 100.0 * payloads_delivered / payloads_written;
+    }
+    double average_state_latency() const {
+        return states_delivered ? (double)state_latency / states_delivered : 0;
+    }
+};
+
+class ChainSimulation {
+public:
+    ChainSimulation()
+        : network(NUM_NODES, 1234) {
+        network.set_bytes_per_ms(BYTES_PER_MS);
+    }
+
+    void write_payloads() {
+        for (uint8_t n = 1; n < NUM_NODES; n++) {
+            sim_payload_t payload = {};
+            payload.seq = ++payload_seq[n];
+            payload.time = network.time;
+            network.node(n).write_payload(&payload);
+            results.payloads_written++;
+        }
+    }
+
+    void write_state() {
+        sim_master_state_t state = {};
+        state.seq = ++state_seq;
+        state.time = network.time;
+        state_times.push_back(network.time);
+        network.node(0).write_master_state(&state);
+        results.states_written++;
+    }
+
+    void read_objects() {
+        for (uint8_t n = 1; n < NUM_NODES; n++) {
+            const sim_payload_t* payload = network.node(0).read_payload(n - 1);
+            if (payload) {
+                results.payloads_delivered++;
+                results.payload_latency += (uint16_t)(network.time - payload->time);
+                payload_received[n] = network.time;
+            }
+            const sim_master_state_t* state = network.node(n).read_master_state();
+            if (state) {
+                state_seen[n] = state->seq;
+            }
+        }
+        // A state is delivered when every slave has it or a later one
+        uint32_t seen = state_seen[1];
+        for (uint8_t n = 2; n < NUM_NODES; n++) {
+            seen = std::min(seen, state_seen[n]);
+        }
+        while (states_converged < seen) {
+            uint16_t latency = network.time - state_times[states_converged];
+            results.state_latency += latency;
+            results.max_state_latency = std::max<uint32_t>(results.max_state_latency, latency);
+            results.states_delivered++;
+            states_converged++;
+        }
+    }
+
+    void run_one_ms(bool write) {
+        if (write) {
+            write_payloads();
+            if (network.time % STATE_INTERVAL == 0) {
+                write_state();
+            }
+        }
+        network.update_and_tick();
+        read_objects();
+    }
+
+    Results run(const CableConfig& config, uint32_t duration_ms) {
+        network.set_bit_error_rate(config.bit_error_rate);
+        network.set_drop_rate(config.drop_rate);
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < duration_ms; i++) {
+            run_one_ms(true);
+        }
+        // Let the retransmissions finish
+        for (int i = 0; i < SERIAL_LINK_RETRANSMIT_TIMEOUT * (SERIAL_LINK_MAX_RETRANSMITS + 2); i++) {
+            run_one_ms(false);
+        }
+        auto end = std::chrono::steady_clock::now();
+        results.sim_seconds = duration_ms / 1000.0;
+        results.host_seconds = std::chrono::duration<double>(end - start).count();
+        for (uint8_t n = 0; n < NUM_NODES; n++) {
+            for (uint8_t link = 0; link < NUM_LINKS; link++) {
+                results.frames_received += network.node(n).stats[link].frames_received;
+                results.crc_errors += network.node(n).stats[link].crc_errors;
+            }
+        }
+        return results;
+    }
+
+    static void print_header() {
+        printf("%-22s %10s %12s %10s %8s %9s %9s %9s %6s %8s\n",
+            "cable", "frames/s", "host fr/s", "goodput", "arrived", "latency",
+            "state avg", "state max", "lost", "crc err");
+    }
+
+    static void print(const CableConfig& config, const Results& r) {
+        printf("%-22s %10.0f %12.0f %8.0f/s %7.2f%% %7.2fms %7.2fms %7ums %6llu %8llu\n",
+            config.name,
+            r.frames_received / r.sim_seconds,
+            r.frames_received / r.host_seconds,
+            r.payloads_delivered * sizeof(sim_payload_t) / r.sim_seconds,
+            r.payload_delivery(),
+            r.payloads_delivered ? (double)r.payload_latency / r.payloads_delivered : 0,
+            r.average_state_latency(),
+            r.max_state_latency,
+            (unsigned long long)(r.states_written - r.states_delivered),
+            (unsigned long long)r.crc_errors);
+    }
+
+    SimNetwork network;
+    Results results;
+    uint32_t payload_seq[NUM_NODES] = {};
+    uint32_t state_seq = 0;
+    uint16_t payload_received[NUM_NODES] = {};
+    uint32_t state_seen[NUM_NODES] = {};
+    uint32_t states_converged = 0;
+    std::vector<uint16_t> state_times;
+};
+
+TEST(SerialLinkThroughput, clean_cables_deliver_everything) {
+    ChainSimulation sim;
+    Results r = sim.run({"clean", 0, 0}, 2000);
+    EXPECT_EQ(r.crc_errors, 0);
+    EXPECT_EQ(r.payloads_delivered, r.payloads_written);
+    EXPECT_EQ(r.states_delivered, r.states_written);
+    EXPECT_LE(r.max_state_latency, 5);
+}
+
+TEST(SerialLinkThroughput, reliable_state_survives_errors) {
+    ChainSimulation sim;
+    Results r = sim.run({"ber 1e-4, drop 5%", 1e-4, 0.05}, 5000);
+    EXPECT_GT(r.crc_errors, 0);
+    EXPECT_EQ(r.states_delivered, r.states_written);
+    EXPECT_GT(r.payload_delivery(), 80);
+}
+
+TEST(SerialLinkThroughput, recovers_after_a_disconnection) {
+    ChainSimulation sim;
+    sim.run({"clean", 0, 0}, 100);
+    sim.network.set_connected(0, false);
+    for (int i = 0; i < 500; i++) {
+        sim.run_one_ms(true);
+    }
+    sim.network.set_connected(0, true);
+    uint16_t reconnected = sim.network.time;
+    uint32_t written = sim.state_seq;
+    int recovery = -1;
+    for (int i = 0; i < 200 && recovery < 0; i++) {
+        sim.run_one_ms(true);
+        bool recovered = sim.states_converged >= written;
+        for (uint8_t n = 1; n < NUM_NODES; n++) {
+            recovered &= sim.payload_received[n] > reconnected;
+        }
+        if (recovered) {
+            recovery = (uint16_t)(sim.network.time - reconnected);
+        }
+    }
+    printf("Recovery after a 500 ms disconnection: %d ms\n", recovery);
+    EXPECT_GE(recovery, 0);
+    EXPECT_LE(recovery, STATE_INTERVAL + 5);
+}
+
+TEST(SerialLinkThroughput, benchmark) {
+    const CableConfig configs[] = {
+        {"clean", 0, 0},
+        {"ber 1e-5", 1e-5, 0},
+        {"ber 1e-4", 1e-4, 0},
+        {"ber 1e-3", 1e-3, 0},
+        {"drop 1%", 0, 0.01},
+        {"drop 10%", 0, 0.1},
+        {"ber 1e-4, drop 5%", 1e-4, 0.05},
+    };
+    ChainSimulation::print_header();
+    for (const CableConfig& config : configs) {
+        ChainSimulation sim;
+        Results r = sim.run(config, 10000);
+        ChainSimulation::print(config, r);
+        EXPECT_GT(r.payloads_delivered, 0) << config.name;
+    }
+}
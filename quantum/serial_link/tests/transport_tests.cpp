@@ -31,6 +31,7 @@ using testing::Args;
 
 extern "C" {
 #include "serial_link/protocol/transport.h"
+#include "serial_link/protocol/frame_router.h"
 }
 
 struct test_object1 {
@@ -45,11 +46,13 @@ struct test_object2 {
 MASTER_TO_ALL_SLAVES_OBJECT(master_to_slave, test_object1);
 MASTER_TO_SINGLE_SLAVE_OBJECT(master_to_single_slave, test_object1);
 SLAVE_TO_MASTER_OBJECT(slave_to_master, test_object1);
+RELIABLE_MASTER_TO_ALL_SLAVES_OBJECT(reliable_master_to_slave, test_object1);
 
 static remote_object_t* test_remote_objects[] = {
     REMOTE_OBJECT(master_to_slave),
     REMOTE_OBJECT(master_to_single_slave),
     REMOTE_OBJECT(slave_to_master),
+    REMOTE_OBJECT(reliable_master_to_slave),
 };
 
 class Transport : public testing::Test {
@@ -67,14 +70,24 @@ public:
     MOCK_METHOD0(signal_data_written, void ());
     MOCK_METHOD1(router_send_frame, void (uint8_t destination));
 
-    void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
+    void router_send_segments(uint8_t destination, frame_t* frame) {
         router_send_frame(destination);
-        std::copy(data, data + size, std::back_inserter(sent_data));
+        for (int i = 0; i < frame->num_segments; i++) {
+            const uint8_t* data = frame->segments[i].data;
+            std::copy(data, data + frame->segments[i].size, std::back_inserter(sent_data));
+        }
+    }
+
+    // Slaves are discovered when something is received from them
+    void discover_slaves(uint8_t num) {
+        uint8_t empty_ack[] = {0, 0xFF};
+        transport_recv_frame(num, empty_ack, sizeof(empty_ack));
     }
 
     static Transport* Instance;
 
     std::vector<uint8_t> sent_data;
+    uint16_t time = 0;
 };
 
 Transport* Transport::Instance = nullptr;
@@ -84,12 +97,17 @@ void signal_data_written(void) {
     Transport::Instance->signal_data_written();
 }
 
-void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
-    Transport::Instance->router_send_frame(destination, data, size);
+void router_send_segments(uint8_t destination, frame_t* frame) {
+    Transport::Instance->router_send_segments(destination, frame);
+}
+
+uint16_t timer_read(void) {
+    return Transport::Instance->time;
 }
 }
 
 TEST_F(Transport, write_to_local_signals_an_event) {
+    discover_slaves(2);
     begin_write_master_to_slave();
     EXPECT_CALL(*this, signal_data_written());
     end_write_master_to_slave();
@@ -131,6 +149,7 @@ TEST_F(Transport, writes_from_slave_to_master) {
 }
 
 TEST_F(Transport, writes_from_master_to_single_slave) {
+    discover_slaves(4);
     update_transport();
     test_object1* obj = begin_write_master_to_single_slave(3);
     obj->test = 7;
@@ -145,6 +164,7 @@ TEST_F(Transport, writes_from_master_to_single_slave) {
 }
 
 TEST_F(Transport, ignores_object_with_invalid_id) {
+    discover_slaves(4);
     update_transport();
     test_object1* obj = begin_write_master_to_single_slave(3);
     obj->test = 7;
@@ -186,3 +206,167 @@ TEST_F(Transport, ignores_object_with_size_too_big) {
     test_object1* obj2 = read_master_to_slave();
     EXPECT_EQ(obj2, nullptr);
 }
+
+TEST_F(Transport, sends_nothing_when_nothing_is_written) {
+    EXPECT_CALL(*this, router_send_frame(_))
+        .Times(0);
+    update_transport();
+    update_transport();
+}
+
+TEST_F(Transport, sends_a_written_object_only_once) {
+    begin_write_master_to_slave()->test = 1;
+    EXPECT_CALL(*this, signal_data_written());
+    end_write_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update_transport();
+    update_transport();
+}
+
+TEST_F(Transport, sends_only_to_the_written_slaves) {
+    discover_slaves(7);
+    EXPECT_CALL(*this, signal_data_written())
+        .Times(2);
+    begin_write_master_to_single_slave(2)->test = 1;
+    end_write_master_to_single_slave(2);
+    begin_write_master_to_single_slave(6)->test = 2;
+    end_write_master_to_single_slave(6);
+    testing::InSequence s;
+    EXPECT_CALL(*this, router_send_frame(3));
+    EXPECT_CALL(*this, router_send_frame(7));
+    update_transport();
+}
+
+TEST_F(Transport, reliable_object_has_a_sequence_number) {
+    EXPECT_CALL(*this, signal_data_written());
+    begin_write_reliable_master_to_slave()->test = 7;
+    end_write_reliable_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    EXPECT_TRUE(update_transport());
+    // The object, no acknowledgements, the sequence number and the id
+    uint8_t expected[] = {7, 0, 0, 0, 0, 0, 3};
+    EXPECT_THAT(sent_data, ElementsAreArray(expected));
+}
+
+TEST_F(Transport, reliable_object_is_sent_again_until_acknowledged) {
+    EXPECT_CALL(*this, signal_data_written());
+    begin_write_reliable_master_to_slave()->test = 7;
+    end_write_reliable_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF))
+        .Times(2);
+    update_transport();
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT - 1;
+    update_transport();
+    time += 1;
+    update_transport();
+    // Acknowledgement of id 3, sequence 0 from slave 1
+    uint8_t ack[] = {3, 0, 1, 0xFF};
+    transport_recv_frame(1, ack, sizeof(ack));
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    EXPECT_FALSE(update_transport());
+}
+
+TEST_F(Transport, broadcast_waits_for_the_acknowledgement_of_every_slave) {
+    discover_slaves(2);
+    EXPECT_CALL(*this, signal_data_written());
+    begin_write_reliable_master_to_slave()->test = 7;
+    end_write_reliable_master_to_slave();
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update_transport();
+    uint8_t ack[] = {3, 0, 1, 0xFF};
+    transport_recv_frame(2, ack, sizeof(ack));
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    EXPECT_TRUE(update_transport());
+    transport_recv_frame(1, ack, sizeof(ack));
+    time += SERIAL_LINK_RETRANSMIT_TIMEOUT;
+    EXPECT_FALSE(update_transport());
+}
+
+TEST_F(Transport, received_reliable_object_is_acknowledged) {
+    uint8_t frame[] = {9, 0, 0, 0, 0, 5, 3};
+    transport_recv_frame(0, frame, sizeof(frame));
+    test_object1* obj = read_reliable_master_to_slave();
+    EXPECT_NE(obj, nullptr);
+    EXPECT_EQ(obj->test, 9);
+    EXPECT_CALL(*this, router_send_frame(0));
+    update_transport();
+    uint8_t expected[] = {3, 5, 1, 0xFF};
+    EXPECT_THAT(sent_data, ElementsAreArray(expected));
+}
+
+TEST_F(Transport, duplicate_reliable_object_is_acknowledged_but_not_delivered) {
+    uint8_t frame[] = {9, 0, 0, 0, 0, 5, 3};
+    transport_recv_frame(0, frame, sizeof(frame));
+    EXPECT_NE(read_reliable_master_to_slave(), nullptr);
+    transport_recv_frame(0, frame, sizeof(frame));
+    EXPECT_EQ(read_reliable_master_to_slave(), nullptr);
+    EXPECT_CALL(*this, router_send_frame(0));
+    update_transport();
+}
+
+TEST_F(Transport, sequence_numbers_skip_zero_after_the_first_object) {
+    EXPECT_CALL(*this, signal_data_written()).Times(257);
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(257);
+    for (int i = 0; i < 257; i++) {
+        sent_data.clear();
+        begin_write_reliable_master_to_slave()->test = 7;
+        end_write_reliable_master_to_slave();
+        update_transport();
+        EXPECT_EQ(sent_data[5], i < 256 ? i : 1);
+    }
+}
+
+TEST_F(Transport, sequence_number_zero_is_a_restarted_sender) {
+    uint8_t frame[] = {9, 0, 0, 0, 0, 5, 3};
+    transport_recv_frame(0, frame, sizeof(frame));
+    EXPECT_NE(read_reliable_master_to_slave(), nullptr);
+    uint8_t restarted[] = {8, 0, 0, 0, 0, 0, 3};
+    transport_recv_frame(0, restarted, sizeof(restarted));
+    test_object1* obj = read_reliable_master_to_slave();
+    ASSERT_NE(obj, nullptr);
+    EXPECT_EQ(obj->test, 8);
+    // Numbered from the start again
+    transport_recv_frame(0, frame, sizeof(frame));
+    EXPECT_NE(read_reliable_master_to_slave(), nullptr);
+    EXPECT_CALL(*this, router_send_frame(0));
+    update_transport();
+}
+
+TEST_F(Transport, single_slave_objects_need_a_discovered_slave) {
+    EXPECT_EQ(begin_write_master_to_single_slave(0), nullptr);
+    EXPECT_EQ(read_slave_to_master(0), nullptr);
+    discover_slaves(1);
+    EXPECT_EQ(transport_num_slaves(), 1);
+    EXPECT_NE(begin_write_master_to_single_slave(0), nullptr);
+    EXPECT_EQ(begin_write_master_to_single_slave(1), nullptr);
+}
+
+TEST_F(Transport, discovers_the_whole_chain_up_to_a_slave) {
+    discover_slaves(12);
+    EXPECT_EQ(transport_num_slaves(), 12);
+    EXPECT_NE(begin_write_master_to_single_slave(11), nullptr);
+}
+
+TEST_F(Transport, chain_is_limited_by_the_arena) {
+    discover_slaves(SERIAL_LINK_MAX_SLAVES);
+    uint8_t num_slaves = transport_num_slaves();
+    EXPECT_GT(num_slaves, 8);
+    EXPECT_LT(num_slaves, SERIAL_LINK_MAX_SLAVES);
+    EXPECT_EQ(begin_write_master_to_single_slave(num_slaves), nullptr);
+    // An undiscovered slave is ignored
+    test_object1 obj = {3};
+    uint8_t frame[5];
+    memcpy(frame, &obj, 4);
+    frame[4] = 2;
+    transport_recv_frame(num_slaves + 1, frame, sizeof(frame));
+}
+
+TEST_F(Transport, writes_to_the_twentieth_slave) {
+    discover_slaves(20);
+    EXPECT_CALL(*this, signal_data_written());
+    begin_write_master_to_single_slave(19)->test = 9;
+    end_write_master_to_single_slave(19);
+    EXPECT_CALL(*this, router_send_frame(20));
+    update_transport();
+}
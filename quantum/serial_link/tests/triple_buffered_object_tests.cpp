@@ -23,6 +23,8 @@ SOFTWARE.
 */
 
 #include "gtest/gtest.h"
+#include <thread>
+#include <atomic>
 extern "C" {
 #include "serial_link/protocol/triple_buffered_object.h"
 }
@@ -82,3 +84,98 @@ TEST_F(TripleBufferedObject, performs_two_writes_in_the_middle_of_read) {
     EXPECT_EQ(*triple_buffer_read(&test_object), 3);
     EXPECT_EQ(triple_buffer_read(&test_object), nullptr);
 }
+
+TEST_F(TripleBufferedObject, read_last_returns_the_last_read_object) {
+    *triple_buffer_begin_write(&test_object) = 1;
+    triple_buffer_end_write(&test_object);
+    uint32_t* read = triple_buffer_read(&test_object);
+    *triple_buffer_begin_write(&test_object) = 2;
+    triple_buffer_end_write(&test_object);
+    EXPECT_EQ(triple_buffer_read_last_internal(sizeof(uint32_t), (triple_buffer_object_t*)&test_object), read);
+}
+
+// The writer and the reader in their own threads. Each object is filled with
+// the same value, so a torn read shows up as a mix of values
+#define STRESS_WRITES 1000000
+
+struct stress_value {
+    uint32_t values[8];
+};
+
+struct stress_object {
+    uint8_t state;
+    stress_value buffer[3];
+};
+
+static stress_object stress_object;
+
+static void stress_write(uint32_t value) {
+    stress_value* write = triple_buffer_begin_write(&stress_object);
+    for (uint32_t& v : write->values) {
+        v = value;
+    }
+    triple_buffer_end_write(&stress_object);
+}
+
+TEST(TripleBufferedObjectThreads, reader_never_sees_torn_or_old_objects) {
+    triple_buffer_init((triple_buffer_object_t*)&stress_object);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t i = 1; i <= STRESS_WRITES; i++) {
+            stress_write(i);
+        }
+        done = true;
+    });
+
+    uint32_t last = 0;
+    uint32_t num_reads = 0;
+    bool writer_done = false;
+    while (!writer_done) {
+        // The writer is checked before the read, so that the final write is
+        // read after it has finished
+        writer_done = done;
+        stress_value* read = triple_buffer_read(&stress_object);
+        if (!read) {
+            continue;
+        }
+        num_reads++;
+        uint32_t value = read->values[0];
+        for (uint32_t v : read->values) {
+            ASSERT_EQ(v, value);
+        }
+        ASSERT_GT(value, last);
+        last = value;
+    }
+    writer.join();
+    EXPECT_EQ(last, STRESS_WRITES);
+    EXPECT_GT(num_reads, 0);
+}
+
+TEST(TripleBufferedObjectThreads, writer_never_overwrites_the_object_being_read) {
+    triple_buffer_init((triple_buffer_object_t*)&stress_object);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t i = 1; i <= STRESS_WRITES; i++) {
+            stress_write(i);
+        }
+        done = true;
+    });
+
+    // Keeps each object for a while, checking that it doesn't change
+    while (!done) {
+        stress_value* read = triple_buffer_read(&stress_object);
+        if (!read) {
+            continue;
+        }
+        stress_value copy = *read;
+        for (int i = 0; i < 100; i++) {
+            for (int j = 0; j < 8; j++) {
+                ASSERT_EQ(read->values[j], copy.values[j]);
+            }
+        }
+        stress_value* last = (stress_value*)triple_buffer_read_last_internal(
+            sizeof(stress_value), (triple_buffer_object_t*)&stress_object);
+        ASSERT_EQ(last, read);
+    }
+    writer.join();
+}
@@ -0,0 +1,35 @@
+// Physical backend for the split transport on ChibiOS, using the buffered
+// serial driver. The board enables the driver in halconf.h and mcuconf.h.
+
+#include "hal.h"
+#include "split/split_transport.h"
+#include "serial_link/protocol/physical.h"
+
+#ifndef SPLIT_SERIAL_DRIVER
+#define SPLIT_SERIAL_DRIVER SD1
+#endif
+
+#ifndef SPLIT_USART_BAUD
+#define SPLIT_USART_BAUD 500000
+#endif
+
+static SerialConfig config = {
+    .sc_speed = SPLIT_USART_BAUD
+};
+
+void split_phy_init(void) {
+    sdStart(&SPLIT_SERIAL_DRIVER, &config);
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    (void)link;
+    sdWrite(&SPLIT_SERIAL_DRIVER, data, size);
+}
+
+int16_t split_phy_recv(void) {
+    msg_t data = sdGetTimeout(&SPLIT_SERIAL_DRIVER, TIME_IMMEDIATE);
+    if (data < 0) {
+        return -1;
+    }
+    return data;
+}
@@ -0,0 +1,171 @@
+#include "split/split_sync.h"
+#include <string.h>
+
+#if SPLIT_SYNC_MAX_DELTA >= 128
+#error "SPLIT_SYNC_MAX_DELTA must be less than 128"
+#endif
+
+// Sequence numbers wrap around, a is newer if it's less than half the range
+// ahead of b
+static inline bool seq_newer(uint8_t a, uint8_t b) {
+    return (int8_t)(a - b) > 0;
+}
+
+static uint8_t write_row(uint8_t* buffer, matrix_row_t row) {
+    for (uint8_t i = 0; i < sizeof(matrix_row_t); i++) {
+        buffer[i] = row >> (i * 8);
+    }
+    return sizeof(matrix_row_t);
+}
+
+static matrix_row_t read_row(const uint8_t* buffer) {
+    matrix_row_t row = 0;
+    for (uint8_t i = 0; i < sizeof(matrix_row_t); i++) {
+        row |= (matrix_row_t)buffer[i] << (i * 8);
+    }
+    return row;
+}
+
+// Rows that last changed in or before the acknowledged message are moved up
+// to it. Only the rows changed since then are newer, however long the others
+// stay the same and the numbers wrap around.
+static void ack_rows(split_sync_slave_t* slave, uint8_t ack) {
+    uint8_t pending = slave->seq - ack;
+    for (uint8_t i = 0; i < SPLIT_SYNC_ROWS; i++) {
+        if ((uint8_t)(slave->row_seq[i] - ack - 1) >= pending) {
+            slave->row_seq[i] = ack;
+        }
+    }
+}
+
+void split_sync_slave_init(split_sync_slave_t* slave) {
+    memset(slave, 0, sizeof(split_sync_slave_t));
+    slave->reset = true;
+}
+
+uint8_t split_sync_encode_rows(split_sync_slave_t* slave, const matrix_row_t* rows, uint8_t* buffer) {
+    uint8_t seq = ++slave->seq;
+    uint8_t changed = 0;
+    for (uint8_t i = 0; i < SPLIT_SYNC_ROWS; i++) {
+        if (rows[i] != slave->rows[i]) {
+            slave->rows[i] = rows[i];
+            slave->row_seq[i] = seq;
+        }
+        if (seq_newer(slave->row_seq[i], slave->acked)) {
+            changed++;
+        }
+    }
+
+    bool keyframe = !slave->ack_valid ||
+        ++slave->since_keyframe >= SPLIT_SYNC_KEYFRAME_INTERVAL ||
+        (uint8_t)(seq - slave->acked) >= SPLIT_SYNC_MAX_DELTA ||
+        changed * (1 + sizeof(matrix_row_t)) > SPLIT_SYNC_ROWS * sizeof(matrix_row_t);
+
+    buffer[0] = 0;
+    buffer[1] = seq;
+    buffer[2] = slave->acked;
+    uint8_t size = 3;
+    if (keyframe) {
+        buffer[0] = SPLIT_SYNC_KEYFRAME | (slave->reset ? SPLIT_SYNC_RESET : 0);
+        slave->since_keyframe = 0;
+        for (uint8_t i = 0; i < SPLIT_SYNC_ROWS; i++) {
+            size += write_row(buffer + size, slave->rows[i]);
+        }
+    } else {
+        for (uint8_t i = 0; i < SPLIT_SYNC_ROWS; i++) {
+            if (seq_newer(slave->row_seq[i], slave->acked)) {
+                buffer[size++] = i;
+                size += write_row(buffer + size, slave->rows[i]);
+            }
+        }
+    }
+    return size;
+}
+
+bool split_sync_decode_master(split_sync_slave_t* slave, const uint8_t* data, uint8_t size, split_master_state_t* state) {
+    if (size != SPLIT_SYNC_MASTER_SIZE) {
+        return false;
+    }
+    uint8_t ack = data[1];
+    // Only accept acknowledgements of recent messages, anything else is either
+    // too old to base a delta on, or for messages sent before a restart
+    if (!(data[0] & SPLIT_SYNC_SYNCED) ||
+        seq_newer(ack, slave->seq) ||
+        (uint8_t)(slave->seq - ack) >= SPLIT_SYNC_MAX_DELTA) {
+        slave->ack_valid = false;
+    } else if (!slave->ack_valid || seq_newer(ack, slave->acked)) {
+        ack_rows(slave, ack);
+        slave->acked = ack;
+        slave->ack_valid = true;
+        slave->reset = false;
+    }
+    state->layer_state = (uint32_t)data[2] | (uint32_t)data[3] << 8 |
+        (uint32_t)data[4] << 16 | (uint32_t)data[5] << 24;
+    state->leds = data[6];
+    return true;
+}
+
+void split_sync_master_init(split_sync_master_t* master) {
+    memset(master, 0, sizeof(split_sync_master_t));
+}
+
+uint8_t split_sync_encode_master(const split_sync_master_t* master, const split_master_state_t* state, uint8_t* buffer) {
+    buffer[0] = master->synced ? SPLIT_SYNC_SYNCED : 0;
+    buffer[1] = master->seq;
+    buffer[2] = state->layer_state;
+    buffer[3] = state->layer_state >> 8;
+    buffer[4] = state->layer_state >> 16;
+    buffer[5] = state->layer_state >> 24;
+    buffer[6] = state->leds;
+    return SPLIT_SYNC_MASTER_SIZE;
+}
+
+bool split_sync_decode_rows(split_sync_master_t* master, const uint8_t* data, uint8_t size) {
+    if (size < 3) {
+        return false;
+    }
+    uint8_t flags = data[0];
+    uint8_t seq = data[1];
+    uint8_t base = data[2];
+    data += 3;
+    size -= 3;
+
+    if (flags & SPLIT_SYNC_KEYFRAME) {
+        if (size != SPLIT_SYNC_ROWS * sizeof(matrix_row_t)) {
+            return false;
+        }
+        // A keyframe that was overtaken by newer messages is dropped, unless
+        // the slave was restarted and the numbering starts over
+        if (master->synced && !(flags & SPLIT_SYNC_RESET) && !seq_newer(seq, master->seq)) {
+            return false;
+        }
+        for (uint8_t i = 0; i < SPLIT_SYNC_ROWS; i++) {
+            master->rows[i] = read_row(data + i * sizeof(matrix_row_t));
+        }
+        master->seq = seq;
+        master->synced = true;
+        return true;
+    }
+
+    if (!master->synced || !seq_newer(seq, master->seq)) {
+        return false;
+    }
+    if (seq_newer(base, master->seq)) {
+        // The delta is based on a state we don't have
+        master->synced = false;
+        return false;
+    }
+    if (size % (1 + sizeof(matrix_row_t)) != 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < size; i += 1 + sizeof(matrix_row_t)) {
+        if (data[i] >= SPLIT_SYNC_ROWS) {
+            return false;
+        }
+    }
+    for (uint8_t i = 0; i < size; i += 1 + sizeof(matrix_row_t)) {
+        master->rows[data[i]] = read_row(data + i + 1);
+    }
+    master->seq = seq;
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef SPLIT_SYNC_H
+#define SPLIT_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+// Delta encoded exchange of the matrix and the keyboard state between the
+// halves of a split keyboard, on top of a transport like split_transport.
+//
+// The slave numbers every message it sends, and the master acknowledges the
+// last one it applied in its next poll. The slave then only sends the rows
+// that changed after the acknowledged message. Since each message has all
+// changes since the last acknowledged state, a lost message is corrected by
+// the next one, and messages older than the current state are dropped. When
+// the master can't apply a message, it asks for a keyframe with the full
+// state, and keyframes are also sent periodically.
+//
+// The master sends its layer and LED state back in the same poll.
+
+// The number of rows that the slave sends
+#ifndef SPLIT_SYNC_ROWS
+#define SPLIT_SYNC_ROWS (MATRIX_ROWS / 2)
+#endif
+
+// Send a keyframe at least every this many messages
+#ifndef SPLIT_SYNC_KEYFRAME_INTERVAL
+#define SPLIT_SYNC_KEYFRAME_INTERVAL 64
+#endif
+
+// The oldest acknowledgement a delta can be based on, must be less than 128
+#ifndef SPLIT_SYNC_MAX_DELTA
+#define SPLIT_SYNC_MAX_DELTA 32
+#endif
+
+// The size of matrix_row_t, in a form the preprocessor can compare
+#if (MATRIX_COLS <= 8)
+#define SPLIT_SYNC_ROW_BYTES 1
+#elif (MATRIX_COLS <= 16)
+#define SPLIT_SYNC_ROW_BYTES 2
+#else
+#define SPLIT_SYNC_ROW_BYTES 4
+#endif
+
+// The biggest message in each direction, the transport has to fit them
+#define SPLIT_SYNC_ROWS_SIZE (3 + SPLIT_SYNC_ROWS * SPLIT_SYNC_ROW_BYTES)
+#define SPLIT_SYNC_MASTER_SIZE 7
+
+// Flags of the slave messages
+#define SPLIT_SYNC_KEYFRAME (1 << 0)
+// The slave was just started, so the keyframe replaces whatever the master has
+#define SPLIT_SYNC_RESET (1 << 1)
+
+// Flags of the master messages
+#define SPLIT_SYNC_SYNCED (1 << 0)
+
+typedef struct {
+    uint32_t layer_state;
+    uint8_t leds;
+} split_master_state_t;
+
+// The slave side state
+typedef struct {
+    matrix_row_t rows[SPLIT_SYNC_ROWS];
+    // The message in which each row last changed
+    uint8_t row_seq[SPLIT_SYNC_ROWS];
+    uint8_t seq;
+    uint8_t acked;
+    bool ack_valid;
+    bool reset;
+    uint8_t since_keyframe;
+} split_sync_slave_t;
+
+// The master side state
+typedef struct {
+    matrix_row_t rows[SPLIT_SYNC_ROWS];
+    uint8_t seq;
+    bool synced;
+} split_sync_master_t;
+
+void split_sync_slave_init(split_sync_slave_t* slave);
+// Encodes the message for the current rows, returns its size
+uint8_t split_sync_encode_rows(split_sync_slave_t* slave, const matrix_row_t* rows, uint8_t* buffer);
+// Processes a message from the master, returns false if it's invalid
+bool split_sync_decode_master(split_sync_slave_t* slave, const uint8_t* data, uint8_t size, split_master_state_t* state);
+
+void split_sync_master_init(split_sync_master_t* master);
+// Encodes the message with the acknowledgement and the state, returns its size
+uint8_t split_sync_encode_master(const split_sync_master_t* master, const split_master_state_t* state, uint8_t* buffer);
+// Applies a message from the slave to master->rows, returns false if it was
+// dropped
+bool split_sync_decode_rows(split_sync_master_t* master, const uint8_t* data, uint8_t size);
+
+#endif
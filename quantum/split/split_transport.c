@@ -0,0 +1,104 @@
+#include "split/split_transport.h"
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/frame_validator.h"
+#include "serial_link/protocol/frame_router.h"
+#include "timer.h"
+#include <string.h>
+
+#if MAX_FRAME_SIZE < SPLIT_TRANSPORT_MAX_PAYLOAD + 5
+#error "MAX_FRAME_SIZE is too small for SPLIT_TRANSPORT_MAX_PAYLOAD"
+#endif
+
+static bool is_master;
+static bool polling;
+static uint16_t poll_time;
+
+static bool received;
+static uint8_t remote_size;
+static uint8_t remote_data[SPLIT_TRANSPORT_MAX_PAYLOAD];
+
+void split_transport_init(bool master) {
+    is_master = master;
+    polling = false;
+    received = false;
+    remote_size = 0;
+    init_byte_stuffer();
+    split_phy_init();
+}
+
+// Replaces the serial_link frame router, there's only one link and the frame
+// type tells who it's from
+void route_incoming_frame(uint8_t link, uint8_t* data, uint16_t size) {
+    (void)link;
+    uint8_t expected = is_master ? SPLIT_FRAME_SLAVE : SPLIT_FRAME_MASTER;
+    if (size == 0 || size - 1 > SPLIT_TRANSPORT_MAX_PAYLOAD || data[0] != expected) {
+        return;
+    }
+    remote_size = size - 1;
+    memcpy(remote_data, data + 1, remote_size);
+    received = true;
+}
+
+static void send_frame(uint8_t type, const uint8_t* data, uint8_t size) {
+    frame_t frame;
+    // A cut short payload would look valid to the other half
+    if (size > SPLIT_TRANSPORT_MAX_PAYLOAD) {
+        return;
+    }
+    frame_init(&frame, &type, 1);
+    if (size > 0 && !frame_append(&frame, data, size)) {
+        return;
+    }
+    validator_send_segments(SPLIT_LINK, &frame);
+}
+
+static void process_incoming(void) {
+    int16_t data;
+    while ((data = split_phy_recv()) >= 0) {
+        byte_stuffer_recv_byte(SPLIT_LINK, data);
+    }
+}
+
+uint8_t split_transport_master_task(void) {
+    process_incoming();
+    if (received) {
+        received = false;
+        polling = false;
+        return SPLIT_POLL_RECEIVED;
+    }
+    if (!polling) {
+        return SPLIT_POLL_IDLE;
+    }
+    if (timer_elapsed(poll_time) < SPLIT_TRANSPORT_TIMEOUT) {
+        return SPLIT_POLL_PENDING;
+    }
+    polling = false;
+    return SPLIT_POLL_TIMEOUT;
+}
+
+void split_transport_master_poll(const uint8_t* data, uint8_t size) {
+    send_frame(SPLIT_FRAME_MASTER, data, size);
+    polling = true;
+    poll_time = timer_read();
+}
+
+bool split_transport_slave_task(void) {
+    process_incoming();
+    if (!received) {
+        return false;
+    }
+    received = false;
+    return true;
+}
+
+void split_transport_slave_answer(const uint8_t* data, uint8_t size) {
+    send_frame(SPLIT_FRAME_SLAVE, data, size);
+}
+
+uint8_t split_transport_read(uint8_t* data, uint8_t size) {
+    if (size > remote_size) {
+        size = remote_size;
+    }
+    memcpy(data, remote_data, size);
+    return remote_size;
+}
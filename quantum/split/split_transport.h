@@ -0,0 +1,66 @@
+#ifndef SPLIT_TRANSPORT_H
+#define SPLIT_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Transport between the two halves of a split keyboard.
+//
+// The frames are protected by the CRC of serial_link's frame validator and
+// framed by its COBS byte stuffer, so a corrupted or truncated frame is simply
+// dropped. The physical backend sends and receives from interrupt driven
+// buffers, and all the protocol work is done from the main loop, so the
+// transfers never run with the interrupts disabled.
+//
+// The master polls the slave by sending a frame with its own data, and the
+// slave answers with its data as soon as it sees the poll. The master never
+// waits for the answer, it's picked up on a later scan instead.
+
+// The serial_link link number used by the transport
+#define SPLIT_LINK 0
+
+// The largest payload in either direction, longer payloads are not sent
+#ifndef SPLIT_TRANSPORT_MAX_PAYLOAD
+#define SPLIT_TRANSPORT_MAX_PAYLOAD 16
+#endif
+
+// Time in ms the master waits for an answer before polling again
+#ifndef SPLIT_TRANSPORT_TIMEOUT
+#define SPLIT_TRANSPORT_TIMEOUT 5
+#endif
+
+enum split_frame_type {
+    SPLIT_FRAME_MASTER = 1,
+    SPLIT_FRAME_SLAVE,
+};
+
+enum split_poll_status {
+    // No answer yet, but the poll hasn't timed out either
+    SPLIT_POLL_PENDING,
+    // A new answer is available from split_transport_read
+    SPLIT_POLL_RECEIVED,
+    // The slave didn't answer the last poll
+    SPLIT_POLL_TIMEOUT,
+    // No poll was sent since the last answer, or since the start
+    SPLIT_POLL_IDLE,
+};
+
+void split_transport_init(bool master);
+// Master only, call once per scan. Returns the state of the last poll, a new
+// one should be sent with split_transport_master_poll unless it's pending.
+uint8_t split_transport_master_task(void);
+void split_transport_master_poll(const uint8_t* data, uint8_t size);
+// Slave only, call from the main loop. Returns true when a poll was received,
+// which should be answered with split_transport_slave_answer.
+bool split_transport_slave_task(void);
+void split_transport_slave_answer(const uint8_t* data, uint8_t size);
+// Copies the last payload received from the other half, returns its size
+uint8_t split_transport_read(uint8_t* data, uint8_t size);
+
+// Implemented by the physical backend, together with send_data from
+// serial_link/protocol/physical.h
+void split_phy_init(void);
+// Returns the next received byte, or -1 if there's nothing to read
+int16_t split_phy_recv(void);
+
+#endif
@@ -0,0 +1,82 @@
+// Physical backend for the split transport using the USART1 of the
+// ATmega32u4 and similar. Both directions go through ring buffers serviced by
+// the USART interrupts, so nothing here ever disables the interrupts.
+//
+// The halves are connected TX to RX, PD3 to PD2, so the cable needs four
+// wires including VCC and GND.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "split/split_transport.h"
+#include "serial_link/protocol/physical.h"
+
+#ifndef SPLIT_USART_BAUD
+#define SPLIT_USART_BAUD 500000
+#endif
+
+// Double speed mode
+#define SPLIT_USART_UBRR (F_CPU / 8 / SPLIT_USART_BAUD - 1)
+
+// Buffer sizes, must be powers of two
+#define TX_BUFFER_SIZE 64
+#define RX_BUFFER_SIZE 64
+
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+void split_phy_init(void) {
+    tx_head = tx_tail = 0;
+    rx_head = rx_tail = 0;
+    UBRR1 = SPLIT_USART_UBRR;
+    UCSR1A = _BV(U2X1);
+    // 8N1
+    UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);
+    UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    (void)link;
+    while (size--) {
+        uint8_t next = (tx_head + 1) & (TX_BUFFER_SIZE - 1);
+        // The interrupt keeps draining the buffer, so this only waits when a
+        // frame is bigger than the buffer
+        while (next == tx_tail);
+        tx_buffer[tx_head] = *data++;
+        tx_head = next;
+        UCSR1B |= _BV(UDRIE1);
+    }
+}
+
+int16_t split_phy_recv(void) {
+    if (rx_head == rx_tail) {
+        return -1;
+    }
+    uint8_t data = rx_buffer[rx_tail];
+    rx_tail = (rx_tail + 1) & (RX_BUFFER_SIZE - 1);
+    return data;
+}
+
+// USART data register empty interrupt
+ISR(USART1_UDRE_vect) {
+    if (tx_head == tx_tail) {
+        UCSR1B &= ~_BV(UDRIE1);
+    } else {
+        UDR1 = tx_buffer[tx_tail];
+        tx_tail = (tx_tail + 1) & (TX_BUFFER_SIZE - 1);
+    }
+}
+
+// USART RX complete interrupt
+ISR(USART1_RX_vect) {
+    uint8_t data = UDR1;
+    uint8_t next = (rx_head + 1) & (RX_BUFFER_SIZE - 1);
+    if (next != rx_tail) {
+        rx_buffer[rx_head] = data;
+        rx_head = next;
+    }
+}
@@ -0,0 +1,486 @@
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "action.h"
+#include "action_code.h"
+#include "action_layer.h"
+#include "action_tapping.h"
+#include "keycode.h"
+}
+
+// The keys on row 0, by column
+enum {
+    KEY_A,
+    KEY_B,
+    KEY_SHIFT,
+    KEY_CTL_F,
+    KEY_LT_J,
+    KEY_ALT_D,
+    KEY_SFT_S,
+    KEY_GUI_H,
+    KEY_COUNT
+};
+
+static const action_t actions[KEY_COUNT] = {
+    ACTION_KEY(KC_A),
+    ACTION_KEY(KC_B),
+    ACTION_KEY(KC_LSFT),
+    ACTION_MODS_TAP_KEY(MOD_LCTL, KC_F),
+    ACTION_LAYER_TAP_KEY(1, KC_J),
+    ACTION_MODS_TAP_KEY(MOD_LALT, KC_D),
+    ACTION_MODS_TAP_KEY(MOD_LSFT, KC_S),
+    ACTION_MODS_TAP_KEY(MOD_LGUI, KC_H),
+};
+
+static std::vector<keyrecord_t> processed;
+static int cleared;
+static int actions_read;
+
+extern "C" {
+// A short term for shift and a long one for gui, the others keep TAPPING_TERM
+const uint16_t tapping_terms[MATRIX_ROWS][MATRIX_COLS] = {
+    {0, 0, 0, 0, 0, 0, 120, 400},
+};
+
+void process_record(keyrecord_t* record) {
+    processed.push_back(*record);
+}
+
+action_t layer_switch_get_action(keypos_t key) {
+    actions_read++;
+    return actions[key.col];
+}
+
+bool is_tap_key(keypos_t key) {
+    action_t action = actions[key.col];
+    switch (action.kind.id) {
+        case ACT_LMODS_TAP:
+        case ACT_RMODS_TAP:
+        case ACT_LAYER_TAP:
+        case ACT_LAYER_TAP_EXT:
+            return true;
+    }
+    return false;
+}
+
+void clear_keyboard(void) {
+    cleared++;
+}
+
+void debug_event(keyevent_t event) {
+}
+
+void debug_record(keyrecord_t record) {
+}
+}
+
+// What process_record got, for comparing
+struct Record {
+    uint8_t key;
+    bool pressed;
+    uint8_t count;
+    bool interrupted;
+
+    bool operator==(const Record& other) const {
+        return key == other.key && pressed == other.pressed &&
+            count == other.count && interrupted == other.interrupted;
+    }
+};
+
+static std::ostream& operator<<(std::ostream& os, const Record& record) {
+    return os << "{key " << (int)record.key << (record.pressed ? " down" : " up")
+        << " tap " << (int)record.count << (record.interrupted ? " interrupted}" : "}");
+}
+
+static Record down(uint8_t key, uint8_t count = 0, bool interrupted = false) {
+    return Record{key, true, count, interrupted};
+}
+
+static Record up(uint8_t key, uint8_t count = 0, bool interrupted = false) {
+    return Record{key, false, count, interrupted};
+}
+
+// The default TAPPING_TERM of 200ms. Every test releases all of its keys,
+// and the engine is left idle by a tick long after the last event.
+class ActionTapping : public testing::Test {
+public:
+    ActionTapping() {
+        processed.clear();
+        cleared = 0;
+        actions_read = 0;
+    }
+
+    ~ActionTapping() {
+        tick(now + 2 * TAPPING_TERM);
+        tick(now + 2 * TAPPING_TERM);
+    }
+
+    void event(uint8_t key, bool pressed, uint16_t time) {
+        now = time;
+        keyrecord_t record = {};
+        record.event.key = (keypos_t){ .col = key, .row = 0 };
+        record.event.pressed = pressed;
+        record.event.time = time | 1;
+        action_tapping_process(record);
+    }
+
+    void press(uint8_t key, uint16_t time) {
+        event(key, true, time);
+    }
+
+    void release(uint8_t key, uint16_t time) {
+        event(key, false, time);
+    }
+
+    // The pseudo event that keyboard_task sends every scan
+    void tick(uint16_t time) {
+        now = time;
+        keyrecord_t record = {};
+        record.event.key = (keypos_t){ .col = 255, .row = 255 };
+        record.event.time = time | 1;
+        action_tapping_process(record);
+    }
+
+    // Ticks every ms up to the time
+    void wait_until(uint16_t time) {
+        while (now != time) {
+            tick(now + 1);
+        }
+    }
+
+    std::vector<Record> records() {
+        std::vector<Record> result;
+        for (auto& record : processed) {
+            if (record.event.key.row == 255) {
+                continue;
+            }
+            result.push_back(Record{record.event.key.col, record.event.pressed,
+                record.tap.count, record.tap.interrupted});
+        }
+        return result;
+    }
+
+    uint16_t now = 1000;
+};
+
+TEST_F(ActionTapping, other_keys_are_processed_right_away) {
+    press(KEY_A, 1000);
+    release(KEY_A, 1010);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_A), up(KEY_A)}));
+}
+
+TEST_F(ActionTapping, a_tap_key_waits_for_its_release) {
+    press(KEY_CTL_F, 1000);
+    wait_until(1100);
+    EXPECT_TRUE(records().empty());
+    release(KEY_CTL_F, 1100);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_CTL_F, 1), up(KEY_CTL_F, 1)}));
+}
+
+TEST_F(ActionTapping, a_tap_key_is_held_when_the_term_runs_out) {
+    press(KEY_CTL_F, 1000);
+    wait_until(1000 + TAPPING_TERM - 1);
+    EXPECT_TRUE(records().empty());
+    tick(1000 + TAPPING_TERM);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_CTL_F, 0)}));
+    release(KEY_CTL_F, 1500);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_CTL_F, 0), up(KEY_CTL_F, 0)}));
+}
+
+TEST_F(ActionTapping, a_release_after_the_term_is_a_hold) {
+    press(KEY_LT_J, 1000);
+    release(KEY_LT_J, 1000 + TAPPING_TERM);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_LT_J, 0), up(KEY_LT_J, 0)}));
+}
+
+TEST_F(ActionTapping, keys_typed_while_undecided_wait_and_interrupt) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_A, 1050);
+    release(KEY_A, 1080);
+    EXPECT_TRUE(records().empty());
+    release(KEY_CTL_F, 1100);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1, true), down(KEY_A), up(KEY_A), up(KEY_CTL_F, 1, true)}));
+}
+
+TEST_F(ActionTapping, a_roll_out_of_a_tap_key_is_a_tap) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_A, 1050);
+    release(KEY_CTL_F, 1080);
+    release(KEY_A, 1100);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1, true), down(KEY_A), up(KEY_CTL_F, 1, true), up(KEY_A)}));
+}
+
+TEST_F(ActionTapping, keys_typed_while_undecided_follow_a_hold) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_A, 1050);
+    wait_until(1000 + TAPPING_TERM);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_CTL_F, 0, true), down(KEY_A)}));
+    release(KEY_A, 1300);
+    release(KEY_CTL_F, 1310);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 0, true), down(KEY_A), up(KEY_A), up(KEY_CTL_F, 0)}));
+}
+
+TEST_F(ActionTapping, taps_within_the_term_count_up) {
+    press(KEY_CTL_F, 1000);
+    release(KEY_CTL_F, 1050);
+    press(KEY_CTL_F, 1100);
+    release(KEY_CTL_F, 1150);
+    press(KEY_CTL_F, 1200);
+    release(KEY_CTL_F, 1250);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1),
+        down(KEY_CTL_F, 2), up(KEY_CTL_F, 2),
+        down(KEY_CTL_F, 3), up(KEY_CTL_F, 3)}));
+}
+
+TEST_F(ActionTapping, a_second_tap_held_keeps_its_count) {
+    press(KEY_CTL_F, 1000);
+    release(KEY_CTL_F, 1050);
+    press(KEY_CTL_F, 1100);
+    wait_until(1600);
+    release(KEY_CTL_F, 1600);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1), down(KEY_CTL_F, 2), up(KEY_CTL_F, 2)}));
+}
+
+TEST_F(ActionTapping, the_tap_count_stops_at_15) {
+    uint16_t time = 1000;
+    for (int i = 0; i < 20; i++) {
+        press(KEY_CTL_F, time);
+        release(KEY_CTL_F, time + 10);
+        time += 20;
+    }
+    EXPECT_EQ(records().back(), up(KEY_CTL_F, 15));
+}
+
+TEST_F(ActionTapping, a_tap_after_the_term_starts_over) {
+    press(KEY_CTL_F, 1000);
+    release(KEY_CTL_F, 1050);
+    wait_until(1050 + TAPPING_TERM + 50);
+    press(KEY_CTL_F, 1300);
+    release(KEY_CTL_F, 1350);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1), down(KEY_CTL_F, 1), up(KEY_CTL_F, 1)}));
+}
+
+TEST_F(ActionTapping, a_key_pressed_after_a_tap_stops_the_count) {
+    press(KEY_CTL_F, 1000);
+    release(KEY_CTL_F, 1050);
+    press(KEY_A, 1060);
+    release(KEY_A, 1070);
+    press(KEY_CTL_F, 1100);
+    release(KEY_CTL_F, 1150);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1), down(KEY_A), up(KEY_A),
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1)}));
+}
+
+TEST_F(ActionTapping, another_tap_key_after_a_tap_starts_its_own) {
+    press(KEY_CTL_F, 1000);
+    release(KEY_CTL_F, 1050);
+    press(KEY_LT_J, 1100);
+    release(KEY_LT_J, 1150);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1), up(KEY_CTL_F, 1), down(KEY_LT_J, 1), up(KEY_LT_J, 1)}));
+}
+
+TEST_F(ActionTapping, nested_tap_keys_both_tap) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_LT_J, 1010);
+    release(KEY_LT_J, 1050);
+    release(KEY_CTL_F, 1100);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 1, true), down(KEY_LT_J, 1), up(KEY_LT_J, 1), up(KEY_CTL_F, 1, true)}));
+}
+
+TEST_F(ActionTapping, nested_tap_keys_held_resolve_in_order) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_ALT_D, 1010);
+    press(KEY_A, 1020);
+    wait_until(1000 + TAPPING_TERM);
+    // The first one is held, the second one is still undecided
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_CTL_F, 0, true)}));
+    wait_until(1010 + TAPPING_TERM);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 0, true), down(KEY_ALT_D, 0, true), down(KEY_A)}));
+    release(KEY_A, 1300);
+    release(KEY_ALT_D, 1310);
+    release(KEY_CTL_F, 1320);
+    EXPECT_EQ(records().size(), 6);
+}
+
+TEST_F(ActionTapping, a_held_tap_key_and_a_tap_under_it) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_LT_J, 1010);
+    wait_until(1000 + TAPPING_TERM);
+    release(KEY_LT_J, 1250);
+    release(KEY_CTL_F, 1400);
+    // The second one is decided from its own press, and is held too
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 0, true), down(KEY_LT_J, 0), up(KEY_LT_J, 0), up(KEY_CTL_F, 0)}));
+}
+
+TEST_F(ActionTapping, a_key_down_before_the_tap_key_is_released_right_away) {
+    press(KEY_A, 990);
+    press(KEY_CTL_F, 1000);
+    release(KEY_A, 1010);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_A), up(KEY_A)}));
+    release(KEY_CTL_F, 1050);
+}
+
+TEST_F(ActionTapping, a_modifier_down_before_the_tap_key_is_kept) {
+    press(KEY_SHIFT, 990);
+    press(KEY_CTL_F, 1000);
+    release(KEY_SHIFT, 1010);
+    // Shift stays down, so that the tap is shifted
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_SHIFT)}));
+    release(KEY_CTL_F, 1050);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_SHIFT), down(KEY_CTL_F, 1), up(KEY_SHIFT), up(KEY_CTL_F, 1)}));
+}
+
+TEST_F(ActionTapping, events_are_kept_in_order_during_fast_typing) {
+    press(KEY_LT_J, 1000);
+    uint16_t time = 1001;
+    std::vector<Record> expected = {down(KEY_LT_J, 1, true)};
+    for (int i = 0; i < 3; i++) {
+        press(KEY_A, time++);
+        release(KEY_A, time++);
+        press(KEY_B, time++);
+        release(KEY_B, time++);
+        expected.insert(expected.end(), {down(KEY_A), up(KEY_A), down(KEY_B), up(KEY_B)});
+    }
+    release(KEY_LT_J, time);
+    expected.push_back(up(KEY_LT_J, 1, true));
+    EXPECT_EQ(records(), expected);
+    EXPECT_EQ(cleared, 0);
+}
+
+TEST_F(ActionTapping, a_full_log_decides_the_tap_key_as_held) {
+    press(KEY_LT_J, 1000);
+    uint16_t time = 1001;
+    std::vector<Record> expected = {down(KEY_LT_J, 0, true)};
+    for (int i = 0; i < 10; i++) {
+        press(KEY_A, time++);
+        release(KEY_A, time++);
+        expected.insert(expected.end(), {down(KEY_A), up(KEY_A)});
+    }
+    // Decided when the 17th event came, and the rest is processed right away
+    EXPECT_EQ(records(), expected);
+    release(KEY_LT_J, time);
+    expected.push_back(up(KEY_LT_J, 0));
+    EXPECT_EQ(records(), expected);
+    EXPECT_EQ(cleared, 0);
+}
+
+TEST_F(ActionTapping, a_full_log_settles_nested_tap_keys_in_order) {
+    press(KEY_CTL_F, 1000);
+    press(KEY_ALT_D, 1001);
+    uint16_t time = 1002;
+    std::vector<Record> expected = {down(KEY_CTL_F, 0, true), down(KEY_ALT_D, 0, true)};
+    for (int i = 0; i < 16; i++) {
+        press(KEY_A, time++);
+        release(KEY_A, time++);
+        expected.insert(expected.end(), {down(KEY_A), up(KEY_A)});
+    }
+    release(KEY_ALT_D, time++);
+    release(KEY_CTL_F, time++);
+    expected.insert(expected.end(), {up(KEY_ALT_D, 0), up(KEY_CTL_F, 0)});
+    EXPECT_EQ(records(), expected);
+}
+
+TEST_F(ActionTapping, a_waiting_event_is_not_tried_again_on_every_tick) {
+    press(KEY_SHIFT, 990);
+    press(KEY_CTL_F, 1000);
+    release(KEY_SHIFT, 1010);
+    int read = actions_read;
+    wait_until(1000 + TAPPING_TERM - 1);
+    EXPECT_EQ(actions_read, read);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_SHIFT)}));
+    // Until the tap key is decided
+    tick(1000 + TAPPING_TERM);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_SHIFT), down(KEY_CTL_F, 0), up(KEY_SHIFT)}));
+    release(KEY_CTL_F, 1300);
+}
+
+TEST_F(ActionTapping, an_event_that_decides_the_tap_key_is_tried_again) {
+    press(KEY_CTL_F, 0);
+    press(KEY_ALT_D, 10);
+    // Both terms are over, with no tick since
+    press(KEY_A, 230);
+    wait_until(240);
+    release(KEY_A, 400);
+    press(KEY_B, 500);
+    release(KEY_B, 510);
+    release(KEY_ALT_D, 600);
+    release(KEY_CTL_F, 610);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_CTL_F, 0, true), down(KEY_ALT_D, 0), down(KEY_A),
+        up(KEY_A), down(KEY_B), up(KEY_B), up(KEY_ALT_D), up(KEY_CTL_F)}));
+}
+
+TEST_F(ActionTapping, a_short_term_is_held_sooner) {
+    press(KEY_SFT_S, 1000);
+    wait_until(1119);
+    EXPECT_TRUE(records().empty());
+    tick(1120);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_SFT_S, 0)}));
+    release(KEY_SFT_S, 1200);
+}
+
+TEST_F(ActionTapping, a_long_term_is_still_a_tap_later) {
+    press(KEY_GUI_H, 1000);
+    wait_until(1350);
+    release(KEY_GUI_H, 1350);
+    EXPECT_EQ(records(), (std::vector<Record>{down(KEY_GUI_H, 1), up(KEY_GUI_H, 1)}));
+}
+
+TEST_F(ActionTapping, sequential_taps_count_with_their_own_term) {
+    press(KEY_GUI_H, 1000);
+    release(KEY_GUI_H, 1300);
+    wait_until(1650);
+    press(KEY_GUI_H, 1650);
+    release(KEY_GUI_H, 1700);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_GUI_H, 1), up(KEY_GUI_H, 1), down(KEY_GUI_H, 2), up(KEY_GUI_H, 2)}));
+}
+
+TEST_F(ActionTapping, a_roll_from_a_short_term_into_a_long_one) {
+    press(KEY_SFT_S, 1000);
+    press(KEY_GUI_H, 1050);
+    release(KEY_SFT_S, 1100);
+    // The gui key would be held by now with TAPPING_TERM
+    wait_until(1399);
+    release(KEY_GUI_H, 1400);
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_SFT_S, 1, true), up(KEY_SFT_S, 1, true),
+        down(KEY_GUI_H, 1), up(KEY_GUI_H, 1)}));
+}
+
+TEST_F(ActionTapping, a_roll_from_a_long_term_into_a_short_one) {
+    press(KEY_GUI_H, 1000);
+    press(KEY_SFT_S, 1010);
+    wait_until(1300);
+    release(KEY_GUI_H, 1300);
+    // The shift key was down longer than its term when the gui key was
+    // decided, so it's held, and the gui release isn't kept waiting
+    EXPECT_EQ(records(), (std::vector<Record>{
+        down(KEY_GUI_H, 1, true), down(KEY_SFT_S, 0), up(KEY_GUI_H, 1, true)}));
+    release(KEY_SFT_S, 1320);
+    EXPECT_EQ(records().back(), up(KEY_SFT_S, 0));
+}
+
+TEST_F(ActionTapping, keys_without_a_term_of_their_own_keep_the_default) {
+    press(KEY_SFT_S, 1000);
+    release(KEY_SFT_S, 1050);
+    press(KEY_CTL_F, 1100);
+    wait_until(1100 + TAPPING_TERM - 1);
+    EXPECT_EQ(records().size(), 2);
+    tick(1100 + TAPPING_TERM);
+    EXPECT_EQ(records().back(), down(KEY_CTL_F, 0));
+    release(KEY_CTL_F, 1400);
+}
@@ -0,0 +1,11 @@
+#ifndef EXPANDER_MATRIX_TEST_CONFIG_H
+#define EXPANDER_MATRIX_TEST_CONFIG_H
+
+// Rows and columns on scattered pins, to test the mapping
+#define MATRIX_ROWS 6
+#define MATRIX_COLS 5
+#define EXPANDER_ROWS 3
+#define EXPANDER_ROW_PINS { 0, 2, 5 }
+#define EXPANDER_COL_PINS { 7, 6, 0, 1, 2 }
+
+#endif
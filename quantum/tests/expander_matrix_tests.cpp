@@ -0,0 +1,295 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <functional>
+extern "C" {
+#include "expander_matrix.h"
+#include "twi_queue.h"
+}
+
+using testing::ElementsAreArray;
+
+#define IODIRA   0x00
+#define IODIRB   0x01
+#define GPINTENB 0x05
+#define IOCON    0x0A
+#define GPPUB    0x0D
+#define INTFB    0x0F
+#define GPIOA    0x12
+#define GPIOB    0x13
+
+static const uint8_t row_pins[] = EXPANDER_ROW_PINS;
+static const uint8_t col_pins[] = EXPANDER_COL_PINS;
+
+// A model of an MCP23018 with the keys wired between its ports, behind a
+// TWI queue that runs each transaction as soon as it's submitted
+class ExpanderMatrix : public testing::Test {
+public:
+    ExpanderMatrix() {
+        Instance = this;
+        memset(registers, 0, sizeof(registers));
+        // The power on state
+        registers[IODIRA] = 0xFF;
+        registers[IODIRB] = 0xFF;
+        memset(pressed, 0, sizeof(pressed));
+    }
+
+    ~ExpanderMatrix() {
+        Instance = nullptr;
+    }
+
+    void press(uint8_t row, uint8_t col) {
+        pressed[row_pins[row]] |= 1 << col_pins[col];
+        update_interrupt();
+    }
+
+    void release(uint8_t row, uint8_t col) {
+        pressed[row_pins[row]] &= ~(1 << col_pins[col]);
+        update_interrupt();
+    }
+
+    // Port B has pull-ups, and the keys of the rows that are driven low pull
+    // it down
+    uint8_t port_b() {
+        uint8_t low = 0;
+        for (int pin = 0; pin < 8; pin++) {
+            bool output = !(registers[IODIRA] & (1 << pin));
+            if (output && !(registers[GPIOA] & (1 << pin))) {
+                low |= pressed[pin];
+            }
+        }
+        return ~low;
+    }
+
+    // The interrupt compares each pin with its previous value, and the flags
+    // stay until GPIOB is read
+    void update_interrupt() {
+        uint8_t value = port_b();
+        uint8_t changed = (value ^ previous_b) & registers[GPINTENB];
+        if (!interrupt_flags) {
+            interrupt_flags = changed;
+        }
+        previous_b = value;
+    }
+
+    void write(uint8_t value) {
+        registers[pointer] = value;
+        pointer = (pointer + 1) % sizeof(registers);
+        update_interrupt();
+    }
+
+    uint8_t read() {
+        uint8_t value = registers[pointer];
+        if (pointer == GPIOB) {
+            value = port_b();
+            interrupt_flags = 0;
+        } else if (pointer == INTFB) {
+            value = interrupt_flags;
+        }
+        pointer = (pointer + 1) % sizeof(registers);
+        return value;
+    }
+
+    void run(twi_transaction_t* transaction) {
+        if (before_transaction) {
+            before_transaction(transactions);
+        }
+        transactions++;
+        if (!present || transaction->address != EXPANDER_ADDRESS) {
+            transaction->status = TWI_ERROR;
+            return;
+        }
+        if (transaction->write_length > 0) {
+            pointer = transaction->write_data[0];
+            for (int i = 1; i < transaction->write_length; i++) {
+                write(transaction->write_data[i]);
+            }
+        }
+        for (int i = 0; i < transaction->read_length; i++) {
+            transaction->read_data[i] = read();
+        }
+        transaction->status = TWI_DONE;
+    }
+
+    std::vector<matrix_row_t> scan() {
+        matrix_row_t rows[EXPANDER_ROWS];
+        memset(rows, 0xAA, sizeof(rows));
+        expander_matrix_start();
+        EXPECT_EQ(expander_matrix_finish(rows), present);
+        return std::vector<matrix_row_t>(rows, rows + EXPANDER_ROWS);
+    }
+
+    uint8_t registers[0x16];
+    uint8_t pressed[8];
+    uint8_t pointer = 0;
+    uint8_t previous_b = 0xFF;
+    uint8_t interrupt_flags = 0;
+    bool present = true;
+    bool busy = false;
+    int transactions = 0;
+    std::function<void(int)> before_transaction;
+
+    static ExpanderMatrix* Instance;
+};
+
+ExpanderMatrix* ExpanderMatrix::Instance = nullptr;
+
+extern "C" {
+bool twi_queue_submit(twi_transaction_t* transaction) {
+    ExpanderMatrix::Instance->run(transaction);
+    return true;
+}
+
+bool twi_queue_wait(twi_transaction_t* transaction) {
+    return transaction->status == TWI_DONE;
+}
+
+bool twi_queue_busy(void) {
+    return ExpanderMatrix::Instance->busy;
+}
+}
+
+TEST_F(ExpanderMatrix, init_configures_the_ports) {
+    EXPECT_TRUE(expander_matrix_init());
+    EXPECT_EQ(registers[IOCON], 0);
+    // The rows are outputs, and not selected
+    EXPECT_EQ(registers[IODIRA], (uint8_t)~(1 << 0 | 1 << 2 | 1 << 5));
+    EXPECT_EQ(registers[GPIOA], 0xFF);
+    EXPECT_EQ(registers[IODIRB], 0xFF);
+    EXPECT_EQ(registers[GPPUB], 0xFF);
+    EXPECT_EQ(registers[GPINTENB], 1 << 7 | 1 << 6 | 1 << 0 | 1 << 1 | 1 << 2);
+}
+
+TEST_F(ExpanderMatrix, init_fails_without_the_expander) {
+    present = false;
+    EXPECT_FALSE(expander_matrix_init());
+}
+
+TEST_F(ExpanderMatrix, init_fails_when_the_queue_is_busy) {
+    busy = true;
+    EXPECT_FALSE(expander_matrix_init());
+    EXPECT_EQ(transactions, 0);
+}
+
+TEST_F(ExpanderMatrix, first_scan_reads_every_row) {
+    expander_matrix_init();
+    transactions = 0;
+    matrix_row_t expected[EXPANDER_ROWS] = {};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    EXPECT_EQ(transactions, EXPANDER_ROWS + 1);
+}
+
+TEST_F(ExpanderMatrix, pressed_keys_are_mapped_to_the_columns) {
+    expander_matrix_init();
+    press(0, 0);
+    press(1, 4);
+    press(2, 2);
+    press(2, 3);
+    matrix_row_t expected[EXPANDER_ROWS] = {1 << 0, 1 << 4, 1 << 2 | 1 << 3};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    // All rows stay selected after the scan
+    EXPECT_EQ(registers[GPIOA], (uint8_t)~(1 << 0 | 1 << 2 | 1 << 5));
+}
+
+TEST_F(ExpanderMatrix, idle_scan_only_reads_the_interrupt_flags) {
+    expander_matrix_init();
+    scan();
+    transactions = 0;
+    matrix_row_t expected[EXPANDER_ROWS] = {};
+    for (int i = 0; i < 10; i++) {
+        EXPECT_THAT(scan(), ElementsAreArray(expected));
+    }
+    EXPECT_EQ(transactions, 10);
+}
+
+TEST_F(ExpanderMatrix, press_when_idle_is_scanned_right_away) {
+    expander_matrix_init();
+    scan();
+    scan();
+    press(1, 2);
+    transactions = 0;
+    matrix_row_t expected[EXPANDER_ROWS] = {0, 1 << 2, 0};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    EXPECT_EQ(transactions, 1 + EXPANDER_ROWS + 1);
+}
+
+TEST_F(ExpanderMatrix, press_and_release_between_scans_is_noticed) {
+    expander_matrix_init();
+    scan();
+    press(1, 2);
+    release(1, 2);
+    transactions = 0;
+    scan();
+    EXPECT_EQ(transactions, 1 + EXPANDER_ROWS + 1);
+}
+
+TEST_F(ExpanderMatrix, held_keys_read_every_row) {
+    expander_matrix_init();
+    press(0, 1);
+    scan();
+    // Another key in the same column doesn't change anything with all rows
+    // selected, so it's only seen by reading the rows
+    press(2, 1);
+    transactions = 0;
+    matrix_row_t expected[EXPANDER_ROWS] = {1 << 1, 0, 1 << 1};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    EXPECT_EQ(transactions, EXPANDER_ROWS + 1);
+}
+
+TEST_F(ExpanderMatrix, release_of_all_keys_goes_back_to_idle) {
+    expander_matrix_init();
+    press(0, 1);
+    scan();
+    release(0, 1);
+    matrix_row_t expected[EXPANDER_ROWS] = {};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    transactions = 0;
+    scan();
+    EXPECT_EQ(transactions, 1);
+}
+
+TEST_F(ExpanderMatrix, press_during_the_scan_is_not_missed) {
+    expander_matrix_init();
+    // Pressed after its row was read, but before the final read with all
+    // rows selected
+    before_transaction = [this](int index) {
+        if (index == EXPANDER_ROWS) {
+            press(0, 3);
+        }
+    };
+    transactions = 0;
+    matrix_row_t empty[EXPANDER_ROWS] = {};
+    EXPECT_THAT(scan(), ElementsAreArray(empty));
+    before_transaction = nullptr;
+    matrix_row_t expected[EXPANDER_ROWS] = {1 << 3, 0, 0};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+}
+
+TEST_F(ExpanderMatrix, busy_queue_keeps_the_last_rows) {
+    expander_matrix_init();
+    press(1, 0);
+    scan();
+    busy = true;
+    transactions = 0;
+    matrix_row_t expected[EXPANDER_ROWS] = {0, 1 << 0, 0};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+    EXPECT_EQ(transactions, 0);
+}
+
+TEST_F(ExpanderMatrix, disconnected_expander_has_empty_rows_until_init) {
+    expander_matrix_init();
+    press(1, 0);
+    scan();
+    present = false;
+    matrix_row_t empty[EXPANDER_ROWS] = {};
+    EXPECT_THAT(scan(), ElementsAreArray(empty));
+    // Nothing is sent until it's initialized again
+    transactions = 0;
+    EXPECT_THAT(scan(), ElementsAreArray(empty));
+    EXPECT_EQ(transactions, 0);
+
+    present = true;
+    EXPECT_TRUE(expander_matrix_init());
+    matrix_row_t expected[EXPANDER_ROWS] = {0, 1 << 0, 0};
+    EXPECT_THAT(scan(), ElementsAreArray(expected));
+}
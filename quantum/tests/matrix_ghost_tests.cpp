@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <vector>
+extern "C" {
+#include "matrix.h"
+}
+
+static matrix_row_t rows[MATRIX_ROWS];
+
+extern "C" matrix_row_t matrix_get_row(uint8_t row) {
+    return rows[row];
+}
+
+class MatrixGhost : public testing::Test {
+public:
+    MatrixGhost() {
+        memset(rows, 0, sizeof(rows));
+    }
+
+    void press(uint8_t row, uint8_t col) {
+        rows[row] |= (matrix_row_t)1 << col;
+    }
+
+    std::vector<bool> ghosts() {
+        matrix_ghost_update();
+        std::vector<bool> result;
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            result.push_back(matrix_has_ghost_in_row(row));
+        }
+        return result;
+    }
+
+    // The check keyboard.c used to do, comparing the row with all others
+    bool reference(uint8_t row) {
+        matrix_row_t matrix_row = rows[row];
+        if (((matrix_row - 1) & matrix_row) == 0)
+            return false;
+        for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+            if (i != row && (rows[i] & matrix_row))
+                return true;
+        }
+        return false;
+    }
+};
+
+TEST_F(MatrixGhost, nothing_pressed_has_no_ghost) {
+    EXPECT_EQ(ghosts(), std::vector<bool>(MATRIX_ROWS, false));
+}
+
+TEST_F(MatrixGhost, keys_on_separate_rows_and_cols_have_no_ghost) {
+    press(0, 0);
+    press(1, 1);
+    press(2, 2);
+    press(3, 3);
+    EXPECT_EQ(ghosts(), std::vector<bool>(MATRIX_ROWS, false));
+}
+
+TEST_F(MatrixGhost, many_keys_on_one_row_have_no_ghost) {
+    rows[2] = 0xFF;
+    EXPECT_EQ(ghosts(), std::vector<bool>(MATRIX_ROWS, false));
+}
+
+TEST_F(MatrixGhost, many_keys_in_one_col_have_no_ghost) {
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        press(row, 4);
+    }
+    EXPECT_EQ(ghosts(), std::vector<bool>(MATRIX_ROWS, false));
+}
+
+TEST_F(MatrixGhost, three_corners_of_a_rectangle_ghost_the_fourth) {
+    // (1, 2), (1, 5) and (3, 2) down also connect (3, 5), so row 1 can't be
+    // trusted, and row 3 is the one that shows the phantom key
+    press(1, 2);
+    press(1, 5);
+    press(3, 2);
+    press(3, 5);
+    std::vector<bool> expected(MATRIX_ROWS, false);
+    expected[1] = true;
+    expected[3] = true;
+    EXPECT_EQ(ghosts(), expected);
+}
+
+TEST_F(MatrixGhost, row_with_two_keys_sharing_a_col_is_ghosted) {
+    press(1, 2);
+    press(1, 5);
+    press(4, 5);
+    std::vector<bool> expected(MATRIX_ROWS, false);
+    expected[1] = true;
+    EXPECT_EQ(ghosts(), expected);
+}
+
+TEST_F(MatrixGhost, ghost_goes_away_after_release) {
+    press(1, 2);
+    press(1, 5);
+    press(4, 5);
+    ghosts();
+    rows[4] = 0;
+    EXPECT_EQ(ghosts(), std::vector<bool>(MATRIX_ROWS, false));
+}
+
+TEST_F(MatrixGhost, random_matrices_match_the_reference) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> row_dist(0, MATRIX_ROWS - 1);
+    std::uniform_int_distribution<int> col_dist(0, MATRIX_COLS - 1);
+    std::uniform_int_distribution<int> keys_dist(0, 6);
+    for (int i = 0; i < 10000; i++) {
+        memset(rows, 0, sizeof(rows));
+        int keys = keys_dist(rng);
+        for (int key = 0; key < keys; key++) {
+            press(row_dist(rng), col_dist(rng));
+        }
+        std::vector<bool> result = ghosts();
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            ASSERT_EQ(result[row], reference(row));
+        }
+    }
+}
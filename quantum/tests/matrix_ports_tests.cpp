@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include <random>
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+#include "matrix_ports.h"
+}
+
+static uint8_t port_values[16];
+
+extern "C" uint8_t matrix_ports_test_read(uint8_t address) {
+    return port_values[address];
+}
+
+class MatrixPorts : public testing::Test {
+public:
+    MatrixPorts() {
+        memset(port_values, 0xFF, sizeof(port_values));
+    }
+
+    // Reads every pin separately, like the matrix used to
+    matrix_row_t reference(const uint8_t* pins) {
+        matrix_row_t row = 0;
+        for (int col = 0; col < MATRIX_COLS; col++) {
+            uint8_t pin = pins[col];
+            if (!(port_values[pin >> 4] & (1 << (pin & 0xF)))) {
+                row |= (matrix_row_t)1 << col;
+            }
+        }
+        return row;
+    }
+
+    // A random layout with each pin used once, on a few ports
+    std::vector<uint8_t> random_pins(std::mt19937& rng, int num_ports) {
+        std::vector<uint8_t> all;
+        std::vector<uint8_t> addresses = {0x0, 0x3, 0x6, 0x9, 0xC, 0xF};
+        std::shuffle(addresses.begin(), addresses.end(), rng);
+        for (int port = 0; port < num_ports; port++) {
+            for (int bit = 0; bit < 8; bit++) {
+                all.push_back(addresses[port] << 4 | bit);
+            }
+        }
+        std::shuffle(all.begin(), all.end(), rng);
+        all.resize(MATRIX_COLS);
+        return all;
+    }
+
+    void press(uint8_t pin) {
+        port_values[pin >> 4] &= ~(1 << (pin & 0xF));
+    }
+
+    matrix_ports_t ports;
+};
+
+TEST_F(MatrixPorts, columns_are_grouped_by_port) {
+    // Like a 15 column board on B, D and F
+    const uint8_t pins[MATRIX_COLS] = {
+        0xF0, 0xF1, 0xF4, 0xF5, 0xF6, 0xF7, 0x36, 0x32,
+        0x33, 0x31, 0x37, 0x90, 0x91, 0x92, 0x93,
+    };
+    matrix_ports_init(&ports, pins);
+    ASSERT_EQ(ports.num_ports, 3);
+    EXPECT_EQ(ports.ports[0].address, 0xF);
+    EXPECT_EQ(ports.ports[0].mask, 0xF3);
+    EXPECT_EQ(ports.ports[0].count, 6);
+    EXPECT_EQ(ports.ports[1].address, 0x3);
+    EXPECT_EQ(ports.ports[1].mask, 0xCE);
+    EXPECT_EQ(ports.ports[1].count, 5);
+    EXPECT_EQ(ports.ports[2].address, 0x9);
+    EXPECT_EQ(ports.ports[2].mask, 0x0F);
+    EXPECT_EQ(ports.ports[2].count, 4);
+}
+
+TEST_F(MatrixPorts, nothing_pressed_reads_nothing) {
+    const uint8_t pins[MATRIX_COLS] = {
+        0xF0, 0xF1, 0xF4, 0xF5, 0xF6, 0xF7, 0x36, 0x32,
+        0x33, 0x31, 0x37, 0x90, 0x91, 0x92, 0x93,
+    };
+    matrix_ports_init(&ports, pins);
+    // Pins that aren't columns don't matter
+    press(0xF2);
+    press(0x30);
+    EXPECT_EQ(matrix_ports_read_cols(&ports), 0);
+}
+
+TEST_F(MatrixPorts, pressed_columns_are_read) {
+    const uint8_t pins[MATRIX_COLS] = {
+        0xF0, 0xF1, 0xF4, 0xF5, 0xF6, 0xF7, 0x36, 0x32,
+        0x33, 0x31, 0x37, 0x90, 0x91, 0x92, 0x93,
+    };
+    matrix_ports_init(&ports, pins);
+    press(0xF4);
+    press(0x31);
+    press(0x93);
+    EXPECT_EQ(matrix_ports_read_cols(&ports), 1 << 2 | 1 << 9 | 1 << 14);
+}
+
+TEST_F(MatrixPorts, every_column_on_its_own_port) {
+    std::vector<uint8_t> pins;
+    for (int col = 0; col < MATRIX_COLS; col++) {
+        pins.push_back(col << 4 | (col & 7));
+    }
+    matrix_ports_init(&ports, pins.data());
+    EXPECT_EQ(ports.num_ports, MATRIX_COLS);
+    for (int col = 0; col < MATRIX_COLS; col++) {
+        press(pins[col]);
+        EXPECT_EQ(matrix_ports_read_cols(&ports), reference(pins.data()));
+    }
+}
+
+TEST_F(MatrixPorts, random_layouts_match_the_reference) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> num_ports(2, 6);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int layout = 0; layout < 200; layout++) {
+        std::vector<uint8_t> pins = random_pins(rng, num_ports(rng));
+        matrix_ports_init(&ports, pins.data());
+        for (int i = 0; i < 50; i++) {
+            for (auto& value : port_values) {
+                value = byte(rng);
+            }
+            ASSERT_EQ(matrix_ports_read_cols(&ports), reference(pins.data()));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#include "gtest/gtest.h"
+extern "C" {
+#include "matrix_settle.h"
+}
+
+TEST(MatrixSettle, a_fast_line_gets_the_floor) {
+    EXPECT_EQ(matrix_settle_us(0), MATRIX_SETTLE_MIN_US);
+    EXPECT_EQ(matrix_settle_us(1), MATRIX_SETTLE_MIN_US);
+}
+
+TEST(MatrixSettle, the_slowest_line_is_doubled_with_a_margin) {
+    EXPECT_EQ(matrix_settle_us(5), 5 * 2 + MATRIX_SETTLE_MARGIN_US);
+    EXPECT_EQ(matrix_settle_us(10), 10 * 2 + MATRIX_SETTLE_MARGIN_US);
+}
+
+TEST(MatrixSettle, never_more_than_the_fixed_settle_time) {
+    EXPECT_EQ(matrix_settle_us(13), MATRIX_SETTLE_US);
+    // A line that didn't rise before the calibration gave up
+    EXPECT_EQ(matrix_settle_us(MATRIX_SETTLE_US), MATRIX_SETTLE_US);
+    EXPECT_EQ(matrix_settle_us(255), MATRIX_SETTLE_US);
+}
+
+TEST(MatrixSettle, grows_with_the_measured_time) {
+    for (int slowest = 1; slowest < 256; slowest++) {
+        EXPECT_GE(matrix_settle_us(slowest), matrix_settle_us(slowest - 1))
+            << "slowest " << slowest;
+        EXPECT_GE(matrix_settle_us(slowest), MATRIX_SETTLE_MIN_US);
+        EXPECT_LE(matrix_settle_us(slowest), MATRIX_SETTLE_US);
+    }
+}
+
+TEST(MatrixSettle, timer_counts_wrap_at_the_top) {
+    EXPECT_EQ(matrix_settle_ticks(10, 10, 249), 0);
+    EXPECT_EQ(matrix_settle_ticks(10, 13, 249), 3);
+    EXPECT_EQ(matrix_settle_ticks(248, 1, 249), 3);
+    EXPECT_EQ(matrix_settle_ticks(250, 1, 255), 7);
+}
+
+TEST(MatrixSettle, the_last_timer_count_is_not_credited) {
+    EXPECT_EQ(matrix_settle_left_us(30, 0, 4), 30);
+    // The line could have been selected right before the count
+    EXPECT_EQ(matrix_settle_left_us(30, 1, 4), 30);
+    EXPECT_EQ(matrix_settle_left_us(30, 2, 4), 26);
+    EXPECT_EQ(matrix_settle_left_us(30, 8, 4), 2);
+}
+
+TEST(MatrixSettle, nothing_is_left_after_the_settle_time) {
+    EXPECT_EQ(matrix_settle_left_us(30, 9, 4), 0);
+    EXPECT_EQ(matrix_settle_left_us(30, 255, 4), 0);
+    EXPECT_EQ(matrix_settle_left_us(10, 255, 255), 0);
+}
@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "mouse_motion.h"
+#include "report.h"
+#include "timer.h"
+}
+
+static uint16_t now;
+static std::vector<report_mouse_t> reports;
+
+extern "C" {
+uint16_t timer_read(void) {
+    return now;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return now - last;
+}
+
+void host_mouse_send(report_mouse_t* report) {
+    reports.push_back(*report);
+}
+}
+
+// A device that has something every ms, with the default report interval
+class MouseMotion : public testing::Test {
+public:
+    MouseMotion() {
+        now = 1000;
+        reports.clear();
+        mouse_motion_clear();
+    }
+
+    // Runs the task every millisecond
+    void run(int ms) {
+        for (int i = 0; i < ms; i++) {
+            now++;
+            mouse_motion_task();
+        }
+    }
+
+    // Everything that was sent, added up
+    int total_x() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.x;
+        }
+        return total;
+    }
+};
+
+TEST_F(MouseMotion, nothing_is_sent_without_motion) {
+    run(100);
+    EXPECT_EQ(reports.size(), 0);
+    EXPECT_FALSE(mouse_motion_pending());
+}
+
+TEST_F(MouseMotion, motion_is_sent_once_per_interval) {
+    for (int i = 0; i < 5 * MOUSE_REPORT_INTERVAL; i++) {
+        mouse_motion_add(1, -2, 0, 0);
+        run(1);
+    }
+    ASSERT_EQ(reports.size(), 5);
+    for (auto& report : reports) {
+        EXPECT_EQ(report.x, MOUSE_REPORT_INTERVAL);
+        EXPECT_EQ(report.y, -2 * MOUSE_REPORT_INTERVAL);
+    }
+}
+
+TEST_F(MouseMotion, motion_after_a_pause_waits_for_the_interval) {
+    run(100);
+    mouse_motion_add(3, 0, 0, 0);
+    run(1);
+    ASSERT_EQ(reports.size(), 1);
+    mouse_motion_add(3, 0, 0, 0);
+    run(MOUSE_REPORT_INTERVAL - 1);
+    EXPECT_EQ(reports.size(), 1);
+    run(1);
+    EXPECT_EQ(reports.size(), 2);
+}
+
+TEST_F(MouseMotion, a_long_move_is_split_over_reports) {
+    mouse_motion_add(300, -300, 0, 0);
+    run(3 * MOUSE_REPORT_INTERVAL);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[0].x, 127);
+    EXPECT_EQ(reports[0].y, -127);
+    EXPECT_EQ(reports[1].x, 127);
+    EXPECT_EQ(reports[1].y, -127);
+    EXPECT_EQ(reports[2].x, 46);
+    EXPECT_EQ(reports[2].y, -46);
+    EXPECT_FALSE(mouse_motion_pending());
+}
+
+TEST_F(MouseMotion, no_motion_is_lost) {
+    // Faster than a report can take, back and forth
+    for (int i = 0; i < 1000; i++) {
+        mouse_motion_add(i % 100 < 70 ? 40 : -35, 0, 0, 0);
+        run(1);
+    }
+    run(1000);
+    int expected = 0;
+    for (int i = 0; i < 1000; i++) {
+        expected += i % 100 < 70 ? 40 : -35;
+    }
+    EXPECT_EQ(total_x(), expected);
+    for (auto& report : reports) {
+        EXPECT_GE(report.x, -127);
+    }
+}
+
+TEST_F(MouseMotion, motion_saturates_at_16_bits) {
+    for (int i = 0; i < 10; i++) {
+        mouse_motion_add(10000, -10000, 0, 0);
+    }
+    run(300 * MOUSE_REPORT_INTERVAL);
+    EXPECT_EQ(total_x(), INT16_MAX);
+}
+
+TEST_F(MouseMotion, wheels_are_kept_too) {
+    mouse_motion_add(0, 0, 200, -1);
+    run(2 * MOUSE_REPORT_INTERVAL);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[0].v, 127);
+    EXPECT_EQ(reports[0].h, -1);
+    EXPECT_EQ(reports[1].v, 73);
+    EXPECT_EQ(reports[1].h, 0);
+}
+
+TEST_F(MouseMotion, button_changes_dont_wait_for_the_interval) {
+    mouse_motion_add(5, 0, 0, 0);
+    run(1);
+    mouse_motion_buttons(MOUSE_BTN1);
+    run(1);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[1].buttons, MOUSE_BTN1);
+    mouse_motion_buttons(0);
+    run(1);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[2].buttons, 0);
+}
+
+TEST_F(MouseMotion, motion_before_a_click_is_sent_without_the_button) {
+    mouse_motion_add(5, 0, 0, 0);
+    run(MOUSE_REPORT_INTERVAL);
+    mouse_motion_add(7, 0, 0, 0);
+    mouse_motion_buttons(MOUSE_BTN1);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[1].x, 7);
+    EXPECT_EQ(reports[1].buttons, 0);
+    run(1);
+    ASSERT_EQ(reports.size(), 3);
+    EXPECT_EQ(reports[2].x, 0);
+    EXPECT_EQ(reports[2].buttons, MOUSE_BTN1);
+}
+
+TEST_F(MouseMotion, the_same_buttons_are_not_sent_again) {
+    mouse_motion_buttons(MOUSE_BTN2);
+    run(1);
+    mouse_motion_buttons(MOUSE_BTN2);
+    run(100);
+    EXPECT_EQ(reports.size(), 1);
+}
+
+TEST_F(MouseMotion, clear_forgets_what_is_pending) {
+    mouse_motion_buttons(MOUSE_BTN1);
+    mouse_motion_add(500, 0, 0, 0);
+    mouse_motion_clear();
+    EXPECT_FALSE(mouse_motion_pending());
+    run(100);
+    EXPECT_EQ(reports.size(), 0);
+}
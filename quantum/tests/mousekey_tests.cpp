@@ -0,0 +1,230 @@
+#include "gtest/gtest.h"
+#include <vector>
+extern "C" {
+#include "keycode.h"
+#include "mousekey.h"
+#include "debug.h"
+#include "timer.h"
+}
+
+static uint16_t now;
+static std::vector<report_mouse_t> reports;
+
+extern "C" {
+debug_config_t debug_config;
+
+uint16_t timer_read(void) {
+    return now;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return now - last;
+}
+
+void host_mouse_send(report_mouse_t* report) {
+    reports.push_back(*report);
+}
+}
+
+// The defaults of mousekey.h, where the pointer starts at 5 pixels and gets
+// to 50 pixels per 50ms in a second, after a delay of 300ms
+class Mousekey : public testing::Test {
+public:
+    Mousekey() {
+        now = 1000;
+        reports.clear();
+        mousekey_clear();
+        mk_delay = MOUSEKEY_DELAY / 10;
+        mk_interval = MOUSEKEY_INTERVAL;
+        mk_max_speed = MOUSEKEY_MAX_SPEED;
+        mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
+        mk_curve = MOUSEKEY_CURVE;
+        mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
+        mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+    }
+
+    void press(uint8_t code) {
+        mousekey_on(code);
+        mousekey_send();
+    }
+
+    void release(uint8_t code) {
+        mousekey_off(code);
+        mousekey_send();
+    }
+
+    // Runs the task every millisecond
+    void run(int ms) {
+        for (int i = 0; i < ms; i++) {
+            now++;
+            mousekey_task();
+        }
+    }
+
+    // Holds the key for the time, and returns the reports
+    std::vector<report_mouse_t> hold(uint8_t code, int ms) {
+        press(code);
+        run(ms);
+        release(code);
+        return reports;
+    }
+
+    int total_x() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.x;
+        }
+        return total;
+    }
+
+    int total_y() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.y;
+        }
+        return total;
+    }
+
+    int total_v() {
+        int total = 0;
+        for (auto& report : reports) {
+            total += report.v;
+        }
+        return total;
+    }
+};
+
+TEST_F(Mousekey, press_moves_right_away) {
+    press(KC_MS_RIGHT);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].x, MOUSEKEY_MOVE_DELTA);
+    EXPECT_EQ(reports[0].y, 0);
+}
+
+TEST_F(Mousekey, nothing_moves_during_the_delay) {
+    press(KC_MS_LEFT);
+    run(299);
+    ASSERT_EQ(reports.size(), 1);
+    EXPECT_EQ(reports[0].x, -MOUSEKEY_MOVE_DELTA);
+    run(1);
+    EXPECT_EQ(reports.size(), 2);
+}
+
+TEST_F(Mousekey, total_distance_follows_the_linear_ramp) {
+    // 5 pixels at the press, then 550 pixels while accelerating from 0.1 to
+    // 1 pixel/ms for 1000ms, and 1000 more pixels at full speed. The first
+    // repeat at 300ms moves like it was already moving for 50ms
+    hold(KC_MS_RIGHT, 2250);
+    EXPECT_NEAR(total_x(), 5 + 550 + 1000, 1);
+    EXPECT_EQ(total_y(), 0);
+}
+
+TEST_F(Mousekey, motion_accelerates_smoothly) {
+    hold(KC_MS_DOWN, 2250);
+    std::vector<int> steps;
+    for (size_t i = 2; i < reports.size() - 1; i++) {
+        steps.push_back(reports[i].y);
+    }
+    // Speeding up by 2.25 pixels every 50ms, until it's 50 pixels
+    for (size_t i = 1; i < steps.size(); i++) {
+        EXPECT_GE(steps[i], steps[i - 1]);
+        EXPECT_LE(steps[i] - steps[i - 1], 3);
+    }
+    EXPECT_EQ(steps.back(), 50);
+}
+
+TEST_F(Mousekey, interval_only_changes_the_report_rate) {
+    hold(KC_MS_RIGHT, 2250);
+    int distance = total_x();
+    size_t count = reports.size();
+
+    reports.clear();
+    mk_interval = 10;
+    hold(KC_MS_RIGHT, 2250);
+    EXPECT_NEAR(total_x(), distance, 1);
+    EXPECT_GT(reports.size(), count * 4);
+}
+
+TEST_F(Mousekey, slow_motion_is_not_lost) {
+    // A constant 0.1 pixel/ms reported every 7ms, less than a pixel per
+    // report
+    mk_max_speed = 1;
+    mk_interval = 7;
+    hold(KC_MS_RIGHT, 1000);
+    // The press, the first repeat and the release
+    ASSERT_GT(reports.size(), 3);
+    EXPECT_EQ(reports[1].x, 5);
+    for (size_t i = 2; i < reports.size() - 1; i++) {
+        EXPECT_EQ(reports[i].x, 1);
+    }
+    EXPECT_NEAR(total_x(), 5 + 5 + 70, 1);
+}
+
+TEST_F(Mousekey, diagonal_is_as_fast_as_straight) {
+    press(KC_MS_RIGHT);
+    press(KC_MS_DOWN);
+    run(2250);
+    EXPECT_NEAR(total_x(), 5 + 1550 * 0.7071, 2);
+    EXPECT_NEAR(total_y(), 5 + 1550 * 0.7071, 2);
+}
+
+TEST_F(Mousekey, quadratic_curve_starts_slower) {
+    mk_curve = MOUSEKEY_CURVE_QUADRATIC;
+    // 100 pixels at the initial speed, and a third of the 900 to accelerate
+    hold(KC_MS_RIGHT, 1250);
+    EXPECT_NEAR(total_x(), 5 + 100 + 300, 2);
+}
+
+TEST_F(Mousekey, curves_differ_while_accelerating) {
+    int distance[3];
+    for (uint8_t curve = 0; curve < 3; curve++) {
+        reports.clear();
+        mk_curve = curve;
+        hold(KC_MS_RIGHT, 750);
+        distance[curve] = total_x();
+    }
+    // The first half of the ramp, 50 pixels at the initial speed, and 900
+    // times the area under the curve up to 0.5
+    EXPECT_NEAR(distance[MOUSEKEY_CURVE_LINEAR], 5 + 50 + 900 * 0.125, 2);
+    EXPECT_NEAR(distance[MOUSEKEY_CURVE_QUADRATIC], 5 + 50 + 900 * 0.0417, 2);
+    EXPECT_NEAR(distance[MOUSEKEY_CURVE_TABLE], 5 + 50 + 900 * 0.0938, 3);
+}
+
+TEST_F(Mousekey, accel_keys_move_at_a_fixed_speed) {
+    press(KC_MS_ACCEL2);
+    press(KC_MS_UP);
+    EXPECT_EQ(reports.back().y, -50);
+    run(400);
+    EXPECT_EQ(reports.back().y, -50);
+    reports.clear();
+    release(KC_MS_UP);
+    release(KC_MS_ACCEL2);
+    press(KC_MS_ACCEL0);
+    press(KC_MS_UP);
+    EXPECT_EQ(reports.back().y, -12);
+}
+
+TEST_F(Mousekey, wheel_accumulates_too) {
+    // From 1 to 8 units per 50ms in 2 seconds
+    hold(KC_MS_WH_DOWN, 2250);
+    EXPECT_NEAR(total_v(), -(1 + 180), 1);
+    EXPECT_EQ(total_x(), 0);
+}
+
+TEST_F(Mousekey, release_stops_and_restarts_the_motion) {
+    hold(KC_MS_RIGHT, 2250);
+    reports.clear();
+    run(1000);
+    EXPECT_EQ(reports.size(), 0);
+    // And the next press starts slow again
+    press(KC_MS_RIGHT);
+    EXPECT_EQ(reports.back().x, MOUSEKEY_MOVE_DELTA);
+}
+
+TEST_F(Mousekey, buttons_dont_repeat_the_motion) {
+    press(KC_MS_RIGHT);
+    press(KC_MS_BTN1);
+    ASSERT_EQ(reports.size(), 2);
+    EXPECT_EQ(reports[1].x, 0);
+    EXPECT_EQ(reports[1].buttons, MOUSE_BTN1);
+}
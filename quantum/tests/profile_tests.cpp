@@ -0,0 +1,229 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+extern "C" {
+#include "profile.h"
+#include "raw_hid.h"
+}
+
+using testing::ElementsAre;
+using testing::ElementsAreArray;
+
+// With 250 ticks per ms, like timer0 at 16MHz, a tick is 4us
+class Profile : public testing::Test {
+public:
+    Profile() {
+        Instance = this;
+        profile_reset();
+    }
+
+    ~Profile() {
+        Instance = nullptr;
+    }
+
+    void run(profile_section_t section, uint32_t ticks) {
+        uint32_t begin = now;
+        now += ticks;
+        profile_add(section, begin);
+    }
+
+    void latency(uint32_t ticks) {
+        profile_key_event();
+        now += ticks;
+        profile_report_sent();
+    }
+
+    std::vector<uint8_t> receive(std::vector<uint8_t> request, bool handled = true) {
+        uint8_t data[32] = {};
+        std::copy(request.begin(), request.end(), data);
+        EXPECT_EQ(profile_raw_hid_receive(data, sizeof(data)), handled);
+        return std::vector<uint8_t>(data, data + sizeof(data));
+    }
+
+    uint32_t now = 1000;
+    std::vector<std::vector<uint8_t>> sent;
+
+    static Profile* Instance;
+};
+
+Profile* Profile::Instance = nullptr;
+
+extern "C" {
+uint32_t profile_time(void) {
+    return Profile::Instance->now;
+}
+
+void raw_hid_send(uint8_t* data, uint8_t length) {
+    Profile::Instance->sent.push_back(std::vector<uint8_t>(data, data + length));
+}
+}
+
+TEST_F(Profile, sections_start_empty) {
+    for (int section = 0; section < PROFILE_SECTIONS; section++) {
+        EXPECT_EQ(profile_stats[section].count, 0);
+        EXPECT_EQ(profile_stats[section].total, 0);
+        EXPECT_EQ(profile_stats[section].min, 0);
+        EXPECT_EQ(profile_stats[section].max, 0);
+    }
+    EXPECT_EQ(profile_scan_rate, 0);
+}
+
+TEST_F(Profile, section_keeps_count_total_min_and_max) {
+    run(PROFILE_ACTION_EXEC, 20);
+    run(PROFILE_ACTION_EXEC, 10);
+    run(PROFILE_ACTION_EXEC, 30);
+    const profile_stats_t& stats = profile_stats[PROFILE_ACTION_EXEC];
+    EXPECT_EQ(stats.count, 3);
+    EXPECT_EQ(stats.total, 60);
+    EXPECT_EQ(stats.min, 10);
+    EXPECT_EQ(stats.max, 30);
+    // The other sections aren't touched
+    EXPECT_EQ(profile_stats[PROFILE_MATRIX_SCAN].count, 0);
+}
+
+TEST_F(Profile, ticks_are_converted_to_us) {
+    EXPECT_EQ(profile_to_us(1), 4);
+    EXPECT_EQ(profile_to_us(250), 1000);
+    EXPECT_EQ(profile_to_us(UINT16_MAX), 262140);
+}
+
+TEST_F(Profile, long_sections_are_clamped) {
+    run(PROFILE_KEYBOARD_TASK, 100000);
+    EXPECT_EQ(profile_stats[PROFILE_KEYBOARD_TASK].max, UINT16_MAX);
+}
+
+TEST_F(Profile, clock_wrapping_around_is_measured_right) {
+    now = UINT32_MAX - 5;
+    run(PROFILE_HOST_SEND, 10);
+    EXPECT_EQ(profile_stats[PROFILE_HOST_SEND].max, 10);
+}
+
+TEST_F(Profile, total_is_halved_before_it_overflows) {
+    for (int i = 0; i < 70000; i++) {
+        run(PROFILE_KEYBOARD_TASK, 65000);
+    }
+    const profile_stats_t& stats = profile_stats[PROFILE_KEYBOARD_TASK];
+    EXPECT_LT(stats.count, 70000);
+    EXPECT_EQ(stats.total / stats.count, 65000);
+}
+
+TEST_F(Profile, scan_rate_is_counted_over_a_second) {
+    // A scan of 1ms, so 1000 scans take exactly a second
+    for (int i = 0; i < 999; i++) {
+        run(PROFILE_MATRIX_SCAN, 250);
+    }
+    EXPECT_EQ(profile_scan_rate, 0);
+    run(PROFILE_MATRIX_SCAN, 250);
+    EXPECT_EQ(profile_scan_rate, 1000);
+    // And then it's counted again for the next second
+    for (int i = 0; i < 100; i++) {
+        run(PROFILE_MATRIX_SCAN, 250 * 10);
+    }
+    EXPECT_EQ(profile_scan_rate, 100);
+}
+
+TEST_F(Profile, only_matrix_scans_count_for_the_scan_rate) {
+    for (int i = 0; i < 1000; i++) {
+        run(PROFILE_KEYBOARD_TASK, 250);
+    }
+    EXPECT_EQ(profile_scan_rate, 0);
+}
+
+TEST_F(Profile, latency_goes_to_doubling_buckets) {
+    latency(0);         // 0us
+    latency(62);        // 248us
+    latency(63);        // 252us
+    latency(250);       // 1ms
+    latency(1000);      // 4ms
+    latency(3999);      // 15.996ms
+    latency(4000);      // 16ms
+    latency(1000000);   // 4s
+    EXPECT_THAT(profile_latency, ElementsAre(2, 1, 0, 1, 0, 1, 1, 2));
+}
+
+TEST_F(Profile, latency_is_from_the_first_unreported_event) {
+    profile_key_event();
+    now += 100;
+    profile_key_event();
+    now += 200;
+    profile_report_sent();
+    // 1.2ms
+    EXPECT_THAT(profile_latency, ElementsAre(0, 0, 0, 1, 0, 0, 0, 0));
+}
+
+TEST_F(Profile, reports_without_events_are_not_counted) {
+    latency(0);
+    profile_report_sent();
+    now += 100;
+    profile_report_sent();
+    EXPECT_THAT(profile_latency, ElementsAre(1, 0, 0, 0, 0, 0, 0, 0));
+}
+
+TEST_F(Profile, reset_clears_everything) {
+    run(PROFILE_MATRIX_SCAN, 300);
+    run(PROFILE_ACTION_EXEC, 30);
+    profile_key_event();
+    profile_reset();
+    profile_report_sent();
+    EXPECT_EQ(profile_stats[PROFILE_MATRIX_SCAN].count, 0);
+    EXPECT_EQ(profile_stats[PROFILE_ACTION_EXEC].count, 0);
+    EXPECT_EQ(profile_scan_rate, 0);
+    EXPECT_THAT(profile_latency, ElementsAre(0, 0, 0, 0, 0, 0, 0, 0));
+}
+
+TEST_F(Profile, raw_hid_reads_a_section) {
+    run(PROFILE_MATRIX_SCAN, 250);
+    run(PROFILE_MATRIX_SCAN, 500);
+    std::vector<uint8_t> expected = {
+        PROFILE_RAW_HID_ID, PROFILE_RAW_HID_READ_SECTION, PROFILE_MATRIX_SCAN,
+        2, 0, 0, 0,             // count
+        0xDC, 0x05, 0, 0,       // average 1500us
+        0xE8, 0x03, 0, 0,       // min 1000us
+        0xD0, 0x07, 0, 0,       // max 2000us
+    };
+    expected.resize(32);
+    std::vector<uint8_t> answer = receive(
+        {PROFILE_RAW_HID_ID, PROFILE_RAW_HID_READ_SECTION, PROFILE_MATRIX_SCAN});
+    EXPECT_THAT(answer, ElementsAreArray(expected));
+    ASSERT_EQ(sent.size(), 1);
+    EXPECT_THAT(sent[0], ElementsAreArray(expected));
+}
+
+TEST_F(Profile, raw_hid_reads_the_scan_rate_and_latency) {
+    for (int i = 0; i < 1000; i++) {
+        run(PROFILE_MATRIX_SCAN, 250);
+    }
+    latency(0);
+    latency(5000);
+    std::vector<uint8_t> expected = {
+        PROFILE_RAW_HID_ID, PROFILE_RAW_HID_READ_LATENCY,
+        0xE8, 0x03,
+        1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0,
+    };
+    expected.resize(32);
+    EXPECT_THAT(receive({PROFILE_RAW_HID_ID, PROFILE_RAW_HID_READ_LATENCY}),
+        ElementsAreArray(expected));
+}
+
+TEST_F(Profile, raw_hid_resets) {
+    run(PROFILE_ACTION_EXEC, 30);
+    receive({PROFILE_RAW_HID_ID, PROFILE_RAW_HID_RESET});
+    EXPECT_EQ(profile_stats[PROFILE_ACTION_EXEC].count, 0);
+    ASSERT_EQ(sent.size(), 1);
+}
+
+TEST_F(Profile, raw_hid_answers_unknown_commands) {
+    std::vector<uint8_t> answer = receive({PROFILE_RAW_HID_ID, 0x42});
+    EXPECT_EQ(answer[1], PROFILE_RAW_HID_UNKNOWN);
+    answer = receive(
+        {PROFILE_RAW_HID_ID, PROFILE_RAW_HID_READ_SECTION, PROFILE_SECTIONS});
+    EXPECT_EQ(answer[1], PROFILE_RAW_HID_UNKNOWN);
+    EXPECT_EQ(sent.size(), 2);
+}
+
+TEST_F(Profile, raw_hid_leaves_other_packets_alone) {
+    std::vector<uint8_t> answer = receive({0x01, PROFILE_RAW_HID_RESET}, false);
+    EXPECT_EQ(answer[0], 0x01);
+    EXPECT_EQ(answer[1], PROFILE_RAW_HID_RESET);
+    EXPECT_EQ(sent.size(), 0);
+}
@@ -0,0 +1,223 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+extern "C" {
+#include "rgblight.h"
+}
+
+using testing::ElementsAreArray;
+
+// The golden frames are rendered with RGBLED_NUM set to 8, hue 100, sat 255
+// and val 200, using the default effect settings from rgblight.h
+
+struct golden_frame_t {
+    unsigned frame;
+    uint16_t hue[RGBLED_NUM];
+    uint8_t val[RGBLED_NUM];
+};
+
+class RGBLightAnimation : public testing::Test {
+public:
+    RGBLightAnimation() {
+        Instance = this;
+        rgblight_animation_start();
+    }
+
+    ~RGBLightAnimation() {
+        Instance = nullptr;
+    }
+
+    void check_golden_frames(uint8_t mode, const golden_frame_t* golden, unsigned num_frames) {
+        const rgblight_animation_t* animation = &rgblight_animations[mode - RGBLIGHT_ANIMATION_FIRST_MODE];
+        unsigned frame = 0;
+        for (unsigned i = 0; i < num_frames; i++) {
+            while (frame < golden[i].frame) {
+                rgblight_animation_advance(animation);
+                frame++;
+            }
+            rgblight_animation_render(animation, 100, 255, 200, leds, RGBLED_NUM);
+            EXPECT_THAT(hue, ElementsAreArray(golden[i].hue)) << "mode " << (int)mode << " frame " << frame;
+            EXPECT_THAT(val, ElementsAreArray(golden[i].val)) << "mode " << (int)mode << " frame " << frame;
+        }
+    }
+
+    LED_TYPE leds[RGBLED_NUM];
+    uint16_t hue[RGBLED_NUM];
+    uint8_t val[RGBLED_NUM];
+    unsigned num_sets = 0;
+    uint16_t time = 0;
+
+    static RGBLightAnimation* Instance;
+};
+
+RGBLightAnimation* RGBLightAnimation::Instance = nullptr;
+
+extern "C" {
+LED_TYPE led[RGBLED_NUM];
+
+void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE* led1) {
+    RGBLightAnimation* t = RGBLightAnimation::Instance;
+    LED_TYPE* base = led1 >= led && led1 < led + RGBLED_NUM ? led : t->leds;
+    t->hue[led1 - base] = hue;
+    t->val[led1 - base] = val;
+}
+
+void rgblight_set(void) {
+    RGBLightAnimation::Instance->num_sets++;
+}
+
+uint16_t timer_read(void) {
+    return RGBLightAnimation::Instance->time;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return RGBLightAnimation::Instance->time - last;
+}
+}
+
+// Breathing ignores the configured val, and goes through the full range
+TEST_F(RGBLightAnimation, breathing) {
+    const golden_frame_t golden[] = {
+        {0, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {1, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {64, {100, 100, 100, 100, 100, 100, 100, 100}, {127, 127, 127, 127, 127, 127, 127, 127}},
+        {128, {100, 100, 100, 100, 100, 100, 100, 100}, {255, 255, 255, 255, 255, 255, 255, 255}},
+        {129, {100, 100, 100, 100, 100, 100, 100, 100}, {254, 254, 254, 254, 254, 254, 254, 254}},
+        {255, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {256, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+    };
+    check_golden_frames(2, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, rainbow_mood) {
+    const golden_frame_t golden[] = {
+        {0, {0, 0, 0, 0, 0, 0, 0, 0}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {1, {1, 1, 1, 1, 1, 1, 1, 1}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {359, {359, 359, 359, 359, 359, 359, 359, 359}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {360, {0, 0, 0, 0, 0, 0, 0, 0}, {200, 200, 200, 200, 200, 200, 200, 200}},
+    };
+    check_golden_frames(6, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, rainbow_swirl_decreasing) {
+    const golden_frame_t golden[] = {
+        {0, {0, 45, 90, 135, 180, 225, 270, 315}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {1, {359, 44, 89, 134, 179, 224, 269, 314}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {45, {315, 0, 45, 90, 135, 180, 225, 270}, {200, 200, 200, 200, 200, 200, 200, 200}},
+    };
+    check_golden_frames(9, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, rainbow_swirl_increasing) {
+    const golden_frame_t golden[] = {
+        {0, {0, 45, 90, 135, 180, 225, 270, 315}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {1, {1, 46, 91, 136, 181, 226, 271, 316}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {45, {45, 90, 135, 180, 225, 270, 315, 0}, {200, 200, 200, 200, 200, 200, 200, 200}},
+    };
+    check_golden_frames(10, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, snake) {
+    const golden_frame_t golden[] = {
+        {0, {100, 100, 100, 100, 100, 100, 100, 100}, {200, 171, 143, 114, 86, 57, 29, 0}},
+        {1, {100, 100, 100, 100, 100, 100, 100, 100}, {171, 143, 114, 86, 57, 29, 0, 200}},
+        {8, {100, 100, 100, 100, 100, 100, 100, 100}, {200, 171, 143, 114, 86, 57, 29, 0}},
+    };
+    check_golden_frames(15, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, snake_reverse) {
+    const golden_frame_t golden[] = {
+        {0, {100, 100, 100, 100, 100, 100, 100, 100}, {200, 0, 29, 57, 86, 114, 143, 171}},
+        {1, {100, 100, 100, 100, 100, 100, 100, 100}, {171, 200, 0, 29, 57, 86, 114, 143}},
+        {8, {100, 100, 100, 100, 100, 100, 100, 100}, {200, 0, 29, 57, 86, 114, 143, 171}},
+    };
+    check_golden_frames(16, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, knight) {
+    const golden_frame_t golden[] = {
+        {0, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {4, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 200}},
+        {8, {100, 100, 100, 100, 100, 100, 100, 100}, {200, 200, 200, 200, 0, 0, 0, 200}},
+        {15, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 200, 200, 200, 0}},
+        {21, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {22, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+        {42, {100, 100, 100, 100, 100, 100, 100, 100}, {0, 0, 0, 0, 0, 0, 0, 0}},
+    };
+    check_golden_frames(21, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+// Unlike the hand-coded effect, which kept the end LED lit while the segment
+// was past it, nothing is lit while the segment is off the strip. The cycle
+// has no repeated frames at the turns.
+TEST_F(RGBLightAnimation, knight_cycle) {
+    const rgblight_animation_t* animation = &rgblight_animations[21 - RGBLIGHT_ANIMATION_FIRST_MODE];
+    const unsigned cycle = 2 * (RGBLED_NUM + 2 * RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1);
+    std::vector<std::vector<uint8_t>> frames;
+    for (unsigned frame = 0; frame < 2 * cycle; frame++) {
+        rgblight_animation_render(animation, 100, 255, 200, leds, RGBLED_NUM);
+        frames.push_back(std::vector<uint8_t>(val, val + RGBLED_NUM));
+        rgblight_animation_advance(animation);
+    }
+    unsigned dark = 0;
+    for (unsigned frame = 0; frame < cycle; frame++) {
+        EXPECT_EQ(frames[frame], frames[frame + cycle]) << "frame " << frame;
+        if (frames[frame] == std::vector<uint8_t>(RGBLED_NUM, 0)) {
+            dark++;
+        }
+    }
+    // The segment turns around off the strip, the same time at each end
+    EXPECT_EQ(dark, 2 * RGBLIGHT_EFFECT_KNIGHT_LENGTH);
+}
+
+TEST_F(RGBLightAnimation, christmas) {
+    const golden_frame_t golden[] = {
+        {0, {0, 0, 120, 120, 0, 0, 120, 120}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {1, {120, 120, 0, 0, 120, 120, 0, 0}, {200, 200, 200, 200, 200, 200, 200, 200}},
+        {2, {0, 0, 120, 120, 0, 0, 120, 120}, {200, 200, 200, 200, 200, 200, 200, 200}},
+    };
+    check_golden_frames(24, golden, sizeof(golden) / sizeof(golden[0]));
+}
+
+TEST_F(RGBLightAnimation, task_renders_the_first_frame_immediately) {
+    rgblight_animation_task(&rgblight_animations[6 - RGBLIGHT_ANIMATION_FIRST_MODE], 100, 255, 200);
+    EXPECT_EQ(num_sets, 1);
+    uint16_t expected[RGBLED_NUM] = {0, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_THAT(hue, ElementsAreArray(expected));
+}
+
+TEST_F(RGBLightAnimation, task_waits_for_the_frame_interval) {
+    // Rainbow mood 6 uses the first interval, 120ms
+    const rgblight_animation_t* animation = &rgblight_animations[6 - RGBLIGHT_ANIMATION_FIRST_MODE];
+    rgblight_animation_task(animation, 100, 255, 200);
+    time = 119;
+    rgblight_animation_task(animation, 100, 255, 200);
+    EXPECT_EQ(num_sets, 1);
+    time = 120;
+    rgblight_animation_task(animation, 100, 255, 200);
+    EXPECT_EQ(num_sets, 2);
+    uint16_t expected[RGBLED_NUM] = {1, 1, 1, 1, 1, 1, 1, 1};
+    EXPECT_THAT(hue, ElementsAreArray(expected));
+}
+
+TEST_F(RGBLightAnimation, christmas_uses_a_fixed_interval) {
+    const rgblight_animation_t* animation = &rgblight_animations[24 - RGBLIGHT_ANIMATION_FIRST_MODE];
+    rgblight_animation_task(animation, 100, 255, 200);
+    time = RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL - 1;
+    rgblight_animation_task(animation, 100, 255, 200);
+    EXPECT_EQ(num_sets, 1);
+    time = RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL;
+    rgblight_animation_task(animation, 100, 255, 200);
+    EXPECT_EQ(num_sets, 2);
+}
+
+TEST_F(RGBLightAnimation, start_restarts_the_animation) {
+    const rgblight_animation_t* animation = &rgblight_animations[6 - RGBLIGHT_ANIMATION_FIRST_MODE];
+    rgblight_animation_advance(animation);
+    rgblight_animation_advance(animation);
+    rgblight_animation_start();
+    rgblight_animation_task(animation, 100, 255, 200);
+    uint16_t expected[RGBLED_NUM] = {0, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_THAT(hue, ElementsAreArray(expected));
+}
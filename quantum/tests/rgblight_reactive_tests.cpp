@@ -0,0 +1,160 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+extern "C" {
+#include "rgblight.h"
+}
+
+using testing::ElementsAreArray;
+
+// The frames are rendered with RGBLED_NUM set to 8 and MATRIX_COLS to 16, so
+// every LED is under two columns, and with hue 100, sat 255 and val 200
+
+class RGBLightReactive : public testing::Test {
+public:
+    RGBLightReactive() {
+        Instance = this;
+        rgblight_reactive_start();
+    }
+
+    ~RGBLightReactive() {
+        Instance = nullptr;
+    }
+
+    void press(uint8_t col, uint16_t at) {
+        rgblight_reactive_record((keyevent_t){ .key = { .col = col, .row = 0 }, .pressed = true, .time = at });
+    }
+
+    void release(uint8_t col, uint16_t at) {
+        rgblight_reactive_record((keyevent_t){ .key = { .col = col, .row = 0 }, .pressed = false, .time = at });
+    }
+
+    // Runs the task at the given time, which always renders a frame since
+    // the frames in the tests are further apart than the frame interval
+    void render(rgblight_reactive_effect_t effect, uint16_t at) {
+        time = at;
+        rgblight_reactive_task(effect, 100, 255, 200);
+    }
+
+    uint8_t val[RGBLED_NUM] = {0};
+    unsigned num_sets = 0;
+    uint16_t time = 0;
+
+    static RGBLightReactive* Instance;
+};
+
+RGBLightReactive* RGBLightReactive::Instance = nullptr;
+
+extern "C" {
+LED_TYPE led[RGBLED_NUM];
+
+void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE* led1) {
+    EXPECT_EQ(hue, 100);
+    EXPECT_EQ(sat, 255);
+    RGBLightReactive::Instance->val[led1 - led] = val;
+}
+
+void rgblight_set(void) {
+    RGBLightReactive::Instance->num_sets++;
+}
+
+uint16_t timer_read(void) {
+    return RGBLightReactive::Instance->time;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return RGBLightReactive::Instance->time - last;
+}
+}
+
+TEST_F(RGBLightReactive, a_press_lights_the_led_under_the_key) {
+    press(5, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    const uint8_t expected[] = {0, 0, 200, 0, 0, 0, 0, 0};
+    EXPECT_THAT(val, ElementsAreArray(expected));
+    EXPECT_EQ(num_sets, 1);
+}
+
+TEST_F(RGBLightReactive, a_press_fades_out_over_the_decay_time) {
+    press(0, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY / 4);
+    EXPECT_EQ(val[0], 150);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY / 2);
+    EXPECT_EQ(val[0], 100);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY - 1);
+    EXPECT_EQ(val[0], 0);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY);
+    EXPECT_EQ(val[0], 0);
+}
+
+TEST_F(RGBLightReactive, releases_dont_light_anything) {
+    release(3, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    const uint8_t expected[] = {0, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_THAT(val, ElementsAreArray(expected));
+}
+
+TEST_F(RGBLightReactive, the_brightest_press_wins_an_led) {
+    press(14, 1001);
+    press(15, 1001 + RGBLIGHT_REACTIVE_DECAY / 2);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY / 2);
+    EXPECT_EQ(val[7], 200);
+    press(14, 1001 + RGBLIGHT_REACTIVE_DECAY / 2 + 1);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY);
+    EXPECT_EQ(val[7], 100);
+}
+
+TEST_F(RGBLightReactive, the_ripple_moves_out_from_the_key) {
+    press(8, 1001);
+    render(RGBLIGHT_REACTIVE_RIPPLE_EFFECT, 1001);
+    const uint8_t start[] = {0, 0, 0, 0, 200, 0, 0, 0};
+    EXPECT_THAT(val, ElementsAreArray(start));
+    render(RGBLIGHT_REACTIVE_RIPPLE_EFFECT, 1001 + 2 * RGBLIGHT_REACTIVE_RIPPLE_SPEED);
+    const uint8_t later[] = {0, 0, 168, 0, 0, 0, 168, 0};
+    EXPECT_THAT(val, ElementsAreArray(later));
+    // The side that moved off the strip is dropped
+    render(RGBLIGHT_REACTIVE_RIPPLE_EFFECT, 1001 + 4 * RGBLIGHT_REACTIVE_RIPPLE_SPEED);
+    const uint8_t edge[] = {136, 0, 0, 0, 0, 0, 0, 0};
+    EXPECT_THAT(val, ElementsAreArray(edge));
+}
+
+TEST_F(RGBLightReactive, the_strip_is_not_updated_while_it_stays_dark) {
+    press(0, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY);
+    EXPECT_EQ(num_sets, 2);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + 2 * RGBLIGHT_REACTIVE_DECAY);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + 3 * RGBLIGHT_REACTIVE_DECAY);
+    EXPECT_EQ(num_sets, 2);
+}
+
+TEST_F(RGBLightReactive, no_frame_is_rendered_before_the_frame_interval) {
+    press(0, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_INTERVAL - 1);
+    EXPECT_EQ(num_sets, 1);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_INTERVAL);
+    EXPECT_EQ(num_sets, 2);
+}
+
+TEST_F(RGBLightReactive, an_expired_press_stays_dark_when_the_timer_wraps) {
+    press(0, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_DECAY);
+    EXPECT_EQ(val[0], 0);
+    // The 16 bit timer is back where the press happened
+    for (uint32_t at = 1001 + 2 * RGBLIGHT_REACTIVE_DECAY; at <= 1001 + 65536; at += RGBLIGHT_REACTIVE_DECAY) {
+        render(RGBLIGHT_REACTIVE_DECAY_EFFECT, at);
+    }
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001);
+    EXPECT_EQ(val[0], 0);
+}
+
+TEST_F(RGBLightReactive, only_the_latest_presses_are_kept) {
+    press(0, 1001);
+    for (uint8_t i = 1; i <= RGBLIGHT_REACTIVE_EVENTS; i++) {
+        press(15, 1001 + i);
+    }
+    render(RGBLIGHT_REACTIVE_DECAY_EFFECT, 1001 + RGBLIGHT_REACTIVE_EVENTS);
+    EXPECT_EQ(val[0], 0);
+    EXPECT_EQ(val[7], 200);
+}
@@ -0,0 +1,91 @@
+quantum_ws2812_spi_SRC := \
+	$(QUANTUM_PATH)/tests/ws2812_spi_tests.cpp \
+	$(QUANTUM_PATH)/ws2812_spi.c
+
+quantum_rgblight_animation_DEFS := -DRGBLED_NUM=8 -DRGBLIGHT_ANIMATIONS
+quantum_rgblight_animation_SRC := \
+	$(QUANTUM_PATH)/tests/rgblight_animation_tests.cpp \
+	$(QUANTUM_PATH)/rgblight_animation.c \
+	$(QUANTUM_PATH)/rgblight_effects.c
+
+quantum_rgblight_reactive_DEFS := -DRGBLED_NUM=8 -DRGBLIGHT_ANIMATIONS -DRGBLIGHT_REACTIVE \
+	-DMATRIX_COLS=16
+quantum_rgblight_reactive_SRC := \
+	$(QUANTUM_PATH)/tests/rgblight_reactive_tests.cpp \
+	$(QUANTUM_PATH)/rgblight_reactive.c
+
+quantum_split_transport_DEFS := -DMAX_FRAME_SIZE=32 -DNUM_LINKS=1
+quantum_split_transport_SRC := \
+	$(QUANTUM_PATH)/tests/split_transport_tests.cpp \
+	$(QUANTUM_PATH)/split/split_transport.c \
+	$(QUANTUM_PATH)/serial_link/protocol/byte_stuffer.c \
+	$(QUANTUM_PATH)/serial_link/protocol/frame_validator.c \
+	$(QUANTUM_PATH)/serial_link/protocol/crc32.c \
+	$(QUANTUM_PATH)/serial_link/protocol/link_stats.c
+
+quantum_split_sync_DEFS := -DMATRIX_ROWS=8 -DMATRIX_COLS=12
+quantum_split_sync_SRC := \
+	$(QUANTUM_PATH)/tests/split_sync_tests.cpp \
+	$(QUANTUM_PATH)/split/split_sync.c
+
+quantum_twi_queue_SRC := \
+	$(QUANTUM_PATH)/tests/twi_queue_tests.cpp \
+	$(QUANTUM_PATH)/twi_queue.c
+
+quantum_expander_matrix_CONFIG := $(QUANTUM_PATH)/tests/expander_matrix_config.h
+quantum_expander_matrix_SRC := \
+	$(QUANTUM_PATH)/tests/expander_matrix_tests.cpp \
+	$(QUANTUM_PATH)/expander_matrix.c
+
+quantum_matrix_ports_DEFS := -DMATRIX_COLS=15 -DMATRIX_PORTS_READ=matrix_ports_test_read
+quantum_matrix_ports_SRC := \
+	$(QUANTUM_PATH)/tests/matrix_ports_tests.cpp \
+	$(QUANTUM_PATH)/matrix_ports.c
+
+quantum_matrix_settle_SRC := \
+	$(QUANTUM_PATH)/tests/matrix_settle_tests.cpp
+
+quantum_profile_DEFS := -DPROFILE_TICKS_PER_MS=250 -DRAW_ENABLE -DNO_PRINT
+quantum_profile_SRC := \
+	$(QUANTUM_PATH)/tests/profile_tests.cpp \
+	$(QUANTUM_PATH)/profile.c
+
+quantum_matrix_ghost_DEFS := -DMATRIX_ROWS=6 -DMATRIX_COLS=8 -DMATRIX_HAS_GHOST
+quantum_matrix_ghost_SRC := \
+	$(QUANTUM_PATH)/tests/matrix_ghost_tests.cpp \
+	$(TMK_PATH)/common/matrix_ghost.c
+
+quantum_mousekey_DEFS := -DNO_PRINT -DNO_DEBUG
+quantum_mousekey_SRC := \
+	$(QUANTUM_PATH)/tests/mousekey_tests.cpp \
+	$(TMK_PATH)/common/mousekey.c
+
+quantum_mouse_motion_SRC := \
+	$(QUANTUM_PATH)/tests/mouse_motion_tests.cpp \
+	$(TMK_PATH)/common/mouse_motion.c
+
+quantum_action_tapping_DEFS := -DNO_PRINT -DNO_DEBUG -DTAPPING_TERM_PER_KEY \
+	-DMATRIX_ROWS=1 -DMATRIX_COLS=8
+quantum_action_tapping_SRC := \
+	$(QUANTUM_PATH)/tests/action_tapping_tests.cpp \
+	$(TMK_PATH)/common/action_tapping.c
+
+quantum_speculative_hold_DEFS := -DNO_PRINT -DNO_DEBUG -DSPECULATIVE_HOLD \
+	-DIGNORE_MOD_TAP_INTERRUPT -DMATRIX_ROWS=1 -DMATRIX_COLS=9
+quantum_speculative_hold_SRC := \
+	$(QUANTUM_PATH)/tests/speculative_hold_tests.cpp \
+	$(TMK_PATH)/common/action_tapping.c
+
+SOURCE_LAYERS_TEST_SRC := \
+	$(QUANTUM_PATH)/tests/source_layers_tests.cpp \
+	$(TMK_PATH)/common/action_layer.c \
+	$(TMK_PATH)/common/util.c
+SOURCE_LAYERS_TEST_DEFS := -DNO_PRINT -DNO_DEBUG -DPREVENT_STUCK_MODIFIERS \
+	-DMATRIX_ROWS=5 -DMATRIX_COLS=13
+
+quantum_source_layers_SRC := $(SOURCE_LAYERS_TEST_SRC)
+quantum_source_layers_DEFS := $(SOURCE_LAYERS_TEST_DEFS)
+quantum_source_layers_nibble_SRC := $(SOURCE_LAYERS_TEST_SRC)
+quantum_source_layers_nibble_DEFS := $(SOURCE_LAYERS_TEST_DEFS) -DMAX_LAYER_BITS=4
+quantum_source_layers_packed_SRC := $(SOURCE_LAYERS_TEST_SRC)
+quantum_source_layers_packed_DEFS := $(SOURCE_LAYERS_TEST_DEFS) -DSOURCE_LAYERS_CACHE_PACKED
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+extern "C" {
+#include "action.h"
+#include "action_code.h"
+#include "action_layer.h"
+#include "keycode.h"
+}
+
+// The layers that fit in the cache
+#define LAYERS (MAX_LAYER_BITS < 5 ? 1 << MAX_LAYER_BITS : 32)
+
+extern "C" {
+bool disable_action_cache = false;
+
+// Every layer has every key, so the top layer that is on is used
+action_t action_for_key(uint8_t layer, keypos_t key) {
+    action_t action;
+    action.code = ACTION_KEY(KC_A + layer);
+    return action;
+}
+
+void clear_keyboard_but_mods(void) {
+}
+}
+
+static keypos_t key(uint8_t row, uint8_t col) {
+    return (keypos_t){ .col = col, .row = row };
+}
+
+class SourceLayers : public testing::Test {
+public:
+    SourceLayers() {
+        disable_action_cache = false;
+        layer_clear();
+    }
+};
+
+TEST_F(SourceLayers, a_release_gets_the_layer_of_the_press) {
+    layer_on(LAYERS - 1);
+    EXPECT_EQ(store_or_get_layer(true, key(1, 2)), LAYERS - 1);
+    layer_clear();
+    EXPECT_EQ(store_or_get_layer(false, key(1, 2)), LAYERS - 1);
+    layer_on(1);
+    EXPECT_EQ(store_or_get_layer(true, key(1, 2)), 1);
+    layer_clear();
+    EXPECT_EQ(store_or_get_layer(false, key(1, 2)), 1);
+}
+
+TEST_F(SourceLayers, every_key_keeps_its_own_layer) {
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            uint8_t layer = (row * MATRIX_COLS + col * 7) % LAYERS;
+            layer_move(layer);
+            store_or_get_layer(true, key(row, col));
+        }
+    }
+    layer_clear();
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            uint8_t layer = (row * MATRIX_COLS + col * 7) % LAYERS;
+            EXPECT_EQ(store_or_get_layer(false, key(row, col)), layer)
+                << "row " << (int)row << " col " << (int)col;
+        }
+    }
+}
+
+TEST_F(SourceLayers, the_last_key_is_kept) {
+    keypos_t last = key(MATRIX_ROWS - 1, MATRIX_COLS - 1);
+    keypos_t before = key(MATRIX_ROWS - 1, MATRIX_COLS - 2);
+    layer_move(LAYERS - 1);
+    store_or_get_layer(true, last);
+    layer_move(2);
+    store_or_get_layer(true, before);
+    layer_clear();
+    EXPECT_EQ(store_or_get_layer(false, last), LAYERS - 1);
+    EXPECT_EQ(store_or_get_layer(false, before), 2);
+}
+
+TEST_F(SourceLayers, the_action_is_read_from_the_layer_of_the_press) {
+    layer_on(3);
+    EXPECT_EQ(store_or_get_action(true, key(0, 0)).code, ACTION_KEY(KC_A + 3));
+    layer_off(3);
+    EXPECT_EQ(store_or_get_action(false, key(0, 0)).code, ACTION_KEY(KC_A + 3));
+}
+
+TEST_F(SourceLayers, without_the_cache_the_current_layer_is_used) {
+    layer_on(3);
+    store_or_get_layer(true, key(2, 5));
+    layer_off(3);
+    disable_action_cache = true;
+    EXPECT_EQ(store_or_get_layer(false, key(2, 5)), 0);
+}
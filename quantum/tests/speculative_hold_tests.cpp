@@ -0,0 +1,503 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+extern "C" {
+#include "action.h"
+#include "action_code.h"
+#include "action_layer.h"
+#include "action_tapping.h"
+#include "keycode.h"
+}
+
+// The keys on row 0, by column, a home row with mods on it
+enum {
+    KEY_A,
+    KEY_E,
+    KEY_SPC,
+    KEY_SHIFT,
+    KEY_SFT_S,
+    KEY_ALT_D,
+    KEY_CTL_F,
+    KEY_CTL_J,
+    KEY_LT_K,
+    KEY_COUNT
+};
+
+static const action_t actions[KEY_COUNT] = {
+    ACTION_KEY(KC_A),
+    ACTION_KEY(KC_E),
+    ACTION_KEY(KC_SPC),
+    ACTION_KEY(KC_LSFT),
+    ACTION_MODS_TAP_KEY(MOD_LSFT, KC_S),
+    ACTION_MODS_TAP_KEY(MOD_LALT, KC_D),
+    ACTION_MODS_TAP_KEY(MOD_LCTL, KC_F),
+    ACTION_MODS_TAP_KEY(MOD_RCTL, KC_J),
+    ACTION_LAYER_TAP_KEY(1, KC_K),
+};
+
+#define LCTL MOD_BIT(KC_LCTRL)
+#define LSFT MOD_BIT(KC_LSHIFT)
+#define LALT MOD_BIT(KC_LALT)
+#define RCTL MOD_BIT(KC_RCTRL)
+
+// A key that made it to the host, with the mods it got
+struct Typed {
+    uint8_t key;
+    uint8_t mods;
+
+    bool operator==(const Typed& other) const {
+        return key == other.key && mods == other.mods;
+    }
+};
+
+static std::ostream& operator<<(std::ostream& os, const Typed& typed) {
+    return os << "{key " << (int)typed.key << " mods " << (int)typed.mods << "}";
+}
+
+static uint16_t now;
+static uint8_t mods;
+static uint8_t sent_mods;
+static uint8_t unused_mods;
+static int reports;
+static int flashes;
+static std::vector<Typed> typed;
+static std::vector<uint16_t> latencies;
+
+extern "C" void send_keyboard_report(void);
+
+// What process_action does with the record, for the keys above
+static void type(keyrecord_t* record) {
+    send_keyboard_report();
+    typed.push_back(Typed{record->event.key.col, sent_mods});
+    latencies.push_back((now | 1) - record->event.time);
+    unused_mods = 0;
+}
+
+extern "C" {
+uint8_t get_mods(void) {
+    return mods;
+}
+
+void add_mods(uint8_t amods) {
+    mods |= amods;
+}
+
+void del_mods(uint8_t amods) {
+    mods &= ~amods;
+}
+
+// Mods that go up again before anything is typed with them are a flash
+void send_keyboard_report(void) {
+    if (sent_mods & ~mods & unused_mods) {
+        flashes++;
+    }
+    unused_mods = (unused_mods & mods) | (mods & ~sent_mods);
+    sent_mods = mods;
+    reports++;
+}
+
+void process_record(keyrecord_t* record) {
+    if (IS_NOEVENT(record->event)) {
+        return;
+    }
+    keyevent_t event = record->event;
+    action_t action = actions[event.key.col];
+    uint8_t tap_mods = (action.kind.id == ACT_LMODS_TAP) ? action.key.mods : action.key.mods << 4;
+    switch (action.kind.id) {
+        case ACT_LMODS:
+            if (!IS_MOD(action.key.code)) {
+                if (event.pressed) type(record);
+            } else {
+                if (event.pressed) add_mods(MOD_BIT(action.key.code));
+                else del_mods(MOD_BIT(action.key.code));
+                send_keyboard_report();
+            }
+            break;
+        case ACT_LMODS_TAP:
+        case ACT_RMODS_TAP:
+            // as with IGNORE_MOD_TAP_INTERRUPT
+            if (record->tap.count > 0) {
+                if (event.pressed) type(record);
+            } else {
+                if (event.pressed) add_mods(tap_mods);
+                else del_mods(tap_mods);
+                send_keyboard_report();
+            }
+            break;
+        case ACT_LAYER_TAP:
+        case ACT_LAYER_TAP_EXT:
+            if (record->tap.count > 0 && event.pressed) type(record);
+            break;
+    }
+}
+
+action_t layer_switch_get_action(keypos_t key) {
+    return actions[key.col];
+}
+
+bool is_tap_key(keypos_t key) {
+    switch (actions[key.col].kind.id) {
+        case ACT_LMODS_TAP:
+        case ACT_RMODS_TAP:
+        case ACT_LAYER_TAP:
+        case ACT_LAYER_TAP_EXT:
+            return true;
+    }
+    return false;
+}
+
+void clear_keyboard(void) {
+}
+
+void debug_event(keyevent_t event) {
+}
+
+void debug_record(keyrecord_t record) {
+}
+}
+
+static void reset_host(void) {
+    mods = 0;
+    sent_mods = 0;
+    unused_mods = 0;
+    reports = 0;
+    flashes = 0;
+    typed.clear();
+    latencies.clear();
+}
+
+static void event(uint8_t key, bool pressed, uint16_t time) {
+    now = time;
+    keyrecord_t record = {};
+    record.event.key = (keypos_t){ .col = key, .row = 0 };
+    record.event.pressed = pressed;
+    record.event.time = time | 1;
+    action_tapping_process(record);
+}
+
+// The pseudo event that keyboard_task sends every scan
+static void tick(uint16_t time) {
+    now = time;
+    keyrecord_t record = {};
+    record.event.key = (keypos_t){ .col = 255, .row = 255 };
+    record.event.time = time | 1;
+    action_tapping_process(record);
+}
+
+// The default settings with the default TAPPING_TERM of 200ms. Every test
+// starts after a pause, and leaves the engine idle.
+class SpeculativeHold : public testing::Test {
+public:
+    SpeculativeHold() {
+        speculative_hold_mods = SPECULATIVE_HOLD_MODS;
+        speculative_hold_typing_term = SPECULATIVE_HOLD_TYPING_TERM;
+        speculative_hold_chord_term = SPECULATIVE_HOLD_CHORD_TERM;
+        tick(now + 1000);
+        tick(now + 1000);
+        reset_host();
+    }
+
+    ~SpeculativeHold() {
+        tick(now + 2 * TAPPING_TERM);
+        tick(now + 2 * TAPPING_TERM);
+    }
+
+    void press(uint8_t key, uint16_t after) {
+        event(key, true, now + after);
+    }
+
+    void release(uint8_t key, uint16_t after) {
+        event(key, false, now + after);
+    }
+
+    void wait(uint16_t ms) {
+        uint16_t until = now + ms;
+        while (now != until) {
+            tick(now + 1);
+        }
+    }
+};
+
+TEST_F(SpeculativeHold, the_mods_are_sent_when_a_mod_tap_is_pressed) {
+    press(KEY_CTL_F, 0);
+    EXPECT_EQ(sent_mods, LCTL);
+    EXPECT_EQ(reports, 1);
+    release(KEY_CTL_F, TAPPING_TERM + 50);
+    EXPECT_EQ(sent_mods, 0);
+    EXPECT_TRUE(typed.empty());
+}
+
+TEST_F(SpeculativeHold, a_tap_takes_the_mods_back_first) {
+    press(KEY_CTL_J, 0);
+    EXPECT_EQ(sent_mods, RCTL);
+    release(KEY_CTL_J, 60);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_CTL_J, 0}}));
+    EXPECT_EQ(sent_mods, 0);
+    EXPECT_EQ(flashes, 1);
+}
+
+TEST_F(SpeculativeHold, a_key_after_the_chord_term_is_held_right_away) {
+    press(KEY_CTL_F, 0);
+    wait(SPECULATIVE_HOLD_CHORD_TERM);
+    press(KEY_A, 0);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_A, LCTL}}));
+    EXPECT_EQ(latencies, (std::vector<uint16_t>{0}));
+    release(KEY_A, 50);
+    release(KEY_CTL_F, 20);
+    EXPECT_EQ(sent_mods, 0);
+    EXPECT_EQ(flashes, 0);
+}
+
+TEST_F(SpeculativeHold, a_key_typed_inside_is_held) {
+    press(KEY_CTL_F, 0);
+    press(KEY_A, 30);
+    EXPECT_TRUE(typed.empty());
+    release(KEY_A, 40);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_A, LCTL}}));
+    release(KEY_CTL_F, 20);
+    EXPECT_EQ(sent_mods, 0);
+}
+
+TEST_F(SpeculativeHold, a_roll_types_both_keys) {
+    press(KEY_CTL_F, 0);
+    press(KEY_A, 40);
+    release(KEY_CTL_F, 30);
+    release(KEY_A, 30);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_CTL_F, 0}, {KEY_A, 0}}));
+    EXPECT_EQ(sent_mods, 0);
+}
+
+TEST_F(SpeculativeHold, nothing_is_sent_early_while_typing) {
+    press(KEY_A, 0);
+    release(KEY_A, 60);
+    press(KEY_CTL_F, SPECULATIVE_HOLD_TYPING_TERM - 61);
+    EXPECT_EQ(sent_mods, 0);
+    release(KEY_CTL_F, 60);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_A, 0}, {KEY_CTL_F, 0}}));
+    EXPECT_EQ(flashes, 0);
+}
+
+TEST_F(SpeculativeHold, alt_waits_for_the_term) {
+    press(KEY_ALT_D, 0);
+    EXPECT_EQ(reports, 0);
+    wait(TAPPING_TERM);
+    EXPECT_EQ(sent_mods, LALT);
+    release(KEY_ALT_D, 50);
+    EXPECT_EQ(sent_mods, 0);
+}
+
+TEST_F(SpeculativeHold, a_layer_tap_waits_for_the_term) {
+    press(KEY_LT_K, 0);
+    release(KEY_LT_K, 60);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_LT_K, 0}}));
+    EXPECT_EQ(flashes, 0);
+}
+
+TEST_F(SpeculativeHold, mods_that_are_down_already_stay) {
+    press(KEY_SHIFT, 0);
+    press(KEY_SFT_S, 200);
+    EXPECT_EQ(reports, 1);
+    release(KEY_SFT_S, 60);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_SFT_S, LSFT}}));
+    EXPECT_EQ(sent_mods, LSFT);
+    release(KEY_SHIFT, 50);
+    EXPECT_EQ(sent_mods, 0);
+}
+
+TEST_F(SpeculativeHold, a_timeout_keeps_the_mods) {
+    press(KEY_SFT_S, 0);
+    wait(TAPPING_TERM + 10);
+    EXPECT_EQ(sent_mods, LSFT);
+    press(KEY_A, 0);
+    release(KEY_A, 50);
+    release(KEY_SFT_S, 10);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_A, LSFT}}));
+    EXPECT_EQ(sent_mods, 0);
+    EXPECT_EQ(flashes, 0);
+}
+
+TEST_F(SpeculativeHold, no_mods_turns_it_off) {
+    speculative_hold_mods = 0;
+    press(KEY_CTL_F, 0);
+    EXPECT_EQ(reports, 0);
+    release(KEY_CTL_F, 60);
+    EXPECT_EQ(typed, (std::vector<Typed>{{KEY_CTL_F, 0}}));
+    EXPECT_EQ(flashes, 0);
+}
+
+// Synthetic typing, as a scan of 1ms would see it
+struct Trace {
+    struct Event {
+        uint32_t time;
+        uint8_t key;
+        bool pressed;
+    };
+    std::vector<Event> events;
+    std::vector<Typed> expected;
+    uint32_t end = 0;
+
+    void key(uint8_t key, uint32_t down, uint32_t up) {
+        events.push_back(Event{down, key, true});
+        events.push_back(Event{up, key, false});
+        if (up > end) end = up;
+    }
+};
+
+// Words from the keys above, typed with rolls, by someone who holds keys
+// 60-120ms and presses the next one 70-170ms later
+static Trace text_trace(int words, uint32_t seed) {
+    static const uint8_t vocabulary[][5] = {
+        {KEY_CTL_F, KEY_A, KEY_ALT_D, KEY_E},
+        {KEY_CTL_J, KEY_A, KEY_ALT_D, KEY_E},
+        {KEY_SFT_S, KEY_A, KEY_CTL_F, KEY_E},
+        {KEY_ALT_D, KEY_E, KEY_SFT_S, KEY_LT_K},
+        {KEY_A, KEY_SFT_S, KEY_LT_K},
+        {KEY_CTL_F, KEY_E, KEY_ALT_D},
+        {KEY_SFT_S, KEY_E, KEY_E, KEY_ALT_D},
+        {KEY_CTL_J, KEY_A, KEY_LT_K, KEY_E},
+        {KEY_LT_K, KEY_E, KEY_CTL_F},
+        {KEY_SFT_S, KEY_E, KEY_A},
+    };
+    std::mt19937 random(seed);
+    auto between = [&](int low, int high) {
+        return std::uniform_int_distribution<int>(low, high)(random);
+    };
+    Trace trace;
+    uint32_t time = 0;
+    for (int w = 0; w < words; w++) {
+        const uint8_t* word = vocabulary[between(0, 9)];
+        for (int i = 0; i < 5 && (i == 0 || word[i]); i++) {
+            trace.key(word[i], time, time + between(60, 120));
+            trace.expected.push_back(Typed{word[i], 0});
+            time += between(70, 170);
+        }
+        trace.key(KEY_SPC, time, time + between(60, 120));
+        trace.expected.push_back(Typed{KEY_SPC, 0});
+        time += between(70, 170);
+    }
+    return trace;
+}
+
+// Shortcuts after a pause, some right after a word: the mod-tap goes down
+// and the letter follows 60-250ms later
+static Trace shortcut_trace(int shortcuts, uint32_t seed) {
+    std::mt19937 random(seed);
+    auto between = [&](int low, int high) {
+        return std::uniform_int_distribution<int>(low, high)(random);
+    };
+    Trace trace;
+    uint32_t time = 0;
+    for (int s = 0; s < shortcuts; s++) {
+        time += between(0, 1) ? 500 : 120;
+        if (trace.end) {
+            trace.key(KEY_E, time, time + between(60, 120));
+            trace.expected.push_back(Typed{KEY_E, 0});
+            time += between(300, 600);
+        }
+        bool right = between(0, 1);
+        uint8_t mod = right ? KEY_CTL_J : KEY_CTL_F;
+        uint32_t letter = time + between(60, 250);
+        uint32_t letter_up = letter + between(60, 110);
+        trace.key(mod, time, letter_up + between(20, 80));
+        trace.key(KEY_A, letter, letter_up);
+        trace.expected.push_back(Typed{KEY_A, (uint8_t)(right ? RCTL : LCTL)});
+        time = trace.end;
+    }
+    return trace;
+}
+
+struct Results {
+    int keys = 0;
+    int errors = 0;
+    double latency = 0;
+    int flashes = 0;
+};
+
+// Edits from what was typed to what was meant
+static int errors(const std::vector<Typed>& expected, const std::vector<Typed>& actual) {
+    std::vector<int> row(actual.size() + 1), next(actual.size() + 1);
+    for (size_t j = 0; j <= actual.size(); j++) row[j] = j;
+    for (size_t i = 1; i <= expected.size(); i++) {
+        next[0] = i;
+        for (size_t j = 1; j <= actual.size(); j++) {
+            int change = row[j - 1] + !(expected[i - 1] == actual[j - 1]);
+            next[j] = std::min(change, std::min(row[j], next[j - 1]) + 1);
+        }
+        std::swap(row, next);
+    }
+    return row[actual.size()];
+}
+
+static Results run(Trace trace) {
+    std::stable_sort(trace.events.begin(), trace.events.end(),
+        [](const Trace::Event& a, const Trace::Event& b) { return a.time < b.time; });
+    uint16_t start = now + 1000;
+    tick(start);
+    tick(start + 1);
+    reset_host();
+    // one event, or a tick, per scan
+    size_t next = 0;
+    for (uint32_t t = 0; t < trace.end + 1000; t++) {
+        if (next < trace.events.size() && trace.events[next].time <= t) {
+            const Trace::Event& e = trace.events[next++];
+            event(e.key, e.pressed, start + 2 + t);
+        } else {
+            tick(start + 2 + t);
+        }
+    }
+    Results r;
+    r.keys = trace.expected.size();
+    r.errors = errors(trace.expected, typed);
+    for (uint16_t latency : latencies) r.latency += latency;
+    r.latency = latencies.empty() ? 0 : r.latency / latencies.size();
+    r.flashes = flashes;
+    return r;
+}
+
+struct Setting {
+    const char* name;
+    uint8_t mods;
+    uint16_t typing_term;
+    uint16_t chord_term;
+};
+
+static void apply(const Setting& setting) {
+    speculative_hold_mods = setting.mods;
+    speculative_hold_typing_term = setting.typing_term;
+    speculative_hold_chord_term = setting.chord_term;
+}
+
+TEST(SpeculativeHoldBenchmark, typing_traces) {
+    const Setting settings[] = {
+        {"off", 0, SPECULATIVE_HOLD_TYPING_TERM, SPECULATIVE_HOLD_CHORD_TERM},
+        {"default", SPECULATIVE_HOLD_MODS, SPECULATIVE_HOLD_TYPING_TERM, SPECULATIVE_HOLD_CHORD_TERM},
+        {"chord term 80", SPECULATIVE_HOLD_MODS, SPECULATIVE_HOLD_TYPING_TERM, 80},
+        {"chord term 160", SPECULATIVE_HOLD_MODS, SPECULATIVE_HOLD_TYPING_TERM, 160},
+        {"typing term 0", SPECULATIVE_HOLD_MODS, 0, SPECULATIVE_HOLD_CHORD_TERM},
+        {"typing term 300", SPECULATIVE_HOLD_MODS, 300, SPECULATIVE_HOLD_CHORD_TERM},
+    };
+    printf("%-16s %8s %10s %8s %8s %10s %8s\n",
+        "setting", "text err", "text lat", "flashes",
+        "cut err", "cut lat", "flashes");
+    Results off_text, off_cuts, default_text, default_cuts;
+    for (const Setting& setting : settings) {
+        apply(setting);
+        Results text = run(text_trace(300, 1));
+        Results cuts = run(shortcut_trace(100, 2));
+        printf("%-16s %3d/%-4d %8.1fms %8d %3d/%-4d %8.1fms %8d\n",
+            setting.name,
+            text.errors, text.keys, text.latency, text.flashes,
+            cuts.errors, cuts.keys, cuts.latency, cuts.flashes);
+        if (&setting == &settings[0]) {
+            off_text = text;
+            off_cuts = cuts;
+        } else if (&setting == &settings[1]) {
+            default_text = text;
+            default_cuts = cuts;
+        }
+    }
+    EXPECT_EQ(default_text.errors, off_text.errors);
+    EXPECT_LE(default_cuts.errors, off_cuts.errors);
+    EXPECT_LT(default_cuts.latency, off_cuts.latency);
+}
@@ -0,0 +1,283 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <map>
+#include <random>
+extern "C" {
+#include "split/split_sync.h"
+}
+
+using testing::ElementsAreArray;
+
+class SplitSync : public testing::Test {
+public:
+    SplitSync() {
+        split_sync_slave_init(&slave);
+        split_sync_master_init(&master);
+        memset(rows, 0, sizeof(rows));
+    }
+
+    std::vector<uint8_t> slave_send() {
+        uint8_t buffer[SPLIT_SYNC_ROWS_SIZE];
+        uint8_t size = split_sync_encode_rows(&slave, rows, buffer);
+        EXPECT_LE(size, SPLIT_SYNC_ROWS_SIZE);
+        return std::vector<uint8_t>(buffer, buffer + size);
+    }
+
+    bool master_receive(const std::vector<uint8_t>& message) {
+        return split_sync_decode_rows(&master, message.data(), message.size());
+    }
+
+    std::vector<uint8_t> master_send() {
+        uint8_t buffer[SPLIT_SYNC_MASTER_SIZE];
+        uint8_t size = split_sync_encode_master(&master, &master_state, buffer);
+        return std::vector<uint8_t>(buffer, buffer + size);
+    }
+
+    void slave_receive(const std::vector<uint8_t>& message) {
+        EXPECT_TRUE(split_sync_decode_master(&slave, message.data(), message.size(), &slave_state));
+    }
+
+    // A complete exchange without any losses
+    void exchange() {
+        master_receive(slave_send());
+        slave_receive(master_send());
+    }
+
+    split_sync_slave_t slave;
+    split_sync_master_t master;
+    matrix_row_t rows[SPLIT_SYNC_ROWS];
+    split_master_state_t master_state = {};
+    split_master_state_t slave_state = {};
+};
+
+TEST_F(SplitSync, first_message_is_a_reset_keyframe) {
+    rows[0] = 0x123;
+    rows[3] = 0x801;
+    std::vector<uint8_t> message = slave_send();
+    ASSERT_EQ(message.size(), SPLIT_SYNC_ROWS_SIZE);
+    EXPECT_EQ(message[0], SPLIT_SYNC_KEYFRAME | SPLIT_SYNC_RESET);
+    EXPECT_TRUE(master_receive(message));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, nothing_is_sent_when_nothing_changed) {
+    exchange();
+    std::vector<uint8_t> message = slave_send();
+    EXPECT_EQ(message.size(), 3);
+    EXPECT_EQ(message[0], 0);
+    EXPECT_TRUE(master_receive(message));
+}
+
+TEST_F(SplitSync, only_changed_rows_are_sent) {
+    exchange();
+    rows[2] = 0x0F0;
+    std::vector<uint8_t> message = slave_send();
+    uint8_t expected[] = {0, 2, 1, 2, 0xF0, 0x00};
+    EXPECT_THAT(message, ElementsAreArray(expected));
+    EXPECT_TRUE(master_receive(message));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, lost_message_is_corrected_by_the_next) {
+    exchange();
+    rows[1] = 1;
+    slave_send();
+    slave_receive(master_send());
+    rows[2] = 2;
+    EXPECT_TRUE(master_receive(slave_send()));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, lost_acknowledgement_resends_the_changes) {
+    exchange();
+    rows[1] = 1;
+    master_receive(slave_send());
+    // The acknowledgement is lost, so the slave still assumes the old state
+    rows[2] = 2;
+    std::vector<uint8_t> message = slave_send();
+    EXPECT_EQ(message.size(), 3 + 2 * (1 + sizeof(matrix_row_t)));
+    EXPECT_TRUE(master_receive(message));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, older_message_is_dropped) {
+    exchange();
+    rows[1] = 1;
+    std::vector<uint8_t> first = slave_send();
+    rows[1] = 3;
+    std::vector<uint8_t> second = slave_send();
+    EXPECT_TRUE(master_receive(second));
+    EXPECT_FALSE(master_receive(first));
+    EXPECT_EQ(master.rows[1], 3);
+}
+
+TEST_F(SplitSync, older_keyframe_is_dropped) {
+    exchange();
+    split_sync_master_init(&master);
+    slave_receive(master_send());
+    rows[0] = 5;
+    std::vector<uint8_t> keyframe = slave_send();
+    ASSERT_EQ(keyframe[0], SPLIT_SYNC_KEYFRAME);
+    rows[0] = 6;
+    master_receive(slave_send());
+    slave_receive(master_send());
+    rows[0] = 7;
+    EXPECT_TRUE(master_receive(slave_send()));
+    EXPECT_FALSE(master_receive(keyframe));
+    EXPECT_EQ(master.rows[0], 7);
+}
+
+TEST_F(SplitSync, delta_without_the_base_requests_a_keyframe) {
+    exchange();
+    rows[0] = 1;
+    // The master never sees this, but acknowledges it anyway
+    slave_send();
+    slave_receive({SPLIT_SYNC_SYNCED, slave.seq, 0, 0, 0, 0, 0});
+    rows[1] = 2;
+    EXPECT_FALSE(master_receive(slave_send()));
+    EXPECT_FALSE(master.synced);
+    slave_receive(master_send());
+    std::vector<uint8_t> message = slave_send();
+    EXPECT_EQ(message[0], SPLIT_SYNC_KEYFRAME);
+    EXPECT_TRUE(master_receive(message));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, keyframes_are_sent_periodically) {
+    exchange();
+    for (int i = 1; i < SPLIT_SYNC_KEYFRAME_INTERVAL; i++) {
+        std::vector<uint8_t> message = slave_send();
+        EXPECT_EQ(message[0], 0);
+        master_receive(message);
+        slave_receive(master_send());
+    }
+    EXPECT_EQ(slave_send()[0], SPLIT_SYNC_KEYFRAME);
+}
+
+TEST_F(SplitSync, idle_rows_stay_unchanged_when_the_sequence_wraps) {
+    rows[1] = 0x010;
+    exchange();
+    int keyframes = 0;
+    for (int i = 0; i < 300; i++) {
+        std::vector<uint8_t> message = slave_send();
+        if (message[0] & SPLIT_SYNC_KEYFRAME) {
+            keyframes++;
+        } else {
+            EXPECT_EQ(message.size(), 3) << "exchange " << i;
+        }
+        EXPECT_TRUE(master_receive(message));
+        slave_receive(master_send());
+    }
+    EXPECT_EQ(keyframes, 300 / SPLIT_SYNC_KEYFRAME_INTERVAL);
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, old_acknowledgement_sends_a_keyframe) {
+    exchange();
+    for (int i = 0; i < SPLIT_SYNC_MAX_DELTA - 1; i++) {
+        EXPECT_EQ(slave_send()[0], 0);
+    }
+    EXPECT_EQ(slave_send()[0], SPLIT_SYNC_KEYFRAME);
+}
+
+TEST_F(SplitSync, restarted_slave_is_accepted) {
+    for (int i = 0; i < 10; i++) {
+        exchange();
+    }
+    split_sync_slave_init(&slave);
+    rows[3] = 0xFFF;
+    std::vector<uint8_t> message = slave_send();
+    EXPECT_TRUE(master_receive(message));
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, acknowledgement_from_before_a_restart_is_ignored) {
+    for (int i = 0; i < 10; i++) {
+        exchange();
+    }
+    split_sync_slave_init(&slave);
+    std::vector<uint8_t> stale_ack = master_send();
+    slave_send();
+    slave_receive(stale_ack);
+    EXPECT_FALSE(slave.ack_valid);
+}
+
+TEST_F(SplitSync, master_state_is_sent_to_the_slave) {
+    master_state.layer_state = 0x80000005;
+    master_state.leds = 0x3;
+    exchange();
+    EXPECT_EQ(slave_state.layer_state, 0x80000005);
+    EXPECT_EQ(slave_state.leds, 0x3);
+}
+
+TEST_F(SplitSync, invalid_row_index_is_rejected) {
+    exchange();
+    uint8_t message[] = {0, 2, 1, SPLIT_SYNC_ROWS, 0xFF, 0xFF};
+    EXPECT_FALSE(split_sync_decode_rows(&master, message, sizeof(message)));
+}
+
+TEST_F(SplitSync, recovers_from_random_loss_and_reordering) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> row(0, SPLIT_SYNC_ROWS - 1);
+    std::uniform_int_distribution<int> bit(0, MATRIX_COLS - 1);
+
+    // The slave rows at each sequence number, the master must always match
+    // one of them
+    std::map<uint8_t, std::vector<matrix_row_t>> history;
+    std::vector<uint8_t> delayed_rows;
+    std::vector<uint8_t> delayed_ack;
+
+    for (int i = 0; i < 5000; i++) {
+        if (percent(rng) < 30) {
+            rows[row(rng)] ^= 1 << bit(rng);
+        }
+        std::vector<uint8_t> message = slave_send();
+        history[slave.seq] = std::vector<matrix_row_t>(rows, rows + SPLIT_SYNC_ROWS);
+
+        int fate = percent(rng);
+        if (fate < 20) {
+            // Lost
+        } else if (fate < 30) {
+            // Delivered after the next message
+            std::swap(message, delayed_rows);
+            if (!message.empty()) {
+                master_receive(message);
+            }
+        } else {
+            master_receive(message);
+            if (!delayed_rows.empty()) {
+                master_receive(delayed_rows);
+                delayed_rows.clear();
+            }
+        }
+        if (master.synced) {
+            ASSERT_THAT(master.rows, ElementsAreArray(history[master.seq]));
+        }
+
+        std::vector<uint8_t> ack = master_send();
+        fate = percent(rng);
+        if (fate < 20) {
+        } else if (fate < 30) {
+            std::swap(ack, delayed_ack);
+            if (!ack.empty()) {
+                slave_receive(ack);
+            }
+        } else {
+            slave_receive(ack);
+        }
+    }
+
+    // Everything is back in sync after a few clean exchanges
+    for (int i = 0; i < 3; i++) {
+        exchange();
+    }
+    master_receive(slave_send());
+    EXPECT_THAT(master.rows, ElementsAreArray(rows));
+}
+
+TEST_F(SplitSync, the_message_sizes_match_the_rows) {
+    EXPECT_EQ(SPLIT_SYNC_ROW_BYTES, sizeof(matrix_row_t));
+    EXPECT_EQ(SPLIT_SYNC_ROWS_SIZE, 3 + SPLIT_SYNC_ROWS * sizeof(matrix_row_t));
+}
@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <deque>
+extern "C" {
+#include "split/split_transport.h"
+}
+
+using testing::ElementsAreArray;
+
+class SplitTransport : public testing::Test {
+public:
+    SplitTransport() {
+        Instance = this;
+        time = 0;
+    }
+
+    ~SplitTransport() {
+        Instance = nullptr;
+    }
+
+    // Runs a master poll and returns what was sent to the slave
+    std::vector<uint8_t> master_poll(const std::vector<uint8_t>& data) {
+        sent.clear();
+        split_transport_master_poll(data.data(), data.size());
+        return sent;
+    }
+
+    // Runs a slave that receives the frame, and returns its answer
+    std::vector<uint8_t> slave_answer(const std::vector<uint8_t>& frame, const std::vector<uint8_t>& data) {
+        split_transport_init(false);
+        receive(frame);
+        sent.clear();
+        EXPECT_TRUE(split_transport_slave_task());
+        split_transport_slave_answer(data.data(), data.size());
+        return sent;
+    }
+
+    void receive(const std::vector<uint8_t>& data) {
+        incoming.insert(incoming.end(), data.begin(), data.end());
+    }
+
+    std::vector<uint8_t> read() {
+        uint8_t buffer[SPLIT_TRANSPORT_MAX_PAYLOAD];
+        uint8_t size = split_transport_read(buffer, sizeof(buffer));
+        return std::vector<uint8_t>(buffer, buffer + size);
+    }
+
+    std::vector<uint8_t> sent;
+    std::deque<uint8_t> incoming;
+    uint16_t time;
+
+    static SplitTransport* Instance;
+};
+
+SplitTransport* SplitTransport::Instance = nullptr;
+
+extern "C" {
+void split_phy_init(void) {
+}
+
+int16_t split_phy_recv(void) {
+    auto& incoming = SplitTransport::Instance->incoming;
+    if (incoming.empty()) {
+        return -1;
+    }
+    uint8_t data = incoming.front();
+    incoming.pop_front();
+    return data;
+}
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    EXPECT_EQ(link, SPLIT_LINK);
+    auto& sent = SplitTransport::Instance->sent;
+    sent.insert(sent.end(), data, data + size);
+}
+
+uint16_t timer_read(void) {
+    return SplitTransport::Instance->time;
+}
+
+uint16_t timer_elapsed(uint16_t last) {
+    return SplitTransport::Instance->time - last;
+}
+}
+
+TEST_F(SplitTransport, master_polls_when_nothing_was_sent) {
+    split_transport_init(true);
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_IDLE);
+}
+
+TEST_F(SplitTransport, master_poll_is_framed) {
+    split_transport_init(true);
+    split_transport_master_poll(nullptr, 0);
+    // Type byte, CRC and the COBS overhead
+    EXPECT_EQ(sent.size(), 7);
+    EXPECT_EQ(sent.back(), 0);
+}
+
+TEST_F(SplitTransport, slave_receives_the_poll_data) {
+    split_transport_init(true);
+    std::vector<uint8_t> master_data = {7, 0, 9};
+    std::vector<uint8_t> poll = master_poll(master_data);
+
+    std::vector<uint8_t> answer = slave_answer(poll, {1, 2, 0, 4});
+    EXPECT_FALSE(answer.empty());
+    EXPECT_THAT(read(), ElementsAreArray(master_data));
+}
+
+TEST_F(SplitTransport, slave_has_nothing_to_answer_without_a_poll) {
+    split_transport_init(false);
+    EXPECT_FALSE(split_transport_slave_task());
+}
+
+TEST_F(SplitTransport, master_receives_the_answer) {
+    split_transport_init(true);
+    std::vector<uint8_t> slave_data = {1, 2, 0, 4};
+    std::vector<uint8_t> answer = slave_answer(master_poll({}), slave_data);
+
+    split_transport_init(true);
+    master_poll({});
+    receive(answer);
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_RECEIVED);
+    EXPECT_THAT(read(), ElementsAreArray(slave_data));
+}
+
+TEST_F(SplitTransport, master_waits_for_the_answer_until_the_timeout) {
+    split_transport_init(true);
+    master_poll({});
+    time = SPLIT_TRANSPORT_TIMEOUT - 1;
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_PENDING);
+    time = SPLIT_TRANSPORT_TIMEOUT;
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_TIMEOUT);
+}
+
+TEST_F(SplitTransport, answer_is_only_reported_once) {
+    split_transport_init(true);
+    std::vector<uint8_t> answer = slave_answer(master_poll({}), {3});
+
+    split_transport_init(true);
+    master_poll({});
+    receive(answer);
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_RECEIVED);
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_IDLE);
+}
+
+TEST_F(SplitTransport, corrupted_poll_is_ignored) {
+    split_transport_init(true);
+    std::vector<uint8_t> poll = master_poll({5, 6});
+    poll[2] ^= 0x10;
+
+    split_transport_init(false);
+    receive(poll);
+    EXPECT_FALSE(split_transport_slave_task());
+}
+
+TEST_F(SplitTransport, master_ignores_its_own_frames) {
+    split_transport_init(true);
+    receive(master_poll({5, 6}));
+    EXPECT_EQ(split_transport_master_task(), SPLIT_POLL_PENDING);
+}
+
+TEST_F(SplitTransport, read_is_limited_to_the_buffer_size) {
+    split_transport_init(true);
+    std::vector<uint8_t> answer = slave_answer(master_poll({}), {1, 2, 3});
+
+    split_transport_init(true);
+    master_poll({});
+    receive(answer);
+    split_transport_master_task();
+    uint8_t buffer[2] = {};
+    EXPECT_EQ(split_transport_read(buffer, 2), 3);
+    EXPECT_EQ(buffer[0], 1);
+    EXPECT_EQ(buffer[1], 2);
+}
+
+TEST_F(SplitTransport, a_payload_that_is_too_long_is_not_sent) {
+    split_transport_init(true);
+    std::vector<uint8_t> data(SPLIT_TRANSPORT_MAX_PAYLOAD + 1, 0x55);
+    EXPECT_TRUE(master_poll(data).empty());
+    data.pop_back();
+    EXPECT_FALSE(master_poll(data).empty());
+}
@@ -0,0 +1,19 @@
+TEST_LIST +=\
+	quantum_ws2812_spi\
+	quantum_rgblight_animation\
+	quantum_rgblight_reactive\
+	quantum_split_transport\
+	quantum_split_sync\
+	quantum_twi_queue\
+	quantum_expander_matrix\
+	quantum_matrix_ports\
+	quantum_matrix_settle\
+	quantum_profile\
+	quantum_matrix_ghost\
+	quantum_mousekey\
+	quantum_mouse_motion\
+	quantum_action_tapping\
+	quantum_speculative_hold\
+	quantum_source_layers\
+	quantum_source_layers_nibble\
+	quantum_source_layers_packed
\ No newline at end of file
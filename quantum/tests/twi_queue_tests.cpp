@@ -0,0 +1,401 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <string>
+#include <cstdio>
+extern "C" {
+#include "twi_queue.h"
+}
+
+using testing::ElementsAreArray;
+
+#define DEVICE_ADDRESS 0x20
+#define GPIOA 0x12
+#define GPIOB 0x13
+
+// A model of the TWI hardware with an MCP23018 on the bus, wired like the
+// Ergodox EZ, rows on GPIOA and columns on GPIOB
+class TwiQueue : public testing::Test {
+public:
+    TwiQueue() {
+        Instance = this;
+        memset(registers, 0xFF, sizeof(registers));
+        memset(pressed, 0, sizeof(pressed));
+        memset(transactions, 0, sizeof(transactions));
+    }
+
+    ~TwiQueue() {
+        // Nothing may point to the transactions of this test anymore
+        twi_queue_reset();
+        Instance = nullptr;
+    }
+
+    // What the hardware does after each action of the state machine
+    void apply(twi_action_t action, uint8_t data) {
+        if (action == TWI_ACTION_IDLE) {
+            return;
+        }
+        has_event = true;
+        switch (action) {
+        case TWI_ACTION_IDLE:
+            break;
+        case TWI_ACTION_STOP_START:
+            stop();
+            // Fall through
+        case TWI_ACTION_START:
+            trace += bus_held ? "Sr " : "S ";
+            event = bus_held ? TWI_STATUS_REP_START : TWI_STATUS_START;
+            bus_held = true;
+            expect_address = true;
+            break;
+        case TWI_ACTION_WRITE:
+            write(data);
+            break;
+        case TWI_ACTION_READ_ACK:
+        case TWI_ACTION_READ_NACK:
+            event_data = read();
+            trace += action == TWI_ACTION_READ_ACK ? "rA " : "rN ";
+            event = action == TWI_ACTION_READ_ACK ?
+                TWI_STATUS_MR_DATA_ACK : TWI_STATUS_MR_DATA_NACK;
+            break;
+        case TWI_ACTION_STOP:
+            stop();
+            has_event = false;
+            break;
+        }
+        if (has_event && fail_next >= 0) {
+            event = fail_next;
+            fail_next = -1;
+        }
+    }
+
+    void stop() {
+        trace += "P ";
+        bus_held = false;
+        stops++;
+    }
+
+    void write(uint8_t data) {
+        char byte[4];
+        snprintf(byte, sizeof(byte), "%02X ", data);
+        trace += byte;
+        if (expect_address) {
+            expect_address = false;
+            bool present = device_present && (data >> 1) == DEVICE_ADDRESS;
+            if (data & 1) {
+                event = present ? TWI_STATUS_MR_SLA_ACK : TWI_STATUS_MR_SLA_NACK;
+            } else {
+                event = present ? TWI_STATUS_MT_SLA_ACK : TWI_STATUS_MT_SLA_NACK;
+                first_byte = true;
+            }
+        } else {
+            // The first byte selects the register, the rest are written to
+            // consecutive registers
+            if (first_byte) {
+                pointer = data;
+                first_byte = false;
+            } else {
+                registers[pointer++] = data;
+            }
+            event = TWI_STATUS_MT_DATA_ACK;
+        }
+    }
+
+    uint8_t read() {
+        if (pointer == GPIOB) {
+            // The selected rows are pulled low, and the pressed keys pull
+            // the columns low
+            uint8_t cols = 0;
+            for (int row = 0; row < 8; row++) {
+                if (!(registers[GPIOA] & (1 << row))) {
+                    cols |= pressed[row];
+                }
+            }
+            pointer++;
+            return ~cols;
+        }
+        return registers[pointer++];
+    }
+
+    // Delivers the next interrupt, returns false if there's nothing to do
+    bool step() {
+        if (!has_event || stalled) {
+            return false;
+        }
+        has_event = false;
+        uint8_t out = 0;
+        twi_action_t action = twi_queue_event(event, event_data, &out);
+        apply(action, out);
+        return true;
+    }
+
+    void run() {
+        while (step()) {
+        }
+    }
+
+    bool submit(twi_transaction_t* transaction) {
+        return twi_queue_submit(transaction);
+    }
+
+    twi_transaction_t* write_transaction(int index, const uint8_t* data, uint8_t size) {
+        twi_transaction_t* t = &transactions[index];
+        t->address = DEVICE_ADDRESS;
+        t->write_data = data;
+        t->write_length = size;
+        return t;
+    }
+
+    twi_transaction_t* read_transaction(int index, const uint8_t* reg, uint8_t* data, uint8_t size) {
+        twi_transaction_t* t = &transactions[index];
+        t->address = DEVICE_ADDRESS;
+        t->write_data = reg;
+        t->write_length = reg ? 1 : 0;
+        t->read_data = data;
+        t->read_length = size;
+        return t;
+    }
+
+    uint8_t registers[256];
+    uint8_t pressed[8];
+    twi_transaction_t transactions[TWI_QUEUE_SIZE];
+
+    bool device_present = true;
+    // Stops the interrupts, like a slave holding the clock forever
+    bool stalled = false;
+    // Replaces the status of the next event
+    int fail_next = -1;
+
+    std::string trace;
+    int stops = 0;
+    int resets = 0;
+    uint16_t time = 0;
+
+    bool bus_held = false;
+    bool expect_address = false;
+    bool first_byte = false;
+    uint8_t pointer = 0;
+    bool has_event = false;
+    uint8_t event = 0;
+    uint8_t event_data = 0;
+
+    static TwiQueue* Instance;
+};
+
+TwiQueue* TwiQueue::Instance = nullptr;
+
+extern "C" {
+void twi_phy_init(void) {
+}
+
+void twi_phy_kick(void) {
+    TwiQueue::Instance->apply(twi_queue_kick(), 0);
+}
+
+void twi_phy_reset(void) {
+    TwiQueue::Instance->resets++;
+    TwiQueue::Instance->bus_held = false;
+    TwiQueue::Instance->has_event = false;
+    twi_queue_reset();
+}
+
+// The interrupts happen while twi_queue_wait is polling the timer, and the
+// time only passes when the bus is idle or stalled
+uint16_t timer_read(void) {
+    if (!TwiQueue::Instance->step()) {
+        TwiQueue::Instance->time++;
+    }
+    return TwiQueue::Instance->time;
+}
+}
+
+TEST_F(TwiQueue, nothing_happens_when_nothing_is_queued) {
+    EXPECT_EQ(twi_queue_kick(), TWI_ACTION_IDLE);
+    EXPECT_FALSE(twi_queue_busy());
+}
+
+TEST_F(TwiQueue, write_is_sent) {
+    const uint8_t data[] = {GPIOA, 0xFE};
+    twi_transaction_t* t = write_transaction(0, data, sizeof(data));
+    EXPECT_TRUE(submit(t));
+    EXPECT_TRUE(twi_queue_busy());
+    EXPECT_EQ(t->status, TWI_PENDING);
+    run();
+    EXPECT_EQ(t->status, TWI_DONE);
+    EXPECT_FALSE(twi_queue_busy());
+    EXPECT_EQ(trace, "S 40 12 FE P ");
+    EXPECT_EQ(registers[GPIOA], 0xFE);
+}
+
+TEST_F(TwiQueue, write_and_read_use_a_repeated_start) {
+    const uint8_t reg = GPIOB;
+    uint8_t data = 0;
+    registers[GPIOA] = 0xFD;
+    pressed[1] = 0x05;
+    twi_transaction_t* t = read_transaction(0, &reg, &data, 1);
+    submit(t);
+    EXPECT_TRUE(twi_queue_wait(t));
+    EXPECT_EQ(trace, "S 40 13 Sr 41 rN P ");
+    EXPECT_EQ(data, 0xFA);
+}
+
+TEST_F(TwiQueue, read_without_a_register_only_reads) {
+    uint8_t data[3] = {};
+    registers[0] = 1;
+    registers[1] = 2;
+    registers[2] = 3;
+    twi_transaction_t* t = read_transaction(0, nullptr, data, sizeof(data));
+    submit(t);
+    EXPECT_TRUE(twi_queue_wait(t));
+    EXPECT_EQ(trace, "S 41 rA rA rN P ");
+    uint8_t expected[] = {1, 2, 3};
+    EXPECT_THAT(data, ElementsAreArray(expected));
+}
+
+TEST_F(TwiQueue, queued_transactions_run_back_to_back) {
+    const uint8_t first[] = {0x00, 0xAA};
+    const uint8_t second[] = {0x01, 0x55};
+    twi_transaction_t* t1 = write_transaction(0, first, sizeof(first));
+    twi_transaction_t* t2 = write_transaction(1, second, sizeof(second));
+    submit(t1);
+    submit(t2);
+    EXPECT_TRUE(twi_queue_wait(t2));
+    EXPECT_EQ(t1->status, TWI_DONE);
+    EXPECT_EQ(trace, "S 40 00 AA P S 40 01 55 P ");
+    EXPECT_EQ(registers[0], 0xAA);
+    EXPECT_EQ(registers[1], 0x55);
+}
+
+TEST_F(TwiQueue, transaction_submitted_when_idle_starts_the_bus) {
+    const uint8_t data[] = {0x00, 0x01};
+    twi_transaction_t* t1 = write_transaction(0, data, sizeof(data));
+    twi_transaction_t* t2 = write_transaction(1, data, sizeof(data));
+    submit(t1);
+    run();
+    submit(t2);
+    run();
+    EXPECT_EQ(t2->status, TWI_DONE);
+    EXPECT_EQ(stops, 2);
+}
+
+TEST_F(TwiQueue, matrix_scan_reads_every_row) {
+    // The scan of the Ergodox EZ, select each row and read the columns, and
+    // unselect everything at the end
+    const int rows = 7;
+    uint8_t select[rows][2];
+    const uint8_t reg = GPIOB;
+    uint8_t cols[rows] = {};
+    const uint8_t unselect[] = {GPIOA, 0xFF};
+    for (int row = 0; row < rows; row++) {
+        select[row][0] = GPIOA;
+        select[row][1] = 0xFF & ~(1 << row);
+        pressed[row] = 1 << row;
+        submit(write_transaction(row * 2, select[row], 2));
+        submit(read_transaction(row * 2 + 1, &reg, &cols[row], 1));
+    }
+    twi_transaction_t* last = write_transaction(rows * 2, unselect, sizeof(unselect));
+    submit(last);
+    EXPECT_TRUE(twi_queue_wait(last));
+    for (int row = 0; row < rows; row++) {
+        EXPECT_EQ(transactions[row * 2].status, TWI_DONE);
+        EXPECT_EQ(transactions[row * 2 + 1].status, TWI_DONE);
+        EXPECT_EQ((uint8_t)~cols[row], 1 << row);
+    }
+    EXPECT_EQ(registers[GPIOA], 0xFF);
+    EXPECT_EQ(stops, rows * 2 + 1);
+}
+
+TEST_F(TwiQueue, missing_device_fails_only_that_transaction) {
+    const uint8_t data[] = {0x00, 0x01};
+    twi_transaction_t* t1 = write_transaction(0, data, sizeof(data));
+    twi_transaction_t* t2 = write_transaction(1, data, sizeof(data));
+    t2->address = DEVICE_ADDRESS + 1;
+    twi_transaction_t* t3 = write_transaction(2, data, sizeof(data));
+    submit(t1);
+    submit(t2);
+    submit(t3);
+    EXPECT_TRUE(twi_queue_wait(t3));
+    EXPECT_EQ(t1->status, TWI_DONE);
+    EXPECT_EQ(t2->status, TWI_ERROR);
+    EXPECT_EQ(trace, "S 40 00 01 P S 42 P S 40 00 01 P ");
+}
+
+TEST_F(TwiQueue, read_address_not_acknowledged_fails) {
+    uint8_t data = 0;
+    device_present = false;
+    twi_transaction_t* t = read_transaction(0, nullptr, &data, 1);
+    submit(t);
+    EXPECT_FALSE(twi_queue_wait(t));
+    EXPECT_EQ(t->status, TWI_ERROR);
+    EXPECT_EQ(trace, "S 41 P ");
+    EXPECT_FALSE(twi_queue_busy());
+}
+
+TEST_F(TwiQueue, bus_error_fails_the_transaction) {
+    const uint8_t data[] = {0x00, 0x01};
+    twi_transaction_t* t1 = write_transaction(0, data, sizeof(data));
+    twi_transaction_t* t2 = write_transaction(1, data, sizeof(data));
+    submit(t1);
+    submit(t2);
+    fail_next = TWI_STATUS_BUS_ERROR;
+    EXPECT_TRUE(twi_queue_wait(t2));
+    EXPECT_EQ(t1->status, TWI_ERROR);
+}
+
+TEST_F(TwiQueue, lost_arbitration_fails_the_transaction) {
+    const uint8_t reg = GPIOB;
+    uint8_t data = 0;
+    twi_transaction_t* t = read_transaction(0, &reg, &data, 1);
+    submit(t);
+    // The start and the address go through
+    step();
+    fail_next = TWI_STATUS_ARB_LOST;
+    EXPECT_FALSE(twi_queue_wait(t));
+    EXPECT_FALSE(twi_queue_busy());
+}
+
+TEST_F(TwiQueue, full_queue_is_rejected) {
+    const uint8_t data[] = {0x00, 0x01};
+    stalled = true;
+    for (int i = 0; i < TWI_QUEUE_SIZE - 1; i++) {
+        EXPECT_TRUE(submit(write_transaction(i, data, sizeof(data))));
+    }
+    twi_transaction_t extra = {};
+    EXPECT_FALSE(submit(&extra));
+}
+
+TEST_F(TwiQueue, timeout_resets_the_bus_and_fails_everything_queued) {
+    const uint8_t data[] = {0x00, 0x01};
+    twi_transaction_t* t1 = write_transaction(0, data, sizeof(data));
+    twi_transaction_t* t2 = write_transaction(1, data, sizeof(data));
+    submit(t1);
+    submit(t2);
+    stalled = true;
+    EXPECT_FALSE(twi_queue_wait(t1));
+    EXPECT_GT(time, TWI_QUEUE_TIMEOUT);
+    EXPECT_EQ(resets, 1);
+    EXPECT_EQ(t1->status, TWI_ERROR);
+    EXPECT_EQ(t2->status, TWI_ERROR);
+    EXPECT_FALSE(twi_queue_busy());
+
+    // And the queue works again after that
+    stalled = false;
+    trace.clear();
+    submit(t1);
+    EXPECT_TRUE(twi_queue_wait(t1));
+    EXPECT_EQ(trace, "S 40 00 01 P ");
+}
+
+TEST_F(TwiQueue, select_and_read_in_one_transaction) {
+    // Writing GPIOA moves the address pointer on to GPIOB, so the row can be
+    // read with a repeated start right after selecting it
+    const uint8_t select[] = {GPIOA, 0xFB};
+    uint8_t cols = 0;
+    pressed[2] = 0x21;
+    pressed[3] = 0x02;
+    twi_transaction_t* t = read_transaction(0, select, &cols, 1);
+    t->write_length = sizeof(select);
+    submit(t);
+    EXPECT_TRUE(twi_queue_wait(t));
+    EXPECT_EQ(trace, "S 40 12 FB Sr 41 rN P ");
+    EXPECT_EQ(cols, (uint8_t)~0x21);
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+extern "C" {
+#include "ws2812_spi.h"
+}
+
+using testing::ElementsAreArray;
+
+// Decodes the SPI bit-stream back into WS2812 bits by measuring the high
+// time of each four bit symbol
+static std::vector<uint8_t> decode_waveform(const uint8_t* buffer, uint16_t size) {
+    std::vector<uint8_t> colors;
+    uint8_t color = 0;
+    unsigned bits = 0;
+    for (uint16_t i = 0; i < size * 8; i += 4) {
+        unsigned high_time = 0;
+        bool seen_low = false;
+        for (unsigned j = i; j < i + 4; j++) {
+            bool high = buffer[j / 8] & (0x80 >> (j % 8));
+            // The line should always start high and then go low exactly once
+            EXPECT_FALSE(high && seen_low);
+            if (high) {
+                high_time++;
+            } else {
+                seen_low = true;
+            }
+        }
+        EXPECT_TRUE(high_time == 1 || high_time == 3);
+        color = (color << 1) | (high_time == 3 ? 1 : 0);
+        if (++bits == 8) {
+            colors.push_back(color);
+            color = 0;
+            bits = 0;
+        }
+    }
+    return colors;
+}
+
+TEST(WS2812SPI, encodes_zero) {
+    uint8_t colors[] = {0x00};
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(1)];
+    EXPECT_EQ(ws2812_spi_encode(colors, 1, buffer), 4);
+    uint8_t expected[] = {0x88, 0x88, 0x88, 0x88};
+    EXPECT_THAT(buffer, ElementsAreArray(expected));
+}
+
+TEST(WS2812SPI, encodes_full_intensity) {
+    uint8_t colors[] = {0xFF};
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(1)];
+    EXPECT_EQ(ws2812_spi_encode(colors, 1, buffer), 4);
+    uint8_t expected[] = {0xEE, 0xEE, 0xEE, 0xEE};
+    EXPECT_THAT(buffer, ElementsAreArray(expected));
+}
+
+TEST(WS2812SPI, encodes_msb_first) {
+    uint8_t colors[] = {0xA5};
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(1)];
+    EXPECT_EQ(ws2812_spi_encode(colors, 1, buffer), 4);
+    uint8_t expected[] = {0xE8, 0xE8, 0x8E, 0x8E};
+    EXPECT_THAT(buffer, ElementsAreArray(expected));
+}
+
+TEST(WS2812SPI, encodes_a_grb_led) {
+    uint8_t colors[] = {0x80, 0x01, 0x3C};
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(3)];
+    EXPECT_EQ(ws2812_spi_encode(colors, 3, buffer), 12);
+    uint8_t expected[] = {
+        0xE8, 0x88, 0x88, 0x88,
+        0x88, 0x88, 0x88, 0x8E,
+        0x88, 0xEE, 0xEE, 0x88,
+    };
+    EXPECT_THAT(buffer, ElementsAreArray(expected));
+}
+
+TEST(WS2812SPI, waveform_decodes_to_the_original_data) {
+    uint8_t colors[256];
+    for (unsigned i = 0; i < sizeof(colors); i++) {
+        colors[i] = i;
+    }
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(sizeof(colors))];
+    uint16_t size = ws2812_spi_encode(colors, sizeof(colors), buffer);
+    EXPECT_EQ(size, sizeof(buffer));
+    EXPECT_THAT(decode_waveform(buffer, size), ElementsAreArray(colors));
+}
+
+TEST(WS2812SPI, does_not_write_past_the_encoded_size) {
+    uint8_t colors[] = {0xFF, 0xFF};
+    uint8_t buffer[WS2812_SPI_ENCODED_SIZE(2) + 1];
+    buffer[WS2812_SPI_ENCODED_SIZE(2)] = 0x55;
+    ws2812_spi_encode(colors, 2, buffer);
+    EXPECT_EQ(buffer[WS2812_SPI_ENCODED_SIZE(2)], 0x55);
+}
@@ -0,0 +1,116 @@
+#include "twi_queue.h"
+#include "timer.h"
+#include <stddef.h>
+
+static twi_transaction_t* queue[TWI_QUEUE_SIZE];
+// The head is only changed by twi_queue_submit, and the tail by the
+// interrupt when a transaction completes
+static volatile uint8_t head = 0;
+static volatile uint8_t tail = 0;
+static volatile bool busy = false;
+
+// The progress of the transaction at the tail
+static uint8_t position;
+static bool reading;
+
+static void begin(twi_transaction_t* transaction) {
+    position = 0;
+    // A transaction that only reads starts with the read address
+    reading = transaction->write_length == 0 && transaction->read_length > 0;
+}
+
+void twi_queue_init(void) {
+    twi_phy_init();
+}
+
+bool twi_queue_submit(twi_transaction_t* transaction) {
+    uint8_t next = (head + 1) & (TWI_QUEUE_SIZE - 1);
+    if (next == tail) {
+        return false;
+    }
+    transaction->status = TWI_PENDING;
+    queue[head] = transaction;
+    head = next;
+    twi_phy_kick();
+    return true;
+}
+
+bool twi_queue_wait(twi_transaction_t* transaction) {
+    uint16_t start = timer_read();
+    while (transaction->status == TWI_PENDING) {
+        if (TIMER_DIFF_16(timer_read(), start) > TWI_QUEUE_TIMEOUT) {
+            twi_phy_reset();
+            break;
+        }
+    }
+    return transaction->status == TWI_DONE;
+}
+
+bool twi_queue_busy(void) {
+    return busy;
+}
+
+twi_action_t twi_queue_kick(void) {
+    if (busy || head == tail) {
+        return TWI_ACTION_IDLE;
+    }
+    busy = true;
+    begin(queue[tail]);
+    return TWI_ACTION_START;
+}
+
+void twi_queue_reset(void) {
+    while (tail != head) {
+        queue[tail]->status = TWI_ERROR;
+        tail = (tail + 1) & (TWI_QUEUE_SIZE - 1);
+    }
+    busy = false;
+}
+
+static twi_action_t complete(twi_transaction_t* transaction, twi_status_t status) {
+    transaction->status = status;
+    tail = (tail + 1) & (TWI_QUEUE_SIZE - 1);
+    if (tail == head) {
+        busy = false;
+        return TWI_ACTION_STOP;
+    }
+    begin(queue[tail]);
+    return TWI_ACTION_STOP_START;
+}
+
+twi_action_t twi_queue_event(uint8_t status, uint8_t data, uint8_t* out) {
+    if (!busy) {
+        return TWI_ACTION_STOP;
+    }
+    twi_transaction_t* transaction = queue[tail];
+    switch (status) {
+    case TWI_STATUS_START:
+    case TWI_STATUS_REP_START:
+        *out = (transaction->address << 1) | (reading ? 1 : 0);
+        return TWI_ACTION_WRITE;
+    case TWI_STATUS_MT_SLA_ACK:
+    case TWI_STATUS_MT_DATA_ACK:
+        if (position < transaction->write_length) {
+            *out = transaction->write_data[position++];
+            return TWI_ACTION_WRITE;
+        }
+        if (transaction->read_length > 0) {
+            position = 0;
+            reading = true;
+            return TWI_ACTION_START;
+        }
+        return complete(transaction, TWI_DONE);
+    case TWI_STATUS_MR_DATA_ACK:
+        transaction->read_data[position++] = data;
+        // Fall through
+    case TWI_STATUS_MR_SLA_ACK:
+        return position + 1 < transaction->read_length ?
+            TWI_ACTION_READ_ACK : TWI_ACTION_READ_NACK;
+    case TWI_STATUS_MR_DATA_NACK:
+        transaction->read_data[position++] = data;
+        return complete(transaction, TWI_DONE);
+    default:
+        // Not acknowledged, lost arbitration or a bus error
+        return complete(transaction, TWI_ERROR);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef TWI_QUEUE_H
+#define TWI_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// A queue of I2C master transactions, executed by the TWI interrupt one bus
+// event at a time, so that the CPU can do something else while the bytes are
+// clocked out. Each transaction writes some bytes and then reads some bytes
+// with a repeated start, and the next one is started as soon as the previous
+// one has completed.
+//
+// The state machine here doesn't touch any hardware, it's driven by the TWI
+// status codes and tells the backend what to do next. twi_queue_avr.c is the
+// backend for the AVR TWI.
+
+// Must be a power of two
+#ifndef TWI_QUEUE_SIZE
+#define TWI_QUEUE_SIZE 16
+#endif
+
+// The bus frequency set by twi_queue_init
+#ifndef TWI_QUEUE_SCL_CLOCK
+#define TWI_QUEUE_SCL_CLOCK 400000L
+#endif
+
+// How long twi_queue_wait waits before giving up and resetting the bus
+#ifndef TWI_QUEUE_TIMEOUT
+#define TWI_QUEUE_TIMEOUT 5
+#endif
+
+// The TWI status codes, the same values as the AVR TWSR
+#define TWI_STATUS_BUS_ERROR    0x00
+#define TWI_STATUS_START        0x08
+#define TWI_STATUS_REP_START    0x10
+#define TWI_STATUS_MT_SLA_ACK   0x18
+#define TWI_STATUS_MT_SLA_NACK  0x20
+#define TWI_STATUS_MT_DATA_ACK  0x28
+#define TWI_STATUS_MT_DATA_NACK 0x30
+#define TWI_STATUS_ARB_LOST     0x38
+#define TWI_STATUS_MR_SLA_ACK   0x40
+#define TWI_STATUS_MR_SLA_NACK  0x48
+#define TWI_STATUS_MR_DATA_ACK  0x50
+#define TWI_STATUS_MR_DATA_NACK 0x58
+
+typedef enum {
+    TWI_PENDING,
+    TWI_DONE,
+    // The device didn't acknowledge, or the bus failed
+    TWI_ERROR,
+} twi_status_t;
+
+typedef struct {
+    // 7 bit address
+    uint8_t address;
+    uint8_t write_length;
+    uint8_t read_length;
+    const uint8_t* write_data;
+    uint8_t* read_data;
+    volatile uint8_t status;
+} twi_transaction_t;
+
+// Sets up the bus, not needed if it was already initialized by i2c_init
+void twi_queue_init(void);
+// Queues the transaction, which must stay valid until it has completed.
+// Returns false if the queue is full
+bool twi_queue_submit(twi_transaction_t* transaction);
+// Waits until the transaction has completed, for at most TWI_QUEUE_TIMEOUT
+// milliseconds. After a timeout the bus is reset, and every queued
+// transaction fails. Returns true if the transaction succeeded
+bool twi_queue_wait(twi_transaction_t* transaction);
+bool twi_queue_busy(void);
+
+// What the backend should do next
+typedef enum {
+    // Nothing, the bus is idle
+    TWI_ACTION_IDLE,
+    TWI_ACTION_START,
+    // Send the byte given by the state machine
+    TWI_ACTION_WRITE,
+    // Receive a byte and acknowledge it
+    TWI_ACTION_READ_ACK,
+    // Receive the last byte
+    TWI_ACTION_READ_NACK,
+    // Release the bus, no more events follow
+    TWI_ACTION_STOP,
+    // Release the bus and start the next transaction
+    TWI_ACTION_STOP_START,
+} twi_action_t;
+
+// For the backend, called with interrupts disabled. Returns TWI_ACTION_START
+// if the bus was idle and there's something queued
+twi_action_t twi_queue_kick(void);
+// For the backend, called after each bus event with the status, and the
+// received byte if any. The byte to send is stored in out
+twi_action_t twi_queue_event(uint8_t status, uint8_t data, uint8_t* out);
+// For the backend, fails every queued transaction and makes the bus idle
+void twi_queue_reset(void);
+
+// Implemented by the backend. Initializes the hardware
+void twi_phy_init(void);
+// Implemented by the backend. Starts the bus if it's idle, by calling
+// twi_queue_kick with the interrupts disabled
+void twi_phy_kick(void);
+// Implemented by the backend. Resets the hardware and calls twi_queue_reset
+void twi_phy_reset(void);
+
+#endif
@@ -0,0 +1,67 @@
+// Backend of the TWI queue for the AVR TWI. The bus is initialized by
+// twi_queue_init, or by i2c_init when it's shared with i2cmaster.
+//
+// The TWI interrupt is only enabled while the queue is running, so the
+// blocking i2cmaster functions can still be used when the queue is idle.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "twi_queue.h"
+
+static void apply(twi_action_t action, uint8_t data) {
+    switch (action) {
+    case TWI_ACTION_START:
+        TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+        break;
+    case TWI_ACTION_WRITE:
+        TWDR = data;
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+    case TWI_ACTION_READ_ACK:
+        TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE);
+        break;
+    case TWI_ACTION_READ_NACK:
+        TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWIE);
+        break;
+    case TWI_ACTION_STOP:
+        TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN);
+        break;
+    case TWI_ACTION_STOP_START:
+        // The TWI sends the stop and then the start when both are set
+        TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWSTA) | _BV(TWEN) | _BV(TWIE);
+        break;
+    case TWI_ACTION_IDLE:
+        break;
+    }
+}
+
+void twi_phy_init(void) {
+    // No prescaler
+    TWSR = 0;
+    TWBR = ((F_CPU / TWI_QUEUE_SCL_CLOCK) - 16) / 2;
+    TWCR = _BV(TWEN);
+}
+
+void twi_phy_kick(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // The stop of the previous transaction might still be on the bus,
+        // the start waits for it
+        apply(twi_queue_kick(), 0);
+    }
+}
+
+void twi_phy_reset(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // Disabling the TWI releases the bus and resets its state
+        TWCR = 0;
+        twi_queue_reset();
+        TWCR = _BV(TWEN);
+    }
+}
+
+ISR(TWI_vect) {
+    uint8_t data = TWDR;
+    uint8_t out = 0;
+    apply(twi_queue_event(TWSR & 0xF8, data, &out), out);
+}
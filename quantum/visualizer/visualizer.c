@@ -78,7 +78,7 @@ static bool visualizer_enabled = false;
 static keyframe_animation_t* animations[MAX_SIMULTANEOUS_ANIMATIONS] = {};
 
 #ifdef SERIAL_LINK_ENABLE
-MASTER_TO_ALL_SLAVES_OBJECT(current_status, visualizer_keyboard_status_t);
+RELIABLE_MASTER_TO_ALL_SLAVES_OBJECT(current_status, visualizer_keyboard_status_t);
 
 static remote_object_t* remote_objects[] = {
     REMOTE_OBJECT(current_status),
@@ -0,0 +1,78 @@
+/*
+ * WS2812 driver for ChibiOS boards
+ *
+ * The LED data is encoded into an SPI bit-stream which is sent by DMA, so
+ * the CPU is free to continue scanning while the LEDs are updated. Only the
+ * MOSI pin is used, and it should be connected to the data line of the
+ * first LED.
+ *
+ * The board has to set up the pin muxing for MOSI, and provide a
+ * ws2812_spi_config, which should clock the SPI at 3.2MHz, 8 bit frames,
+ * MSB first. Define WS2812_SPI in config.h to use another driver than SPID1.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "ch.h"
+#include "hal.h"
+#include "light_ws2812.h"
+#include "ws2812_spi.h"
+
+#ifndef WS2812_SPI
+#define WS2812_SPI SPID1
+#endif
+
+#ifdef RGBW
+#define WS2812_COLORS_PER_LED 4
+#else
+#define WS2812_COLORS_PER_LED 3
+#endif
+
+#define WS2812_BUFFER_SIZE \
+    (WS2812_SPI_ENCODED_SIZE(RGBLED_NUM * WS2812_COLORS_PER_LED) + WS2812_SPI_RESET_BYTES)
+
+extern const SPIConfig ws2812_spi_config;
+
+// The reset bytes at the end are never written, so they stay zero
+static uint8_t ws2812_buffer[WS2812_BUFFER_SIZE];
+static bool ws2812_started = false;
+
+void ws2812_sendarray(uint8_t *data, uint16_t datlen) {
+    if (!ws2812_started) {
+        spiStart(&WS2812_SPI, &ws2812_spi_config);
+        ws2812_started = true;
+    }
+    if (datlen > RGBLED_NUM * WS2812_COLORS_PER_LED) {
+        datlen = RGBLED_NUM * WS2812_COLORS_PER_LED;
+    }
+    // The previous frame is still being sent, this only happens if the LEDs
+    // are updated faster than they can be clocked out.
+    while (WS2812_SPI.state != SPI_READY) {
+        chThdSleep(1);
+    }
+    uint16_t size = ws2812_spi_encode(data, datlen, ws2812_buffer);
+    // The reset bytes are always sent from the end of the buffer, but when
+    // fewer LEDs than RGBLED_NUM are updated they have to be moved down
+    if (size + WS2812_SPI_RESET_BYTES < WS2812_BUFFER_SIZE) {
+        memset(ws2812_buffer + size, 0, WS2812_SPI_RESET_BYTES);
+    }
+    spiStartSend(&WS2812_SPI, size + WS2812_SPI_RESET_BYTES, ws2812_buffer);
+}
+
+void ws2812_sendarray_mask(uint8_t *data, uint16_t datlen, uint8_t pinmask) {
+    (void)pinmask;
+    ws2812_sendarray(data, datlen);
+}
+
+void ws2812_setleds(LED_TYPE *ledarray, uint16_t leds) {
+    ws2812_sendarray((uint8_t*)ledarray, leds * 3);
+}
+
+void ws2812_setleds_pin(LED_TYPE *ledarray, uint16_t leds, uint8_t pinmask) {
+    (void)pinmask;
+    ws2812_setleds(ledarray, leds);
+}
+
+void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t leds) {
+    ws2812_sendarray((uint8_t*)ledarray, leds << 2);
+}
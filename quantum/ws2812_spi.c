@@ -0,0 +1,24 @@
+#include "ws2812_spi.h"
+
+#define WS2812_SPI_SYMBOL(bit) ((bit) ? WS2812_SPI_SYMBOL_ONE : WS2812_SPI_SYMBOL_ZERO)
+#define WS2812_SPI_SYMBOL_PAIR(bits) \
+    ((WS2812_SPI_SYMBOL((bits) & 2) << 4) | WS2812_SPI_SYMBOL((bits) & 1))
+
+// Two WS2812 bits fit into one SPI byte
+static const uint8_t ws2812_spi_symbol_pairs[] = {
+    WS2812_SPI_SYMBOL_PAIR(0),
+    WS2812_SPI_SYMBOL_PAIR(1),
+    WS2812_SPI_SYMBOL_PAIR(2),
+    WS2812_SPI_SYMBOL_PAIR(3),
+};
+
+uint16_t ws2812_spi_encode(const uint8_t* colors, uint16_t length, uint8_t* buffer) {
+    for (uint16_t i = 0; i < length; i++) {
+        uint8_t color = colors[i];
+        *buffer++ = ws2812_spi_symbol_pairs[(color >> 6) & 3];
+        *buffer++ = ws2812_spi_symbol_pairs[(color >> 4) & 3];
+        *buffer++ = ws2812_spi_symbol_pairs[(color >> 2) & 3];
+        *buffer++ = ws2812_spi_symbol_pairs[color & 3];
+    }
+    return WS2812_SPI_ENCODED_SIZE(length);
+}
@@ -0,0 +1,36 @@
+#ifndef WS2812_SPI_H
+#define WS2812_SPI_H
+
+#include <stdint.h>
+
+// Encodes WS2812 data as an SPI bit-stream, so that it can be clocked out
+// by DMA instead of cycle counted bit-banging.
+//
+// Every WS2812 bit is sent as four SPI bits, so the SPI clock should be
+// set as close to 3.2MHz as possible. That gives a bit time of 1.25us, with
+// a 0.31us high time for a zero and a 0.94us high time for a one.
+
+#ifndef WS2812_SPI_SYMBOL_ZERO
+#define WS2812_SPI_SYMBOL_ZERO 0x8
+#endif
+
+#ifndef WS2812_SPI_SYMBOL_ONE
+#define WS2812_SPI_SYMBOL_ONE 0xE
+#endif
+
+// Number of SPI bytes needed for each color byte
+#define WS2812_SPI_BYTES_PER_COLOR 4
+
+// The line needs to stay low for at least 50us (280us for newer WS2812B)
+// to latch the data, at 3.2MHz that's 112 bytes
+#ifndef WS2812_SPI_RESET_BYTES
+#define WS2812_SPI_RESET_BYTES 112
+#endif
+
+#define WS2812_SPI_ENCODED_SIZE(num_colors) ((num_colors) * WS2812_SPI_BYTES_PER_COLOR)
+
+// Encodes length color bytes into buffer, which needs to be at least
+// WS2812_SPI_ENCODED_SIZE(length) bytes. Returns the number of bytes written.
+uint16_t ws2812_spi_encode(const uint8_t* colors, uint16_t length, uint8_t* buffer);
+
+#endif
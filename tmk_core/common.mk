@@ -15,6 +15,7 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/print.c \
 	$(COMMON_DIR)/debug.c \
 	$(COMMON_DIR)/util.c \
+	$(COMMON_DIR)/matrix_ghost.c \
 	$(COMMON_DIR)/eeconfig.c \
 	$(PLATFORM_COMMON_DIR)/suspend.c \
 	$(PLATFORM_COMMON_DIR)/timer.c \
@@ -46,6 +47,11 @@ ifeq ($(strip $(MOUSEKEY_ENABLE)), yes)
     TMK_COMMON_DEFS += -DMOUSE_ENABLE
 endif
 
+ifdef PS2_MOUSE_ENABLE
+    TMK_COMMON_SRC += $(COMMON_DIR)/mouse_motion.c
+    TMK_COMMON_DEFS += -DMOUSE_MOTION_ENABLE
+endif
+
 ifeq ($(strip $(EXTRAKEY_ENABLE)), yes)
     TMK_COMMON_DEFS += -DEXTRAKEY_ENABLE
 endif
@@ -26,6 +26,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_macro.h"
 #include "action_util.h"
 #include "action.h"
+#include "profile.h"
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_REACTIVE)
+#   include "rgblight_reactive.h"
+#endif
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -36,6 +40,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 void action_exec(keyevent_t event)
 {
+    PROFILE_BEGIN(PROFILE_ACTION_EXEC);
+
     if (!IS_NOEVENT(event)) {
         dprint("\n---- action_exec: start -----\n");
         dprint("EVENT: "); debug_event(event); dprintln();
@@ -47,6 +53,10 @@ void action_exec(keyevent_t event)
     }
 #endif
 
+#if defined(RGBLIGHT_ENABLE) && defined(RGBLIGHT_REACTIVE)
+    rgblight_reactive_record(event);
+#endif
+
     keyrecord_t record = { .event = event };
 
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
@@ -64,6 +74,8 @@ void action_exec(keyevent_t event)
         dprint("processed: "); debug_record(record); dprintln();
     }
 #endif
+
+    PROFILE_END(PROFILE_ACTION_EXEC);
 }
 
 #ifdef ONEHAND_ENABLE
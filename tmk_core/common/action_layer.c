@@ -111,11 +111,13 @@ void layer_debug(void)
 #endif
 
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
-uint8_t source_layers_cache[(MATRIX_ROWS * MATRIX_COLS + 7) / 8][MAX_LAYER_BITS] = {{0}};
+#if defined(SOURCE_LAYERS_CACHE_PACKED)
+/* a bit plane per bit of the layer number, eight keys to a byte */
+static uint8_t source_layers_cache[(MATRIX_ROWS * MATRIX_COLS + 7) / 8][MAX_LAYER_BITS] = {{0}};
 
 void update_source_layers_cache(keypos_t key, uint8_t layer)
 {
-    const uint8_t key_number = key.col + (key.row * MATRIX_COLS);
+    const uint16_t key_number = key.col + (key.row * MATRIX_COLS);
     const uint8_t storage_row = key_number / 8;
     const uint8_t storage_bit = key_number % 8;
 
@@ -129,7 +131,7 @@ void update_source_layers_cache(keypos_t key, uint8_t layer)
 
 uint8_t read_source_layers_cache(keypos_t key)
 {
-    const uint8_t key_number = key.col + (key.row * MATRIX_COLS);
+    const uint16_t key_number = key.col + (key.row * MATRIX_COLS);
     const uint8_t storage_row = key_number / 8;
     const uint8_t storage_bit = key_number % 8;
     uint8_t layer = 0;
@@ -143,36 +145,74 @@ uint8_t read_source_layers_cache(keypos_t key)
 
     return layer;
 }
+#elif MAX_LAYER_BITS <= 4
+/* a nibble per key, the even keys in the low one */
+static uint8_t source_layers_cache[(MATRIX_ROWS * MATRIX_COLS + 1) / 2] = {0};
+
+void update_source_layers_cache(keypos_t key, uint8_t layer)
+{
+    const uint16_t key_number = key.col + (key.row * MATRIX_COLS);
+    uint8_t *entry = &source_layers_cache[key_number / 2];
+
+    if (key_number & 1) {
+        *entry = (*entry & 0x0F) | (layer << 4);
+    } else {
+        *entry = (*entry & 0xF0) | (layer & 0x0F);
+    }
+}
+
+uint8_t read_source_layers_cache(keypos_t key)
+{
+    const uint16_t key_number = key.col + (key.row * MATRIX_COLS);
+    const uint8_t entry = source_layers_cache[key_number / 2];
+
+    return (key_number & 1) ? entry >> 4 : entry & 0x0F;
+}
+#else
+/* a byte per key */
+static uint8_t source_layers_cache[MATRIX_ROWS][MATRIX_COLS] = {{0}};
+
+void update_source_layers_cache(keypos_t key, uint8_t layer)
+{
+    source_layers_cache[key.row][key.col] = layer;
+}
+
+uint8_t read_source_layers_cache(keypos_t key)
+{
+    return source_layers_cache[key.row][key.col];
+}
+#endif
 #endif
 
 /*
- * Make sure the action triggered when the key is released is the same
- * one as the one triggered on press. It's important for the mod keys
- * when the layer is switched after the down event but before the up
- * event as they may get stuck otherwise.
+ * Make sure the layer used when the key is released is the same one as
+ * the one used on press. It's important for the mod keys when the layer
+ * is switched after the down event but before the up event as they may
+ * get stuck otherwise.
  */
-action_t store_or_get_action(bool pressed, keypos_t key)
+uint8_t store_or_get_layer(bool pressed, keypos_t key)
 {
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
     if (disable_action_cache) {
-        return layer_switch_get_action(key);
+        return layer_switch_get_layer(key);
     }
 
-    uint8_t layer;
-
     if (pressed) {
-        layer = layer_switch_get_layer(key);
+        uint8_t layer = layer_switch_get_layer(key);
         update_source_layers_cache(key, layer);
+        return layer;
     }
-    else {
-        layer = read_source_layers_cache(key);
-    }
-    return action_for_key(layer, key);
+    return read_source_layers_cache(key);
 #else
-    return layer_switch_get_action(key);
+    return layer_switch_get_layer(key);
 #endif
 }
 
+action_t store_or_get_action(bool pressed, keypos_t key)
+{
+    return action_for_key(store_or_get_layer(pressed, key), key);
+}
+
 
 int8_t layer_switch_get_layer(keypos_t key)
 {
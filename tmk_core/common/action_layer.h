@@ -71,13 +71,24 @@ void layer_xor(uint32_t state);
 
 #endif
 
-/* pressed actions cache */
+/* pressed actions cache
+ *
+ * The layer of each pressed key is kept for its release. It takes a byte
+ * per key, or a nibble when MAX_LAYER_BITS is 4 or less, for keymaps with
+ * 16 layers at most. SOURCE_LAYERS_CACHE_PACKED keeps only MAX_LAYER_BITS
+ * bits per key instead, in bit planes, which is less RAM but a loop over
+ * the bits on every press and release.
+ */
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
+#ifndef MAX_LAYER_BITS
 /* The number of bits needed to represent the layer number: log2(32). */
 #define MAX_LAYER_BITS 5
+#endif
 void update_source_layers_cache(keypos_t key, uint8_t layer);
 uint8_t read_source_layers_cache(keypos_t key);
 #endif
+/* the layer of the key, on release the one it was pressed on */
+uint8_t store_or_get_layer(bool pressed, keypos_t key);
 action_t store_or_get_action(bool pressed, keypos_t key);
 
 /* return the topmost non-transparent layer currently associated with key */
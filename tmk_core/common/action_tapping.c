@@ -5,6 +5,12 @@
 #include "action_tapping.h"
 #include "keycode.h"
 #include "timer.h"
+#ifdef TAPPING_TERM_PER_KEY
+#include "progmem.h"
+#endif
+#ifdef SPECULATIVE_HOLD
+#include "action_util.h"
+#endif
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -14,55 +20,91 @@
 
 #ifndef NO_ACTION_TAPPING
 
+#if TAPPING_LOG_SIZE & (TAPPING_LOG_SIZE - 1) || TAPPING_LOG_SIZE > 128
+#error "TAPPING_LOG_SIZE must be a power of two up to 128"
+#endif
+
 #define IS_TAPPING()            !IS_NOEVENT(tapping_key.event)
-#define IS_TAPPING_PRESSED()    (IS_TAPPING() && tapping_key.event.pressed)
-#define IS_TAPPING_RELEASED()   (IS_TAPPING() && !tapping_key.event.pressed)
 #define IS_TAPPING_KEY(k)       (IS_TAPPING() && KEYEQ(tapping_key.event.key, (k)))
-#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < TAPPING_TERM)
+#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < tapping_term)
+
+/* The state of the tapping key, which follows from tapping_key alone */
+typedef enum {
+    TAPPING_IDLE,           // no tap key
+    TAPPING_UNDECIDED,      // tap key down, not known if it's a tap or a hold
+    TAPPING_TAPPED,         // tap key down, counted as a tap
+    TAPPING_RELEASED,       // tap key up after a tap, the next one may count on
+} tapping_state_t;
 
 
 static keyrecord_t tapping_key = {};
-static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
-static uint8_t waiting_buffer_head = 0;
-static uint8_t waiting_buffer_tail = 0;
+/* the term of tapping_key, looked up once when it's pressed */
+static uint16_t tapping_term = TAPPING_TERM;
+
+/* Event log
+ *
+ * The events that wait for the tapping key to be decided, in the order they
+ * came. Events are only added at the end, and the cursor moves past them as
+ * they are processed, so each index is used once until the counters wrap.
+ */
+static keyrecord_t tapping_log[TAPPING_LOG_SIZE] = {};
+static uint8_t log_cursor = 0;
+static uint8_t log_end = 0;
+#define LOG_AT(i)   tapping_log[(uint8_t)(i) & (TAPPING_LOG_SIZE - 1)]
+
+/* The tapping key and end of the log when the event at the cursor last
+ * couldn't be processed. Nothing else changes the outcome, so the event
+ * isn't tried again on every tick while they stay the same.
+ */
+static keyrecord_t blocked_by = {};
+static uint8_t blocked_end = 0;
+
+#ifdef SPECULATIVE_HOLD
+uint8_t speculative_hold_mods = SPECULATIVE_HOLD_MODS;
+uint16_t speculative_hold_typing_term = SPECULATIVE_HOLD_TYPING_TERM;
+uint16_t speculative_hold_chord_term = SPECULATIVE_HOLD_CHORD_TERM;
+
+/* the mods of the undecided tapping key that were sent already */
+static uint8_t speculative_mods = 0;
+/* when the last key that isn't a tap key was pressed, 0 before any */
+static uint16_t typing_time = 0;
+
+static void speculative_start(void);
+static void speculative_end(bool hold);
+#endif
 
 static bool process_tapping(keyrecord_t *record);
-static bool waiting_buffer_enq(keyrecord_t record);
-static void waiting_buffer_clear(void);
-static bool waiting_buffer_typed(keyevent_t event);
-static bool waiting_buffer_has_anykey_pressed(void);
-static void waiting_buffer_scan_tap(void);
+static void log_append(keyrecord_t record);
+static void log_replay(void);
+static void log_settle(void);
+static bool log_typed(keyevent_t event);
+static void log_scan_tap(void);
 static void debug_tapping_key(void);
-static void debug_waiting_buffer(void);
+static void debug_log(void);
 
 
 void action_tapping_process(keyrecord_t record)
 {
+#ifdef SPECULATIVE_HOLD
+    if (IS_PRESSED(record.event) && !is_tap_key(record.event.key)) {
+        typing_time = record.event.time;
+    }
+#endif
     if (process_tapping(&record)) {
         if (!IS_NOEVENT(record.event)) {
             debug("processed: "); debug_record(record); debug("\n");
         }
-    } else {
-        if (!waiting_buffer_enq(record)) {
-            // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
-            clear_keyboard();
-            waiting_buffer_clear();
-            tapping_key = (keyrecord_t){};
+    } else if (!IS_NOEVENT(record.event)) {
+        if ((uint8_t)(log_end - log_cursor) == TAPPING_LOG_SIZE) {
+            debug("OVERFLOW: SETTLE TAPPING KEY\n");
+            log_settle();
         }
+        log_append(record);
     }
 
-    // process waiting_buffer
-    if (!IS_NOEVENT(record.event) && waiting_buffer_head != waiting_buffer_tail) {
-        debug("---- action_exec: process waiting_buffer -----\n");
-    }
-    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
-        if (process_tapping(&waiting_buffer[waiting_buffer_tail])) {
-            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
-            debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
-        } else {
-            break;
-        }
+    // process the log
+    if (log_cursor != log_end) {
+        log_replay();
     }
     if (!IS_NOEVENT(record.event)) {
         debug("\n");
@@ -70,293 +112,403 @@ void action_tapping_process(keyrecord_t record)
 }
 
 
+/* a tap key is pressed and becomes the tapping key */
+static void tapping_start(keyrecord_t *keyp)
+{
+    tapping_key = *keyp;
+#ifdef TAPPING_TERM_PER_KEY
+    keypos_t key = keyp->event.key;
+    uint16_t term = pgm_read_word(&tapping_terms[key.row][key.col]);
+    tapping_term = term ? term : TAPPING_TERM;
+#endif
+    log_scan_tap();
+#ifdef SPECULATIVE_HOLD
+    speculative_start();
+#endif
+}
+
+static tapping_state_t tapping_state(void)
+{
+    if (!IS_TAPPING()) return TAPPING_IDLE;
+    if (!tapping_key.event.pressed) return TAPPING_RELEASED;
+    return tapping_key.tap.count ? TAPPING_TAPPED : TAPPING_UNDECIDED;
+}
+
 /* Tapping
  *
  * Rule: Tap key is typed(pressed and released) within TAPPING_TERM.
  *       (without interfering by typing other key)
+ *
+ * Each of these returns true when the key event is processed or consumed,
+ * and false when it has to wait in the log.
  */
-/* return true when key event is processed or consumed. */
-bool process_tapping(keyrecord_t *keyp)
+static bool tapping_idle(keyrecord_t *keyp)
 {
     keyevent_t event = keyp->event;
 
-    // if tapping
-    if (IS_TAPPING_PRESSED()) {
-        if (WITHIN_TAPPING_TERM(event)) {
-            if (tapping_key.tap.count == 0) {
-                if (IS_TAPPING_KEY(event.key) && !event.pressed) {
-                    // first tap!
-                    debug("Tapping: First tap(0->1).\n");
-                    tapping_key.tap.count = 1;
-                    debug_tapping_key();
-                    process_record(&tapping_key);
-
-                    // copy tapping state
-                    keyp->tap = tapping_key.tap;
-                    // enqueue
-                    return false;
-                }
+    if (event.pressed && is_tap_key(event.key)) {
+        debug("Tapping: Start(Press tap key).\n");
+        tapping_start(keyp);
+        debug_tapping_key();
+        return true;
+    } else {
+        process_record(keyp);
+        return true;
+    }
+}
+
+static bool tapping_undecided(keyrecord_t *keyp)
+{
+    keyevent_t event = keyp->event;
+
+    if (!WITHIN_TAPPING_TERM(event)) {
+        debug("Tapping: End. Timeout. Not tap(0): ");
+        debug_event(event); debug("\n");
+#ifdef SPECULATIVE_HOLD
+        speculative_end(true);
+#endif
+        process_record(&tapping_key);
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        return false;
+    }
+
+    if (IS_TAPPING_KEY(event.key) && !event.pressed) {
+        // first tap!
+        debug("Tapping: First tap(0->1).\n");
+        tapping_key.tap.count = 1;
+        debug_tapping_key();
+#ifdef SPECULATIVE_HOLD
+#ifndef IGNORE_MOD_TAP_INTERRUPT
+        // an interrupted mod-tap registers its mods, see process_action
+        speculative_end(tapping_key.tap.interrupted);
+#else
+        speculative_end(false);
+#endif
+#endif
+        process_record(&tapping_key);
+
+        // copy tapping state
+        keyp->tap = tapping_key.tap;
+        // enqueue
+        return false;
+    }
+#ifdef SPECULATIVE_HOLD
+    /* With the mods sent already, a key pressed well after the tap key, or
+     * typed while it's down, makes a chord, and the tap key is held.
+     */
+    else if (speculative_mods &&
+            ((event.pressed && TIMER_DIFF_16(event.time, tapping_key.event.time) >= speculative_hold_chord_term) ||
+             (IS_RELEASED(event) && log_typed(event)))) {
+        debug("Tapping: End. Speculative hold\n");
+        speculative_end(true);
+        process_record(&tapping_key);
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        // enqueue
+        return false;
+    }
+#endif
 #if TAPPING_TERM >= 500
-                /* Process a key typed within TAPPING_TERM
-                 * This can register the key before settlement of tapping,
-                 * useful for long TAPPING_TERM but may prevent fast typing.
-                 */
-                else if (IS_RELEASED(event) && waiting_buffer_typed(event)) {
-                    debug("Tapping: End. No tap. Interfered by typing key\n");
-                    process_record(&tapping_key);
-                    tapping_key = (keyrecord_t){};
-                    debug_tapping_key();
-                    // enqueue
-                    return false;
-                }
+    /* Process a key typed within TAPPING_TERM
+     * This can register the key before settlement of tapping,
+     * useful for long TAPPING_TERM but may prevent fast typing.
+     */
+    else if (IS_RELEASED(event) && log_typed(event)) {
+        debug("Tapping: End. No tap. Interfered by typing key\n");
+#ifdef SPECULATIVE_HOLD
+        speculative_end(true);
 #endif
-                /* Process release event of a key pressed before tapping starts
-                 * Without this unexpected repeating will occur with having fast repeating setting
-                 * https://github.com/tmk/tmk_keyboard/issues/60
-                 */
-                else if (IS_RELEASED(event) && !waiting_buffer_typed(event)) {
-                    // Modifier should be retained till end of this tapping.
-                    action_t action = layer_switch_get_action(event.key);
-                    switch (action.kind.id) {
-                        case ACT_LMODS:
-                        case ACT_RMODS:
-                            if (action.key.mods && !action.key.code) return false;
-                            if (IS_MOD(action.key.code)) return false;
-                            break;
-                        case ACT_LMODS_TAP:
-                        case ACT_RMODS_TAP:
-                            if (action.key.mods && keyp->tap.count == 0) return false;
-                            if (IS_MOD(action.key.code)) return false;
-                            break;
-                    }
-                    // Release of key should be process immediately.
-                    debug("Tapping: release event of a key pressed before tapping\n");
-                    process_record(keyp);
-                    return true;
-                }
-                else {
-                    // set interrupted flag when other key preesed during tapping
-                    if (event.pressed) {
-                        tapping_key.tap.interrupted = true;
-                    }
-                    // enqueue
-                    return false;
-                }
-            }
-            // tap_count > 0
-            else {
-                if (IS_TAPPING_KEY(event.key) && !event.pressed) {
-                    debug("Tapping: Tap release("); debug_dec(tapping_key.tap.count); debug(")\n");
-                    keyp->tap = tapping_key.tap;
-                    process_record(keyp);
-                    tapping_key = *keyp;
-                    debug_tapping_key();
-                    return true;
-                }
-                else if (is_tap_key(event.key) && event.pressed) {
-                    if (tapping_key.tap.count > 1) {
-                        debug("Tapping: Start new tap with releasing last tap(>1).\n");
-                        // unregister key
-                        process_record(&(keyrecord_t){
-                                .tap = tapping_key.tap,
-                                .event.key = tapping_key.event.key,
-                                .event.time = event.time,
-                                .event.pressed = false
-                        });
-                    } else {
-                        debug("Tapping: Start while last tap(1).\n");
-                    }
-                    tapping_key = *keyp;
-                    waiting_buffer_scan_tap();
-                    debug_tapping_key();
-                    return true;
-                }
-                else {
-                    if (!IS_NOEVENT(event)) {
-                        debug("Tapping: key event while last tap(>0).\n");
-                    }
-                    process_record(keyp);
-                    return true;
-                }
-            }
+        process_record(&tapping_key);
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        // enqueue
+        return false;
+    }
+#endif
+    /* Process release event of a key pressed before tapping starts
+     * Without this unexpected repeating will occur with having fast repeating setting
+     * https://github.com/tmk/tmk_keyboard/issues/60
+     */
+    else if (IS_RELEASED(event) && !log_typed(event)) {
+        // Modifier should be retained till end of this tapping.
+        action_t action = layer_switch_get_action(event.key);
+        switch (action.kind.id) {
+            case ACT_LMODS:
+            case ACT_RMODS:
+                if (action.key.mods && !action.key.code) return false;
+                if (IS_MOD(action.key.code)) return false;
+                break;
+            case ACT_LMODS_TAP:
+            case ACT_RMODS_TAP:
+                if (action.key.mods && keyp->tap.count == 0) return false;
+                if (IS_MOD(action.key.code)) return false;
+                break;
         }
-        // after TAPPING_TERM
-        else {
-            if (tapping_key.tap.count == 0) {
-                debug("Tapping: End. Timeout. Not tap(0): ");
-                debug_event(event); debug("\n");
-                process_record(&tapping_key);
-                tapping_key = (keyrecord_t){};
-                debug_tapping_key();
-                return false;
-            }  else {
-                if (IS_TAPPING_KEY(event.key) && !event.pressed) {
-                    debug("Tapping: End. last timeout tap release(>0).");
-                    keyp->tap = tapping_key.tap;
-                    process_record(keyp);
-                    tapping_key = (keyrecord_t){};
-                    return true;
-                }
-                else if (is_tap_key(event.key) && event.pressed) {
-                    if (tapping_key.tap.count > 1) {
-                        debug("Tapping: Start new tap with releasing last timeout tap(>1).\n");
-                        // unregister key
-                        process_record(&(keyrecord_t){
-                                .tap = tapping_key.tap,
-                                .event.key = tapping_key.event.key,
-                                .event.time = event.time,
-                                .event.pressed = false
-                        });
-                    } else {
-                        debug("Tapping: Start while last timeout tap(1).\n");
-                    }
-                    tapping_key = *keyp;
-                    waiting_buffer_scan_tap();
-                    debug_tapping_key();
-                    return true;
-                }
-                else {
-                    if (!IS_NOEVENT(event)) {
-                        debug("Tapping: key event while last timeout tap(>0).\n");
-                    }
-                    process_record(keyp);
-                    return true;
-                }
-            }
+        // Release of key should be process immediately.
+        debug("Tapping: release event of a key pressed before tapping\n");
+        process_record(keyp);
+        return true;
+    }
+    else {
+        // set interrupted flag when other key preesed during tapping
+        if (event.pressed) {
+            tapping_key.tap.interrupted = true;
         }
-    } else if (IS_TAPPING_RELEASED()) {
+        // enqueue
+        return false;
+    }
+}
+
+static bool tapping_tapped(keyrecord_t *keyp)
+{
+    keyevent_t event = keyp->event;
+
+    if (IS_TAPPING_KEY(event.key) && !event.pressed) {
+        debug("Tapping: Tap release("); debug_dec(tapping_key.tap.count); debug(")\n");
+        keyp->tap = tapping_key.tap;
+        process_record(keyp);
         if (WITHIN_TAPPING_TERM(event)) {
-            if (event.pressed) {
-                if (IS_TAPPING_KEY(event.key)) {
-                    if (!tapping_key.tap.interrupted && tapping_key.tap.count > 0) {
-                        // sequential tap.
-                        keyp->tap = tapping_key.tap;
-                        if (keyp->tap.count < 15) keyp->tap.count += 1;
-                        debug("Tapping: Tap press("); debug_dec(keyp->tap.count); debug(")\n");
-                        process_record(keyp);
-                        tapping_key = *keyp;
-                        debug_tapping_key();
-                        return true;
-                    } else {
-                        // FIX: start new tap again
-                        tapping_key = *keyp;
-                        return true;
-                    }
-                } else if (is_tap_key(event.key)) {
-                    // Sequential tap can be interfered with other tap key.
-                    debug("Tapping: Start with interfering other tap.\n");
-                    tapping_key = *keyp;
-                    waiting_buffer_scan_tap();
-                    debug_tapping_key();
-                    return true;
-                } else {
-                    // should none in buffer
-                    // FIX: interrupted when other key is pressed
-                    tapping_key.tap.interrupted = true;
-                    process_record(keyp);
-                    return true;
-                }
-            } else {
-                if (!IS_NOEVENT(event)) debug("Tapping: other key just after tap.\n") {};
-                process_record(keyp);
-                return true;
-            }
+            tapping_key = *keyp;
         } else {
-            // FIX: process_aciton here?
-            // timeout. no sequential tap.
-            debug("Tapping: End(Timeout after releasing last tap): ");
-            debug_event(event); debug("\n");
+            // no sequential tap after TAPPING_TERM
             tapping_key = (keyrecord_t){};
-            debug_tapping_key();
-            return false;
         }
+        debug_tapping_key();
+        return true;
+    }
+    else if (is_tap_key(event.key) && event.pressed) {
+        if (tapping_key.tap.count > 1) {
+            debug("Tapping: Start new tap with releasing last tap(>1).\n");
+            // unregister key
+            process_record(&(keyrecord_t){
+                    .tap = tapping_key.tap,
+                    .event.key = tapping_key.event.key,
+                    .event.time = event.time,
+                    .event.pressed = false
+            });
+        } else {
+            debug("Tapping: Start while last tap(1).\n");
+        }
+        tapping_start(keyp);
+        debug_tapping_key();
+        return true;
     }
-    // not tapping state
     else {
-        if (event.pressed && is_tap_key(event.key)) {
-            debug("Tapping: Start(Press tap key).\n");
-            tapping_key = *keyp;
-            waiting_buffer_scan_tap();
+        if (!IS_NOEVENT(event)) {
+            debug("Tapping: key event while last tap(>0).\n");
+        }
+        process_record(keyp);
+        return true;
+    }
+}
+
+static bool tapping_released(keyrecord_t *keyp)
+{
+    keyevent_t event = keyp->event;
+
+    if (!WITHIN_TAPPING_TERM(event)) {
+        // FIX: process_aciton here?
+        // timeout. no sequential tap.
+        debug("Tapping: End(Timeout after releasing last tap): ");
+        debug_event(event); debug("\n");
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        return false;
+    }
+
+    if (event.pressed) {
+        if (IS_TAPPING_KEY(event.key)) {
+            if (!tapping_key.tap.interrupted && tapping_key.tap.count > 0) {
+                // sequential tap.
+                keyp->tap = tapping_key.tap;
+                if (keyp->tap.count < 15) keyp->tap.count += 1;
+                debug("Tapping: Tap press("); debug_dec(keyp->tap.count); debug(")\n");
+                process_record(keyp);
+                tapping_key = *keyp;
+                debug_tapping_key();
+                return true;
+            } else {
+                // FIX: start new tap again
+                tapping_key = *keyp;
+                return true;
+            }
+        } else if (is_tap_key(event.key)) {
+            // Sequential tap can be interfered with other tap key.
+            debug("Tapping: Start with interfering other tap.\n");
+            tapping_start(keyp);
             debug_tapping_key();
             return true;
         } else {
+            // should none in log
+            // FIX: interrupted when other key is pressed
+            tapping_key.tap.interrupted = true;
             process_record(keyp);
             return true;
         }
+    } else {
+        if (!IS_NOEVENT(event)) debug("Tapping: other key just after tap.\n");
+        process_record(keyp);
+        return true;
+    }
+}
+
+static bool process_tapping(keyrecord_t *keyp)
+{
+    switch (tapping_state()) {
+        case TAPPING_UNDECIDED:
+            return tapping_undecided(keyp);
+        case TAPPING_TAPPED:
+            return tapping_tapped(keyp);
+        case TAPPING_RELEASED:
+            return tapping_released(keyp);
+        default:
+            return tapping_idle(keyp);
     }
 }
 
 
 /*
- * Waiting buffer
+ * Event log
  */
-bool waiting_buffer_enq(keyrecord_t record)
+static bool same_record(const keyrecord_t *a, const keyrecord_t *b)
 {
-    if (IS_NOEVENT(record.event)) {
-        return true;
-    }
-
-    if ((waiting_buffer_head + 1) % WAITING_BUFFER_SIZE == waiting_buffer_tail) {
-        debug("waiting_buffer_enq: Over flow.\n");
-        return false;
-    }
+    return KEYEQ(a->event.key, b->event.key) &&
+        a->event.pressed == b->event.pressed &&
+        a->event.time == b->event.time &&
+        a->tap.count == b->tap.count &&
+        a->tap.interrupted == b->tap.interrupted;
+}
 
-    waiting_buffer[waiting_buffer_head] = record;
-    waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
+void log_append(keyrecord_t record)
+{
+    LOG_AT(log_end) = record;
+    log_end++;
 
-    debug("waiting_buffer_enq: "); debug_waiting_buffer();
-    return true;
+    debug("log_append: "); debug_log();
 }
 
-void waiting_buffer_clear(void)
+/* process the log from the cursor, up to the first event that has to wait */
+void log_replay(void)
 {
-    waiting_buffer_head = 0;
-    waiting_buffer_tail = 0;
+    if (blocked_end == log_end && same_record(&blocked_by, &tapping_key)) {
+        return;
+    }
+
+    debug("---- action_exec: process log -----\n");
+    while (log_cursor != log_end) {
+        keyrecord_t before = tapping_key;
+        if (process_tapping(&LOG_AT(log_cursor))) {
+            debug("processed: log["); debug_dec(log_cursor); debug("] = ");
+            debug_record(LOG_AT(log_cursor)); debug("\n\n");
+            log_cursor++;
+        } else if (same_record(&before, &tapping_key)) {
+            blocked_by = tapping_key;
+            blocked_end = log_end;
+            break;
+        }
+        // else the event decided the tapping key, and is tried again with
+        // the next one, whose term may already be over
+    }
 }
 
-bool waiting_buffer_typed(keyevent_t event)
+/* The log is full: the tapping key is decided as held, as if its term ran
+ * out, until there's room again. Nothing is dropped, and the keys come out
+ * in the order they were typed.
+ */
+void log_settle(void)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed !=  waiting_buffer[i].event.pressed) {
-            return true;
+    while ((uint8_t)(log_end - log_cursor) == TAPPING_LOG_SIZE) {
+        if (tapping_state() == TAPPING_UNDECIDED) {
+#ifdef SPECULATIVE_HOLD
+            speculative_end(true);
+#endif
+            process_record(&tapping_key);
         }
+        tapping_key = (keyrecord_t){};
+        debug_tapping_key();
+        log_replay();
     }
-    return false;
 }
 
-__attribute__((unused))
-bool waiting_buffer_has_anykey_pressed(void)
+bool log_typed(keyevent_t event)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (waiting_buffer[i].event.pressed) return true;
+    for (uint8_t i = log_cursor; i != log_end; i++) {
+        if (KEYEQ(event.key, LOG_AT(i).event.key) && event.pressed != LOG_AT(i).event.pressed) {
+            return true;
+        }
     }
     return false;
 }
 
-/* scan buffer for tapping */
-void waiting_buffer_scan_tap(void)
+/* scan log for tapping */
+void log_scan_tap(void)
 {
     // tapping already is settled
     if (tapping_key.tap.count > 0) return;
     // invalid state: tapping_key released && tap.count == 0
     if (!tapping_key.event.pressed) return;
 
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (IS_TAPPING_KEY(waiting_buffer[i].event.key) &&
-                !waiting_buffer[i].event.pressed &&
-                WITHIN_TAPPING_TERM(waiting_buffer[i].event)) {
+    for (uint8_t i = log_cursor; i != log_end; i++) {
+        if (IS_TAPPING_KEY(LOG_AT(i).event.key) &&
+                !LOG_AT(i).event.pressed &&
+                WITHIN_TAPPING_TERM(LOG_AT(i).event)) {
             tapping_key.tap.count = 1;
-            waiting_buffer[i].tap.count = 1;
+            LOG_AT(i).tap.count = 1;
             process_record(&tapping_key);
 
-            debug("waiting_buffer_scan_tap: found at ["); debug_dec(i); debug("]\n");
-            debug_waiting_buffer();
+            debug("log_scan_tap: found at ["); debug_dec(i); debug("]\n");
+            debug_log();
             return;
         }
     }
 }
 
 
+#ifdef SPECULATIVE_HOLD
+/*
+ * Speculative hold
+ */
+/* send the mods of a mod-tap key as soon as it's pressed, unless that's
+ * while typing */
+static void speculative_start(void)
+{
+    if (tapping_state() != TAPPING_UNDECIDED) return;
+
+    int16_t since_typing = tapping_key.event.time - typing_time;
+    if (typing_time && since_typing < (int32_t)speculative_hold_typing_term &&
+            since_typing > -(int32_t)speculative_hold_typing_term) {
+        return;
+    }
+
+    action_t action = layer_switch_get_action(tapping_key.event.key);
+    if (action.kind.id != ACT_LMODS_TAP && action.kind.id != ACT_RMODS_TAP) return;
+    if (action.key.code == MODS_ONESHOT || action.key.code == MODS_TAP_TOGGLE) return;
+
+    uint8_t mods = (action.kind.id == ACT_LMODS_TAP) ? action.key.mods : action.key.mods << 4;
+    // mods that are down already aren't taken back
+    speculative_mods = mods & speculative_hold_mods & ~get_mods();
+    if (speculative_mods) {
+        debug("speculative_start: "); debug_hex(speculative_mods); debug("\n");
+        add_mods(speculative_mods);
+        send_keyboard_report();
+    }
+}
+
+/* The tapping key is decided. A hold keeps the mods, its record registers
+ * them again, and a tap takes them back before the tap is sent. */
+static void speculative_end(bool hold)
+{
+    if (speculative_mods && !hold) {
+        debug("speculative_end: take back "); debug_hex(speculative_mods); debug("\n");
+        del_mods(speculative_mods);
+        send_keyboard_report();
+    }
+    speculative_mods = 0;
+}
+#endif
+
+
 /*
  * debug print
  */
@@ -365,11 +517,11 @@ static void debug_tapping_key(void)
     debug("TAPPING_KEY="); debug_record(tapping_key); debug("\n");
 }
 
-static void debug_waiting_buffer(void)
+static void debug_log(void)
 {
     debug("{ ");
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        debug("["); debug_dec(i); debug("]="); debug_record(waiting_buffer[i]); debug(" ");
+    for (uint8_t i = log_cursor; i != log_end; i++) {
+        debug("["); debug_dec(i); debug("]="); debug_record(LOG_AT(i)); debug(" ");
     }
     debug("}\n");
 }
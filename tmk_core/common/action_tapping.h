@@ -24,12 +24,54 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TERM    200
 #endif
 
+/* Set TAPPING_TERM_PER_KEY to give keys their own term, in a table next to
+ * keymaps[] in the keymap. It's written with the same KEYMAP macro, in ms,
+ * and 0 for the keys that keep TAPPING_TERM:
+ *
+ *   const uint16_t PROGMEM tapping_terms[MATRIX_ROWS][MATRIX_COLS] = KEYMAP(...);
+ *
+ * The term is looked up once, when a tap key is pressed.
+ */
+#ifdef TAPPING_TERM_PER_KEY
+extern const uint16_t tapping_terms[MATRIX_ROWS][MATRIX_COLS];
+#endif
+
 /* tap count needed for toggling a feature */
 #ifndef TAPPING_TOGGLE
 #define TAPPING_TOGGLE  5
 #endif
 
-#define WAITING_BUFFER_SIZE 8
+/* events kept while a tap key is undecided, a power of two up to 128 */
+#ifndef TAPPING_LOG_SIZE
+#define TAPPING_LOG_SIZE    16
+#endif
+
+/* Set SPECULATIVE_HOLD to send the mods of a mod-tap key as soon as it's
+ * pressed, and take them back if it turns out to be a tap. A shortcut then
+ * doesn't wait for the tapping term, and another key pressed while the tap
+ * key has been down for SPECULATIVE_HOLD_CHORD_TERM, or typed inside it,
+ * decides the hold right away.
+ * Keys pressed within SPECULATIVE_HOLD_TYPING_TERM of typing aren't sent
+ * early, and only the mods in SPECULATIVE_HOLD_MODS are, since alt or gui
+ * alone flashing down and up can open a menu.
+ * The settings can be changed at runtime with the variables below.
+ */
+#ifdef SPECULATIVE_HOLD
+#ifndef SPECULATIVE_HOLD_MODS
+#define SPECULATIVE_HOLD_MODS   (MOD_BIT(KC_LCTRL) | MOD_BIT(KC_LSHIFT) | \
+                                 MOD_BIT(KC_RCTRL) | MOD_BIT(KC_RSHIFT))
+#endif
+#ifndef SPECULATIVE_HOLD_TYPING_TERM
+#define SPECULATIVE_HOLD_TYPING_TERM    150
+#endif
+#ifndef SPECULATIVE_HOLD_CHORD_TERM
+#define SPECULATIVE_HOLD_CHORD_TERM     120
+#endif
+
+extern uint8_t speculative_hold_mods;
+extern uint16_t speculative_hold_typing_term;
+extern uint16_t speculative_hold_chord_term;
+#endif
 
 
 #ifndef NO_ACTION_TAPPING
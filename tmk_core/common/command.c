@@ -36,6 +36,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "quantum.h"
 #include "version.h"
 
+#ifdef SERIAL_LINK_ENABLE
+#include "serial_link/system/serial_link.h"
+#endif
+
 #ifdef MOUSEKEY_ENABLE
 #include "mousekey.h"
 #endif
@@ -55,6 +59,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     #include "audio.h"
 #endif /* AUDIO_ENABLE */
 
+#ifdef PROFILE_ENABLE
+    #include "profile.h"
+#endif
+
 
 static bool command_common(uint8_t code);
 static void command_common_help(void);
@@ -257,6 +265,10 @@ static void print_status(void)
 #   if USB_COUNT_SOF
     print_val_hex8(usbSofCount);
 #   endif
+#endif
+
+#ifdef SERIAL_LINK_ENABLE
+    serial_link_print_stats();
 #endif
 	return;
 }
@@ -535,6 +547,9 @@ static void command_console_help(void)
           "ESC/q:	quit\n"
 #ifdef MOUSEKEY_ENABLE
           "m:	mousekey\n"
+#endif
+#ifdef PROFILE_ENABLE
+          "p:	profile (and restart it)\n"
 #endif
     );
 }
@@ -556,6 +571,12 @@ static bool command_console(uint8_t code)
             print("M> ");
             command_state = MOUSEKEY;
             return true;
+#endif
+#ifdef PROFILE_ENABLE
+        case KC_P:
+            profile_print();
+            profile_reset();
+            break;
 #endif
         default:
             print("?");
@@ -583,6 +604,7 @@ static void mousekey_param_print(void)
     print("4: time_to_max: "); pdec(mk_time_to_max); print("\n");
     print("5: wheel_max_speed: "); pdec(mk_wheel_max_speed); print("\n");
     print("6: wheel_time_to_max: "); pdec(mk_wheel_time_to_max); print("\n");
+    print("7: curve: "); pdec(mk_curve); print("\n");
 #endif /* !NO_PRINT */
 
 }
@@ -634,6 +656,13 @@ static void mousekey_param_inc(uint8_t param, uint8_t inc)
                 mk_wheel_time_to_max = UINT8_MAX;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve + inc < MOUSEKEY_CURVE_TABLE)
+                mk_curve += inc;
+            else
+                mk_curve = MOUSEKEY_CURVE_TABLE;
+            PRINT_SET_VAL(mk_curve);
+            break;
     }
 }
 
@@ -682,6 +711,13 @@ static void mousekey_param_dec(uint8_t param, uint8_t dec)
                 mk_wheel_time_to_max = 0;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve > dec)
+                mk_curve -= dec;
+            else
+                mk_curve = 0;
+            PRINT_SET_VAL(mk_curve);
+            break;
     }
 }
 
@@ -695,6 +731,7 @@ static void mousekey_console_help(void)
           "4:	time_to_max\n"
           "5:	wheel_max_speed\n"
           "6:	wheel_time_to_max\n"
+          "7:	curve(0:linear 1:quadratic 2:table)\n"
           "\n"
           "p:	print values\n"
           "d:	set defaults\n"
@@ -703,9 +740,9 @@ static void mousekey_console_help(void)
           "pgup:	+10\n"
           "pgdown:	-10\n"
           "\n"
-          "speed = delta * max_speed * (repeat / time_to_max)\n");
-    xprintf("where delta: cursor=%d, wheel=%d\n"
-            "See http://en.wikipedia.org/wiki/Mouse_keys\n", MOUSEKEY_MOVE_DELTA,  MOUSEKEY_WHEEL_DELTA);
+          "speed = delta * (1 + (max_speed - 1) * curve(time / time_to_max))\n");
+    xprintf("per %dms, where delta: cursor=%d, wheel=%d\n"
+            "See http://en.wikipedia.org/wiki/Mouse_keys\n", MOUSEKEY_INTERVAL, MOUSEKEY_MOVE_DELTA,  MOUSEKEY_WHEEL_DELTA);
 }
 
 static bool mousekey_console(uint8_t code)
@@ -734,6 +771,7 @@ static bool mousekey_console(uint8_t code)
         case KC_4:
         case KC_5:
         case KC_6:
+        case KC_7:
             mousekey_param = numkey2num(code);
             break;
         case KC_UP:
@@ -755,6 +793,7 @@ static bool mousekey_console(uint8_t code)
             mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
             mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
             mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+            mk_curve = MOUSEKEY_CURVE;
             print("set default\n");
             break;
         default:
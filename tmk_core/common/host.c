@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#include "profile.h"
 
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
@@ -46,7 +47,10 @@ uint8_t host_keyboard_leds(void)
 void host_keyboard_send(report_keyboard_t *report)
 {
     if (!driver) return;
+    PROFILE_BEGIN(PROFILE_HOST_SEND);
     (*driver->send_keyboard)(report);
+    PROFILE_END(PROFILE_HOST_SEND);
+    PROFILE_REPORT_SENT();
 
     if (debug_keyboard) {
         dprint("keyboard_report: ");
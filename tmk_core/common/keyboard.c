@@ -31,6 +31,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "profile.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -48,6 +49,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef ADB_MOUSE_ENABLE
 #   include "adb.h"
 #endif
+#ifdef MOUSE_MOTION_ENABLE
+#   include "mouse_motion.h"
+#endif
 #ifdef RGBLIGHT_ENABLE
 #   include "rgblight.h"
 #endif
@@ -59,24 +63,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 
-
-#ifdef MATRIX_HAS_GHOST
-static bool has_ghost_in_row(uint8_t row)
-{
-    matrix_row_t matrix_row = matrix_get_row(row);
-    // No ghost exists when less than 2 keys are down on the row
-    if (((matrix_row - 1) & matrix_row) == 0)
-        return false;
-
-    // Ghost occurs when the row shares column line with other row
-    for (uint8_t i=0; i < MATRIX_ROWS; i++) {
-        if (i != row && (matrix_get_row(i) & matrix_row))
-            return true;
-    }
-    return false;
-}
-#endif
-
 __attribute__ ((weak))
 void matrix_setup(void) {
 }
@@ -111,6 +97,9 @@ void keyboard_init(void) {
 #if defined(NKRO_ENABLE) && defined(FORCE_NKRO)
     keymap_config.nkro = 1;
 #endif
+#ifdef PROFILE_ENABLE
+    profile_reset();
+#endif
 }
 
 /*
@@ -126,14 +115,20 @@ void keyboard_task(void)
     static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
+    PROFILE_BEGIN(PROFILE_KEYBOARD_TASK);
 
+    PROFILE_BEGIN(PROFILE_MATRIX_SCAN);
     matrix_scan();
+    PROFILE_END(PROFILE_MATRIX_SCAN);
+#ifdef MATRIX_HAS_GHOST
+    matrix_ghost_update();
+#endif
     for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
         matrix_row = matrix_get_row(r);
         matrix_change = matrix_row ^ matrix_prev[r];
         if (matrix_change) {
 #ifdef MATRIX_HAS_GHOST
-            if (has_ghost_in_row(r)) {
+            if (matrix_has_ghost_in_row(r)) {
                 /* Keep track of whether ghosted status has changed for
                  * debugging. But don't update matrix_prev until un-ghosted, or
                  * the last key would be lost.
@@ -149,6 +144,7 @@ void keyboard_task(void)
             if (debug_matrix) matrix_print();
             for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                 if (matrix_change & ((matrix_row_t)1<<c)) {
+                    PROFILE_KEY_EVENT();
                     action_exec((keyevent_t){
                         .key = (keypos_t){ .row = r, .col = c },
                         .pressed = (matrix_row & ((matrix_row_t)1<<c)),
@@ -184,6 +180,11 @@ MATRIX_LOOP_END:
     adb_mouse_task();
 #endif
 
+#ifdef MOUSE_MOTION_ENABLE
+    // send what the pointing devices have moved
+    mouse_motion_task();
+#endif
+
 #ifdef SERIAL_LINK_ENABLE
 	serial_link_update();
 #endif
@@ -197,6 +198,8 @@ MATRIX_LOOP_END:
         led_status = host_keyboard_leds();
         keyboard_set_leds(led_status);
     }
+
+    PROFILE_END(PROFILE_KEYBOARD_TASK);
 }
 
 void keyboard_set_leds(uint8_t leds)
@@ -57,6 +57,13 @@ matrix_row_t matrix_get_row(uint8_t row);
 /* print matrix for debug */
 void matrix_print(void);
 
+#ifdef MATRIX_HAS_GHOST
+/* find the ghosted rows, call once after each matrix_scan */
+void matrix_ghost_update(void);
+/* whether the row is ghosted in the last scan, and can't be trusted */
+bool matrix_has_ghost_in_row(uint8_t row);
+#endif
+
 
 /* power control */
 void matrix_power_up(void);
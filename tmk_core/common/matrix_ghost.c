@@ -0,0 +1,52 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "matrix.h"
+
+#ifdef MATRIX_HAS_GHOST
+
+/* Columns that are down on more than one row in the last scan.
+ *
+ * A row can only be ghosted when it shares a column with another row, so a
+ * row with two or more keys down is ghosted exactly when one of its columns
+ * is in here. That's found with a single pass over the rows per scan,
+ * instead of comparing every changed row with all the others.
+ */
+static matrix_row_t shared_cols;
+
+void matrix_ghost_update(void)
+{
+    matrix_row_t seen = 0;
+    shared_cols = 0;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        matrix_row_t matrix_row = matrix_get_row(i);
+        shared_cols |= seen & matrix_row;
+        seen |= matrix_row;
+    }
+}
+
+bool matrix_has_ghost_in_row(uint8_t row)
+{
+    matrix_row_t matrix_row = matrix_get_row(row);
+    // No ghost exists when less than 2 keys are down on the row
+    if (((matrix_row - 1) & matrix_row) == 0)
+        return false;
+
+    // Ghost occurs when the row shares column line with other row
+    return (matrix_row & shared_cols) != 0;
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "mouse_motion.h"
+#include "host.h"
+#include "timer.h"
+#include "report.h"
+
+#if defined(__AVR__)
+#include <util/atomic.h>
+#define MOTION_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+/* drivers elsewhere only add motion from the main loop */
+#define MOTION_ATOMIC
+#endif
+
+enum { AXIS_X, AXIS_Y, AXIS_V, AXIS_H, AXES };
+
+static volatile int16_t motion[AXES];
+static uint8_t buttons;
+static bool buttons_changed;
+static uint16_t last_report;
+
+static int16_t add_saturated(int16_t a, int16_t b)
+{
+    int32_t sum = (int32_t)a + b;
+    if (sum > INT16_MAX) return INT16_MAX;
+    if (sum < INT16_MIN) return INT16_MIN;
+    return sum;
+}
+
+/* what fits in a report, -128 isn't used */
+static int8_t take(uint8_t axis)
+{
+    int16_t value = motion[axis];
+    if (value > 127) value = 127;
+    if (value < -127) value = -127;
+    motion[axis] -= value;
+    return value;
+}
+
+void mouse_motion_add(int16_t x, int16_t y, int16_t v, int16_t h)
+{
+    MOTION_ATOMIC {
+        motion[AXIS_X] = add_saturated(motion[AXIS_X], x);
+        motion[AXIS_Y] = add_saturated(motion[AXIS_Y], y);
+        motion[AXIS_V] = add_saturated(motion[AXIS_V], v);
+        motion[AXIS_H] = add_saturated(motion[AXIS_H], h);
+    }
+}
+
+static bool moved(void)
+{
+    bool result = false;
+    MOTION_ATOMIC {
+        result = motion[AXIS_X] || motion[AXIS_Y] || motion[AXIS_V] || motion[AXIS_H];
+    }
+    return result;
+}
+
+void mouse_motion_buttons(uint8_t new_buttons)
+{
+    if (new_buttons == buttons) return;
+    /* a drag has to start where the button went down */
+    if (moved()) mouse_motion_send();
+    buttons = new_buttons;
+    buttons_changed = true;
+}
+
+bool mouse_motion_pending(void)
+{
+    return buttons_changed || moved();
+}
+
+void mouse_motion_send(void)
+{
+    report_mouse_t report = { .buttons = buttons };
+    MOTION_ATOMIC {
+        report.x = take(AXIS_X);
+        report.y = take(AXIS_Y);
+        report.v = take(AXIS_V);
+        report.h = take(AXIS_H);
+    }
+    host_mouse_send(&report);
+    buttons_changed = false;
+    last_report = timer_read();
+}
+
+void mouse_motion_task(void)
+{
+    if (buttons_changed ||
+            (moved() && timer_elapsed(last_report) >= MOUSE_REPORT_INTERVAL)) {
+        mouse_motion_send();
+    }
+}
+
+void mouse_motion_clear(void)
+{
+    MOTION_ATOMIC {
+        for (uint8_t axis = 0; axis < AXES; axis++) {
+            motion[axis] = 0;
+        }
+    }
+    buttons = 0;
+    buttons_changed = false;
+    last_report = timer_read();
+}
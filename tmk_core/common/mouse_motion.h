@@ -0,0 +1,53 @@
+/*
+Copyright 2011 Jun Wako <wakojun@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOUSE_MOTION_H
+#define MOUSE_MOTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Motion of a pointing device, added up until it's sent to the host.
+ *
+ * The driver adds whatever it reads from the device, as often as the device
+ * has something, and mouse_motion_task sends it at most once per
+ * MOUSE_REPORT_INTERVAL, independent of the matrix scan and the sample rate
+ * of the device. The motion is kept in 16 bits, and a report only takes what
+ * fits in it, so fast moves are spread over the next reports instead of
+ * being clipped away.
+ */
+
+/* ms between two reports; the USB mouse endpoint is polled every 10ms */
+#ifndef MOUSE_REPORT_INTERVAL
+#define MOUSE_REPORT_INTERVAL   10
+#endif
+
+/* add motion, in HID directions; safe to call from an interrupt */
+void mouse_motion_add(int16_t x, int16_t y, int16_t v, int16_t h);
+/* set the buttons; the motion so far is sent with the old buttons first,
+ * and a change is sent by the next mouse_motion_task right away */
+void mouse_motion_buttons(uint8_t buttons);
+/* whether there's motion or a button change that hasn't been sent */
+bool mouse_motion_pending(void);
+/* send a report now */
+void mouse_motion_send(void);
+/* send a report when something is pending and the interval is over */
+void mouse_motion_task(void);
+/* forget everything that hasn't been sent */
+void mouse_motion_clear(void);
+
+#endif
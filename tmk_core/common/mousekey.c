@@ -21,12 +21,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "timer.h"
 #include "print.h"
 #include "debug.h"
+#include "progmem.h"
 #include "mousekey.h"
 
 
 
 static report_mouse_t mouse_report = {};
-static uint8_t mousekey_repeat =  0;
 static uint8_t mousekey_accel = 0;
 
 static void mousekey_debug(void);
@@ -36,18 +36,24 @@ static void mousekey_debug(void);
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta * (1 + (max_speed - 1) * curve(time / time_to_max))
+ *
+ * The speed is in units per MOUSEKEY_INTERVAL, and the time is counted in
+ * MOUSEKEY_INTERVAL too, so changing mk_interval only changes how often the
+ * motion is reported, not how fast it is. The motion is accumulated in
+ * fixed point, with 1/65536 of a unit, and only the whole units are
+ * reported, so slow motion isn't rounded away.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
 /* milliseconds between repeated motion events (0-255) */
 uint8_t mk_interval = MOUSEKEY_INTERVAL;
-/* steady speed (in action_delta units) applied each event (0-255) */
+/* steady speed (in action_delta units) per MOUSEKEY_INTERVAL (0-255) */
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
-/* number of events (count) accelerating to steady speed (0-255) */
+/* time accelerating to steady speed, in MOUSEKEY_INTERVAL (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+/* ramp used to reach maximum pointer speed, one of MOUSEKEY_CURVE_* */
+uint8_t mk_curve = MOUSEKEY_CURVE;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
@@ -55,86 +61,171 @@ uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
 static uint16_t last_timer = 0;
 
+/* direction of each axis, -1, 0 or 1 */
+static int8_t dir_x, dir_y, dir_v, dir_h;
+/* motion not reported yet, in 1/65536 units */
+static uint32_t rest_x, rest_y, rest_v, rest_h;
+/* whether the initial delay is over */
+static bool mousekey_repeating = false;
+/* milliseconds of repeated motion, stops counting at the maximum */
+static uint16_t mousekey_time = 0;
+static uint16_t step_timer = 0;
 
-static uint8_t move_unit(void)
+static const uint8_t curve_points[] PROGMEM = MOUSEKEY_CURVE_POINTS;
+#define CURVE_SEGMENTS (sizeof(curve_points) - 1)
+
+
+/* where the speed is between the initial and the maximum, 0-256 */
+static uint16_t curve(uint16_t time, uint8_t time_to_max)
+{
+    uint16_t ramp = time_to_max * MOUSEKEY_INTERVAL;
+    if (time >= ramp)
+        return 256;
+    /* rounded, so that the speed isn't always a bit too low */
+    uint16_t x = (((uint32_t)time << 8) + ramp / 2) / ramp;
+    if (x >= 256)
+        return 256;
+
+    switch (mk_curve) {
+        case MOUSEKEY_CURVE_QUADRATIC:
+            return (x * x + 128) >> 8;
+        case MOUSEKEY_CURVE_TABLE: {
+            uint16_t pos = x * CURVE_SEGMENTS;
+            uint8_t i = pos >> 8;
+            uint8_t a = pgm_read_byte(&curve_points[i]);
+            uint8_t b = pgm_read_byte(&curve_points[i + 1]);
+            return a + (((int32_t)(b - a) * (pos & 0xFF)) >> 8);
+        }
+        default:
+            return x;
+    }
+}
+
+/* speed in 1/65536 units per millisecond */
+static uint32_t speed(uint16_t time, uint8_t delta, uint8_t max_speed, uint8_t time_to_max)
 {
-    uint16_t unit;
+    uint32_t min = (((uint32_t)delta << 16) + MOUSEKEY_INTERVAL / 2) / MOUSEKEY_INTERVAL;
+    uint32_t max = (((uint32_t)delta * max_speed << 16) + MOUSEKEY_INTERVAL / 2) / MOUSEKEY_INTERVAL;
+    if (max < min)
+        max = min;
+
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
+        return max / 4;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
+        return max / 2;
     } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
-    } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
+        return max;
     }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
+    return min + (((max - min) * curve(time, time_to_max)) >> 8);
+}
+
+static uint32_t move_speed(uint16_t time)
+{
+    return speed(time, MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max);
+}
+
+static uint32_t wheel_speed(uint16_t time)
+{
+    return speed(time, MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max);
+}
+
+/* units moved in an interval at the current speed */
+static uint8_t unit(uint32_t speed, uint8_t max)
+{
+    uint32_t units = (speed * MOUSEKEY_INTERVAL) >> 16;
+    return (units > max ? max : (units == 0 ? 1 : units));
+}
+
+static uint8_t move_unit(void)
+{
+    return unit(move_speed(mousekey_time), MOUSEKEY_MOVE_MAX);
 }
 
 static uint8_t wheel_unit(void)
 {
-    uint16_t unit;
-    if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
-    } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
-    } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
+    return unit(wheel_speed(mousekey_time), MOUSEKEY_WHEEL_MAX);
+}
+
+/* adds the motion to what's left of the axis, and returns the whole units */
+static int8_t step(int8_t dir, uint32_t *rest, uint32_t distance, uint8_t max)
+{
+    if (!dir) {
+        *rest = 0;
+        return 0;
+    }
+    *rest += distance;
+    uint32_t units = *rest >> 16;
+    if (units > max) {
+        units = max;
+        *rest = 0;
     } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+        *rest &= 0xFFFF;
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+    return dir > 0 ? (int8_t)units : -(int8_t)units;
 }
 
 void mousekey_task(void)
 {
-    if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
+    if (!dir_x && !dir_y && !dir_v && !dir_h)
         return;
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
+    if (timer_elapsed(last_timer) < (mousekey_repeating ? mk_interval : mk_delay*10))
         return;
 
-    if (mousekey_repeat != UINT8_MAX)
-        mousekey_repeat++;
+    uint16_t now = timer_read();
+    uint16_t elapsed = TIMER_DIFF_16(now, step_timer);
+    if (!mousekey_repeating) {
+        /* the first repeat moves as far as a step of MOUSEKEY_INTERVAL, so
+         * that mk_interval doesn't change the distance */
+        mousekey_repeating = true;
+        elapsed = MOUSEKEY_INTERVAL;
+    }
+    /* a long stall isn't made up for all at once */
+    if (elapsed > UINT8_MAX)
+        elapsed = UINT8_MAX;
+    step_timer = now;
 
+    uint16_t begin = mousekey_time;
+    if (mousekey_time < UINT16_MAX - elapsed)
+        mousekey_time += elapsed;
+    else
+        mousekey_time = UINT16_MAX;
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+    /* the speed changes during the step, so take the average */
+    uint32_t move = ((move_speed(begin) + move_speed(mousekey_time)) / 2) * elapsed;
+    uint32_t wheel = ((wheel_speed(begin) + wheel_speed(mousekey_time)) / 2) * elapsed;
 
-    /* diagonal move [1/sqrt(2) = 0.7] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x *= 0.7;
-        mouse_report.y *= 0.7;
-    }
+    /* diagonal move [1/sqrt(2) = 181/256] */
+    if (dir_x && dir_y)
+        move = (move >> 8) * 181;
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+    mouse_report.x = step(dir_x, &rest_x, move, MOUSEKEY_MOVE_MAX);
+    mouse_report.y = step(dir_y, &rest_y, move, MOUSEKEY_MOVE_MAX);
+    mouse_report.v = step(dir_v, &rest_v, wheel, MOUSEKEY_WHEEL_MAX);
+    mouse_report.h = step(dir_h, &rest_h, wheel, MOUSEKEY_WHEEL_MAX);
+
+    /* nothing to report while slow motion adds up to a whole unit */
+    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0) {
+        last_timer = now;
+        return;
+    }
 
     mousekey_send();
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    if (!dir_x && !dir_y && !dir_v && !dir_h)
+        step_timer = timer_read();
+
+    if      (code == KC_MS_UP)       { dir_y = -1; rest_y = 0; mouse_report.y = move_unit() * -1; }
+    else if (code == KC_MS_DOWN)     { dir_y =  1; rest_y = 0; mouse_report.y = move_unit(); }
+    else if (code == KC_MS_LEFT)     { dir_x = -1; rest_x = 0; mouse_report.x = move_unit() * -1; }
+    else if (code == KC_MS_RIGHT)    { dir_x =  1; rest_x = 0; mouse_report.x = move_unit(); }
+    else if (code == KC_MS_WH_UP)    { dir_v =  1; rest_v = 0; mouse_report.v = wheel_unit(); }
+    else if (code == KC_MS_WH_DOWN)  { dir_v = -1; rest_v = 0; mouse_report.v = wheel_unit() * -1; }
+    else if (code == KC_MS_WH_LEFT)  { dir_h = -1; rest_h = 0; mouse_report.h = wheel_unit() * -1; }
+    else if (code == KC_MS_WH_RIGHT) { dir_h =  1; rest_h = 0; mouse_report.h = wheel_unit(); }
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -147,14 +238,14 @@ void mousekey_on(uint8_t code)
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    if      (code == KC_MS_UP       && dir_y < 0) dir_y = 0;
+    else if (code == KC_MS_DOWN     && dir_y > 0) dir_y = 0;
+    else if (code == KC_MS_LEFT     && dir_x < 0) dir_x = 0;
+    else if (code == KC_MS_RIGHT    && dir_x > 0) dir_x = 0;
+    else if (code == KC_MS_WH_UP    && dir_v > 0) dir_v = 0;
+    else if (code == KC_MS_WH_DOWN  && dir_v < 0) dir_v = 0;
+    else if (code == KC_MS_WH_LEFT  && dir_h < 0) dir_h = 0;
+    else if (code == KC_MS_WH_RIGHT && dir_h > 0) dir_h = 0;
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -164,8 +255,10 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        mousekey_repeat = 0;
+    if (!dir_x && !dir_y && !dir_v && !dir_h) {
+        mousekey_repeating = false;
+        mousekey_time = 0;
+    }
 }
 
 void mousekey_send(void)
@@ -173,24 +266,32 @@ void mousekey_send(void)
     mousekey_debug();
     host_mouse_send(&mouse_report);
     last_timer = timer_read();
+    /* the motion is sent once, only the buttons stay */
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
 }
 
 void mousekey_clear(void)
 {
     mouse_report = (report_mouse_t){};
-    mousekey_repeat = 0;
     mousekey_accel = 0;
+    dir_x = dir_y = dir_v = dir_h = 0;
+    rest_x = rest_y = rest_v = rest_h = 0;
+    mousekey_repeating = false;
+    mousekey_time = 0;
 }
 
 static void mousekey_debug(void)
 {
     if (!debug_mouse) return;
-    print("mousekey [btn|x y v h](rep/acl): [");
+    print("mousekey [btn|x y v h](ms/acl): [");
     phex(mouse_report.buttons); print("|");
     print_decs(mouse_report.x); print(" ");
     print_decs(mouse_report.y); print(" ");
     print_decs(mouse_report.v); print(" ");
     print_decs(mouse_report.h); print("](");
-    print_dec(mousekey_repeat); print("/");
+    print_dec(mousekey_time); print("/");
     print_dec(mousekey_accel); print(")\n");
 }
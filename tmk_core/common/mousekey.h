@@ -51,6 +51,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define MOUSEKEY_WHEEL_TIME_TO_MAX 40
 #endif
 
+/* acceleration curves */
+#define MOUSEKEY_CURVE_LINEAR       0
+#define MOUSEKEY_CURVE_QUADRATIC    1
+#define MOUSEKEY_CURVE_TABLE        2
+#ifndef MOUSEKEY_CURVE
+#define MOUSEKEY_CURVE MOUSEKEY_CURVE_LINEAR
+#endif
+/* the speed between the initial and the maximum (0-255) at evenly spaced
+ * times up to time_to_max, for MOUSEKEY_CURVE_TABLE */
+#ifndef MOUSEKEY_CURVE_POINTS
+#define MOUSEKEY_CURVE_POINTS { 0, 11, 40, 81, 128, 174, 215, 244, 255 }
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +73,7 @@ extern uint8_t mk_delay;
 extern uint8_t mk_interval;
 extern uint8_t mk_max_speed;
 extern uint8_t mk_time_to_max;
+extern uint8_t mk_curve;
 extern uint8_t mk_wheel_max_speed;
 extern uint8_t mk_wheel_time_to_max;
 
@@ -3,10 +3,13 @@
 
 #if defined(__AVR__)
 #   include <avr/pgmspace.h>
-#elif defined(__arm__)
+#else
+#   include <string.h>
 #   define PROGMEM
 #   define pgm_read_byte(p)     *((unsigned char*)p)
 #   define pgm_read_word(p)     *((uint16_t*)p)
+#   define pgm_read_dword(p)    *((uint32_t*)p)
+#   define memcpy_P(dest, src, n) memcpy(dest, src, n)
 #endif
 
 #endif
@@ -52,6 +52,9 @@
 #include "descriptor.h"
 #include "lufa.h"
 #include "quantum.h"
+#ifdef PROFILE_ENABLE
+  #include "profile.h"
+#endif
 #include <util/atomic.h>
 #include "outputselect.h"
 
@@ -223,6 +226,9 @@ void raw_hid_receive( uint8_t *data, uint8_t length )
 	// Users should #include "raw_hid.h" in their own code
 	// and implement this function there. Leave this as weak linkage
 	// so users can opt to not handle data coming in.
+#ifdef PROFILE_ENABLE
+	profile_raw_hid_receive( data, length );
+#endif
 }
 
 static void raw_hid_task(void)
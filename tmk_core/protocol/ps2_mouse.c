@@ -25,16 +25,27 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "report.h"
 #include "debug.h"
 #include "ps2.h"
+#include "mouse_motion.h"
 
 /* ============================= MACROS ============================ */
 
 static report_mouse_t mouse_report = {};
 
+/* a packet in HID directions, before it's split into reports */
+typedef struct {
+    uint8_t buttons;
+    int16_t x;
+    int16_t y;
+    int16_t v;
+    int16_t h;
+} ps2_mouse_motion_t;
+
 static inline void ps2_mouse_print_report(report_mouse_t *mouse_report);
-static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report);
+static inline void ps2_mouse_print_motion(ps2_mouse_motion_t *motion);
+static inline void ps2_mouse_convert_report_to_motion(report_mouse_t *mouse_report, ps2_mouse_motion_t *motion);
 static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report);
 static inline void ps2_mouse_enable_scrolling(void);
-static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report);
+static inline void ps2_mouse_scroll_button_task(ps2_mouse_motion_t *motion);
 
 /* ============================= IMPLEMENTATION ============================ */
 
@@ -78,10 +89,10 @@ void ps2_mouse_task(void) {
     rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
     if (rcv == PS2_ACK) {
         mouse_report.buttons = ps2_host_recv_response();
-        mouse_report.x = ps2_host_recv_response() * PS2_MOUSE_X_MULTIPLIER;
-        mouse_report.y = ps2_host_recv_response() * PS2_MOUSE_Y_MULTIPLIER;
+        mouse_report.x = ps2_host_recv_response();
+        mouse_report.y = ps2_host_recv_response();
 #ifdef PS2_MOUSE_ENABLE_SCROLLING
-        mouse_report.v = -(ps2_host_recv_response() & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+        mouse_report.v = ps2_host_recv_response() & PS2_MOUSE_SCROLL_MASK;
 #endif
     } else {
         if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
@@ -96,15 +107,18 @@ void ps2_mouse_task(void) {
         ps2_mouse_print_report(&mouse_report);
 #endif
         buttons_prev = mouse_report.buttons;
-        ps2_mouse_convert_report_to_hid(&mouse_report);
+        ps2_mouse_motion_t motion;
+        ps2_mouse_convert_report_to_motion(&mouse_report, &motion);
 #if PS2_MOUSE_SCROLL_BTN_MASK
-        ps2_mouse_scroll_button_task(&mouse_report);
+        ps2_mouse_scroll_button_task(&motion);
 #endif
 #ifdef PS2_MOUSE_DEBUG_HID
-        // Used to debug the bytes sent to the host
-        ps2_mouse_print_report(&mouse_report);
+        // Used to debug the motion that goes to the host
+        ps2_mouse_print_motion(&motion);
 #endif
-        host_mouse_send(&mouse_report);
+        // Sent by mouse_motion_task, at the report rate instead of the sample rate
+        mouse_motion_buttons(motion.buttons);
+        mouse_motion_add(motion.x, motion.y, motion.v, motion.h);
     }
     
     ps2_mouse_clear_report(&mouse_report);
@@ -150,26 +164,30 @@ void ps2_mouse_set_sample_rate(ps2_mouse_sample_rate_t sample_rate) {
 #define Y_IS_NEG  (mouse_report->buttons & (1<<PS2_MOUSE_Y_SIGN))
 #define X_IS_OVF  (mouse_report->buttons & (1<<PS2_MOUSE_X_OVFLW))
 #define Y_IS_OVF  (mouse_report->buttons & (1<<PS2_MOUSE_Y_OVFLW))
-static inline void ps2_mouse_convert_report_to_hid(report_mouse_t *mouse_report) {
+static inline void ps2_mouse_convert_report_to_motion(report_mouse_t *mouse_report, ps2_mouse_motion_t *motion) {
     // PS/2 mouse data is '9-bit integer'(-256 to 255) which is comprised of sign-bit and 8-bit value.
     // bit: 8    7 ... 0
     //      sign \8-bit/
     //
     // Meanwhile USB HID mouse indicates 8bit data(-127 to 127), note that -128 is not used.
     //
-    // This converts PS/2 data into HID value. Use only -127-127 out of PS/2 9-bit.
-    mouse_report->x = X_IS_NEG ?
-        ((!X_IS_OVF && -127 <= mouse_report->x && mouse_report->x <= -1) ?  mouse_report->x : -127) :
-        ((!X_IS_OVF && 0 <= mouse_report->x && mouse_report->x <= 127) ? mouse_report->x : 127);
-    mouse_report->y = Y_IS_NEG ?
-        ((!Y_IS_OVF && -127 <= mouse_report->y && mouse_report->y <= -1) ?  mouse_report->y : -127) :
-        ((!Y_IS_OVF && 0 <= mouse_report->y && mouse_report->y <= 127) ? mouse_report->y : 127);
+    // This keeps all of the 9-bit, mouse_motion splits it over as many HID reports as it takes.
+    // On overflow the mouse moved at least as far as 9-bit goes.
+    int16_t x = (uint8_t)mouse_report->x;
+    int16_t y = (uint8_t)mouse_report->y;
+    if (X_IS_NEG) x -= 256;
+    if (Y_IS_NEG) y -= 256;
+    if (X_IS_OVF) x = X_IS_NEG ? -256 : 255;
+    if (Y_IS_OVF) y = Y_IS_NEG ? -256 : 255;
+
+    motion->x = x * PS2_MOUSE_X_MULTIPLIER;
+    // invert coordinate of y to conform to USB HID mouse
+    motion->y = -y * PS2_MOUSE_Y_MULTIPLIER;
+    motion->v = -mouse_report->v * PS2_MOUSE_V_MULTIPLIER;
+    motion->h = 0;
 
     // remove sign and overflow flags
-    mouse_report->buttons &= PS2_MOUSE_BTN_MASK;
-
-    // invert coordinate of y to conform to USB HID mouse
-    mouse_report->y = -mouse_report->y;
+    motion->buttons = mouse_report->buttons & PS2_MOUSE_BTN_MASK;
 }
 
 static inline void ps2_mouse_clear_report(report_mouse_t *mouse_report) {
@@ -190,6 +208,12 @@ static inline void ps2_mouse_print_report(report_mouse_t *mouse_report) {
     print_hex8((uint8_t)mouse_report->h); print("]\n");
 }
 
+static inline void ps2_mouse_print_motion(ps2_mouse_motion_t *motion) {
+    if (!debug_mouse) return;
+    xprintf("ps2_mouse: [%02X|%d %d %d %d]\n", motion->buttons,
+            motion->x, motion->y, motion->v, motion->h);
+}
+
 static inline void ps2_mouse_enable_scrolling(void) {
     PS2_MOUSE_SEND(PS2_MOUSE_SET_SAMPLE_RATE, "Initiaing scroll wheel enable: Set sample rate");
     PS2_MOUSE_SEND(200, "200");
@@ -201,9 +225,8 @@ static inline void ps2_mouse_enable_scrolling(void) {
     _delay_ms(20);
 }
 
-#define PRESS_SCROLL_BUTTONS    mouse_report->buttons |= (PS2_MOUSE_SCROLL_BTN_MASK)
-#define RELEASE_SCROLL_BUTTONS  mouse_report->buttons &= ~(PS2_MOUSE_SCROLL_BTN_MASK)
-static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
+#define RELEASE_SCROLL_BUTTONS  motion->buttons &= ~(PS2_MOUSE_SCROLL_BTN_MASK)
+static inline void ps2_mouse_scroll_button_task(ps2_mouse_motion_t *motion) {
     static enum { 
         SCROLL_NONE, 
         SCROLL_BTN, 
@@ -211,7 +234,7 @@ static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
     } scroll_state = SCROLL_NONE;
     static uint16_t scroll_button_time = 0;
 
-    if (PS2_MOUSE_SCROLL_BTN_MASK == (mouse_report->buttons & (PS2_MOUSE_SCROLL_BTN_MASK))) {
+    if (PS2_MOUSE_SCROLL_BTN_MASK == (motion->buttons & (PS2_MOUSE_SCROLL_BTN_MASK))) {
         // All scroll buttons are pressed
 
         if (scroll_state == SCROLL_NONE) {
@@ -220,23 +243,23 @@ static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report) {
         }
 
         // If the mouse has moved, update the report to scroll instead of move the mouse
-        if (mouse_report->x || mouse_report->y) {
+        if (motion->x || motion->y) {
             scroll_state = SCROLL_SENT;
-            mouse_report->v = -mouse_report->y/(PS2_MOUSE_SCROLL_DIVISOR_V);
-            mouse_report->h =  mouse_report->x/(PS2_MOUSE_SCROLL_DIVISOR_H);
-            mouse_report->x = 0;
-            mouse_report->y = 0;
+            motion->v = -motion->y/(PS2_MOUSE_SCROLL_DIVISOR_V);
+            motion->h =  motion->x/(PS2_MOUSE_SCROLL_DIVISOR_H);
+            motion->x = 0;
+            motion->y = 0;
         }
-    } else if (0 == (PS2_MOUSE_SCROLL_BTN_MASK & mouse_report->buttons)) {
+    } else if (0 == (PS2_MOUSE_SCROLL_BTN_MASK & motion->buttons)) {
         // None of the scroll buttons are pressed 
 
 #if PS2_MOUSE_SCROLL_BTN_SEND
         if (scroll_state == SCROLL_BTN 
                 && timer_elapsed(scroll_button_time) < PS2_MOUSE_SCROLL_BTN_SEND) {
-            PRESS_SCROLL_BUTTONS;
-            host_mouse_send(mouse_report);
+            // Click them now, the release goes with the motion of this packet
+            mouse_motion_buttons(motion->buttons | PS2_MOUSE_SCROLL_BTN_MASK);
+            mouse_motion_send();
             _delay_ms(100);
-            RELEASE_SCROLL_BUTTONS;
         }
 #endif
         scroll_state = SCROLL_NONE;